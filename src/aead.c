@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Poly1305 (RFC 8439, 26-bit limbs) and the XChaCha20-Poly1305 AEAD
+ * construction (draft-irtf-cfrg-xchacha): HChaCha20 derives a sub-key from
+ * the first 16 bytes of the 24 bytes nonce, the rest is the ChaCha20-Poly1305
+ * AEAD of RFC 8439 with the remaining 8 bytes.
+ */
+
+#include <string.h>
+
+#include "aead.h"
+#include "chacha.h"
+
+
+#define MASK26	0x3ffffff
+
+
+static uint32_t
+load32_le(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+	    (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+
+static void
+store32_le(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+
+void
+poly1305_init(struct poly1305_ctx *ctx, const uint8_t *key)
+{
+	/* Clamp r. */
+	ctx->r[0] = load32_le(key + 0) & 0x3ffffff;
+	ctx->r[1] = (load32_le(key + 3) >> 2) & 0x3ffff03;
+	ctx->r[2] = (load32_le(key + 6) >> 4) & 0x3ffc0ff;
+	ctx->r[3] = (load32_le(key + 9) >> 6) & 0x3f03fff;
+	ctx->r[4] = (load32_le(key + 12) >> 8) & 0x00fffff;
+
+	for (int i = 0; i < 5; i++)
+		ctx->h[i] = 0;
+	for (int i = 0; i < 4; i++)
+		ctx->pad[i] = load32_le(key + 16 + i * 4);
+
+	ctx->leftover = 0;
+}
+
+
+/*
+ * Absorb full 16 bytes blocks, the last partial one is padded by the caller
+ * and given without the high bit.
+ */
+static void
+poly1305_blocks(struct poly1305_ctx *ctx, const uint8_t *m, size_t len,
+    uint32_t hibit)
+{
+	const uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+	const uint32_t r3 = ctx->r[3], r4 = ctx->r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+	uint32_t h3 = ctx->h[3], h4 = ctx->h[4];
+	uint64_t d0, d1, d2, d3, d4;
+	uint32_t c;
+
+	while (len >= POLY1305_BLOCK_LENGTH) {
+		h0 += load32_le(m + 0) & MASK26;
+		h1 += (load32_le(m + 3) >> 2) & MASK26;
+		h2 += (load32_le(m + 6) >> 4) & MASK26;
+		h3 += (load32_le(m + 9) >> 6) & MASK26;
+		h4 += (load32_le(m + 12) >> 8) | hibit;
+
+		d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 +
+		    (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+		d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 +
+		    (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+		d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 +
+		    (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+		d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 +
+		    (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+		d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 +
+		    (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+		c = d0 >> 26; h0 = d0 & MASK26;
+		d1 += c; c = d1 >> 26; h1 = d1 & MASK26;
+		d2 += c; c = d2 >> 26; h2 = d2 & MASK26;
+		d3 += c; c = d3 >> 26; h3 = d3 & MASK26;
+		d4 += c; c = d4 >> 26; h4 = d4 & MASK26;
+		h0 += c * 5; c = h0 >> 26; h0 &= MASK26;
+		h1 += c;
+
+		m += POLY1305_BLOCK_LENGTH;
+		len -= POLY1305_BLOCK_LENGTH;
+	}
+
+	ctx->h[0] = h0;
+	ctx->h[1] = h1;
+	ctx->h[2] = h2;
+	ctx->h[3] = h3;
+	ctx->h[4] = h4;
+}
+
+
+void
+poly1305_update(struct poly1305_ctx *ctx, const void *data, size_t len)
+{
+	const uint8_t *m = data;
+	size_t n;
+
+	if (ctx->leftover > 0) {
+		n = POLY1305_BLOCK_LENGTH - ctx->leftover;
+		if (n > len)
+			n = len;
+		memcpy(ctx->buffer + ctx->leftover, m, n);
+		ctx->leftover += n;
+		m += n;
+		len -= n;
+		if (ctx->leftover < POLY1305_BLOCK_LENGTH)
+			return;
+		poly1305_blocks(ctx, ctx->buffer, POLY1305_BLOCK_LENGTH,
+		    1 << 24);
+		ctx->leftover = 0;
+	}
+
+	n = len & ~(size_t)(POLY1305_BLOCK_LENGTH - 1);
+	poly1305_blocks(ctx, m, n, 1 << 24);
+	m += n;
+	len -= n;
+
+	memcpy(ctx->buffer, m, len);
+	ctx->leftover = len;
+}
+
+
+void
+poly1305_final(struct poly1305_ctx *ctx, uint8_t *tag)
+{
+	uint32_t h0, h1, h2, h3, h4, c;
+	uint32_t g0, g1, g2, g3, g4, mask;
+	uint64_t f;
+
+	if (ctx->leftover > 0) {
+		ctx->buffer[ctx->leftover] = 1;
+		for (size_t i = ctx->leftover + 1; i < POLY1305_BLOCK_LENGTH;
+		    i++)
+			ctx->buffer[i] = 0;
+		poly1305_blocks(ctx, ctx->buffer, POLY1305_BLOCK_LENGTH, 0);
+	}
+
+	h0 = ctx->h[0];
+	h1 = ctx->h[1];
+	h2 = ctx->h[2];
+	h3 = ctx->h[3];
+	h4 = ctx->h[4];
+
+	/* Fully carry h. */
+	c = h1 >> 26; h1 &= MASK26;
+	h2 += c; c = h2 >> 26; h2 &= MASK26;
+	h3 += c; c = h3 >> 26; h3 &= MASK26;
+	h4 += c; c = h4 >> 26; h4 &= MASK26;
+	h0 += c * 5; c = h0 >> 26; h0 &= MASK26;
+	h1 += c;
+
+	/* g = h + -p, used instead of h if h >= p. */
+	g0 = h0 + 5; c = g0 >> 26; g0 &= MASK26;
+	g1 = h1 + c; c = g1 >> 26; g1 &= MASK26;
+	g2 = h2 + c; c = g2 >> 26; g2 &= MASK26;
+	g3 = h3 + c; c = g3 >> 26; g3 &= MASK26;
+	g4 = h4 + c - (1 << 26);
+
+	mask = (g4 >> 31) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+	h3 = (h3 & ~mask) | (g3 & mask);
+	h4 = (h4 & ~mask) | (g4 & mask);
+
+	/* h % 2^128 + pad */
+	h0 = h0 | (h1 << 26);
+	h1 = (h1 >> 6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 << 8);
+
+	f = (uint64_t)h0 + ctx->pad[0];
+	store32_le(tag + 0, f);
+	f = (uint64_t)h1 + ctx->pad[1] + (f >> 32);
+	store32_le(tag + 4, f);
+	f = (uint64_t)h2 + ctx->pad[2] + (f >> 32);
+	store32_le(tag + 8, f);
+	f = (uint64_t)h3 + ctx->pad[3] + (f >> 32);
+	store32_le(tag + 12, f);
+
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+
+/*
+ * Set up the ChaCha20 state of a message (block counter 1) and its Poly1305
+ * key (block 0).
+ */
+static void
+aead_init(uint32_t state[16], struct poly1305_ctx *poly,
+    const uint8_t *key, const uint8_t *nonce)
+{
+	uint8_t subkey[CHACHA_KEY_LENGTH];
+	uint8_t nonce12[CHACHA_NONCE_LENGTH];
+	uint8_t block[CHACHA_BLOCK_LENGTH];
+
+	hchacha20(subkey, key, nonce);
+	memset(nonce12, 0, 4);
+	memcpy(nonce12 + 4, nonce + 16, 8);
+
+	chacha20_init(state, subkey, 0, nonce12);
+	chacha20_block(state, block);
+	poly1305_init(poly, block);
+
+	memset(subkey, 0, sizeof(subkey));
+	memset(block, 0, sizeof(block));
+}
+
+
+/*
+ * Authenticate the additional data and the cipher-text as RFC 8439 2.8.
+ */
+static void
+aead_mac(struct poly1305_ctx *poly, uint8_t *tag,
+    const uint8_t *ad, size_t adlen, const uint8_t *ct, size_t len)
+{
+	static const uint8_t zeros[POLY1305_BLOCK_LENGTH];
+	uint8_t lengths[16];
+
+	poly1305_update(poly, ad, adlen);
+	poly1305_update(poly, zeros, (16 - adlen % 16) % 16);
+	poly1305_update(poly, ct, len);
+	poly1305_update(poly, zeros, (16 - len % 16) % 16);
+
+	store32_le(lengths + 0, adlen);
+	store32_le(lengths + 4, (uint64_t)adlen >> 32);
+	store32_le(lengths + 8, len);
+	store32_le(lengths + 12, (uint64_t)len >> 32);
+	poly1305_update(poly, lengths, sizeof(lengths));
+
+	poly1305_final(poly, tag);
+}
+
+
+/*
+ * Encrypt len bytes of src to dst (which may be src) and compute the tag over
+ * the additional data and the cipher-text.
+ */
+void
+aead_seal(uint8_t *dst, uint8_t *tag, const uint8_t *src,
+    size_t len, const uint8_t *ad, size_t adlen,
+    const uint8_t *nonce, const uint8_t *key)
+{
+	struct poly1305_ctx poly;
+	uint32_t state[16];
+
+	aead_init(state, &poly, key, nonce);
+	chacha20_xor(state, dst, src, len);
+	aead_mac(&poly, tag, ad, adlen, dst, len);
+
+	memset(state, 0, sizeof(state));
+}
+
+
+/*
+ * Verify the tag and decrypt len bytes of src to dst (which may be src).
+ * Returns false without touching dst if the tag doesn't match.
+ */
+bool
+aead_open(uint8_t *dst, const uint8_t *tag, const uint8_t *src,
+    size_t len, const uint8_t *ad, size_t adlen,
+    const uint8_t *nonce, const uint8_t *key)
+{
+	struct poly1305_ctx poly;
+	uint8_t computed[AEAD_TAG_LENGTH];
+	uint32_t state[16];
+	uint8_t diff = 0;
+
+	aead_init(state, &poly, key, nonce);
+	aead_mac(&poly, computed, ad, adlen, src, len);
+
+	/* Constant time comparison. */
+	for (int i = 0; i < AEAD_TAG_LENGTH; i++)
+		diff |= computed[i] ^ tag[i];
+
+	if (diff == 0)
+		chacha20_xor(state, dst, src, len);
+
+	memset(state, 0, sizeof(state));
+
+	return (diff == 0);
+}
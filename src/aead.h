@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _AEAD_H_
+#define _AEAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define POLY1305_KEY_LENGTH	32
+#define POLY1305_BLOCK_LENGTH	16
+#define POLY1305_TAG_LENGTH	16
+
+#define AEAD_KEY_LENGTH		32
+#define AEAD_NONCE_LENGTH	24
+#define AEAD_TAG_LENGTH		16
+
+struct poly1305_ctx {
+	uint32_t	r[5];
+	uint32_t	h[5];
+	uint32_t	pad[4];
+	size_t		leftover;
+	uint8_t		buffer[POLY1305_BLOCK_LENGTH];
+};
+
+void		 poly1305_init(struct poly1305_ctx *, const uint8_t *);
+void		 poly1305_update(struct poly1305_ctx *, const void *, size_t);
+void		 poly1305_final(struct poly1305_ctx *, uint8_t *);
+void		 aead_seal(uint8_t *, uint8_t *, const uint8_t *, size_t,
+		     const uint8_t *, size_t, const uint8_t *, const uint8_t *);
+bool		 aead_open(uint8_t *, const uint8_t *, const uint8_t *, size_t,
+		     const uint8_t *, size_t, const uint8_t *, const uint8_t *);
+
+#endif /* _AEAD_H_ */
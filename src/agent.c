@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Session key cache.
+ *
+ * Most of the time spent decrypting the password file goes to unwrapping its
+ * session key with the private key (and asking for the passphrase when the
+ * gpg-agent forgot it). With 'set session_cache <seconds>', the session keys
+ * are kept by a small mdp process living next to the password file
+ * (~/.mdp/agent), the following decryptions of the same cipher-text only need
+ * the symmetric part (gpg --override-session-key-fd).
+ *
+ * Entries are looked up by the SHA-256 of the encrypted file, any change to it
+ * is a miss. The agent keeps its memory locked, forgets the keys after the
+ * configured number of seconds and exits once it has nothing left and wasn't
+ * asked anything for as long. It is started by gpg_check(), before anything
+ * was decrypted and before any thread exists (it is forked without exec), so
+ * it doesn't inherit any plain-text or lock held by another thread. It is
+ * only reachable by the user owning ~/.mdp, the directory is mode 0700.
+ *
+ * The protocol is one line per connection:
+ *
+ *	GET <sha256>\n		-> KEY <session key>\n or NONE\n
+ *	PUT <sha256> <key>\n	-> OK\n
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/un.h>
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <err.h>
+
+#include "agent.h"
+#include "config.h"
+#include "debug.h"
+#include "sha256.h"
+#include "strlcpy.h"
+#include "xmalloc.h"
+
+
+#define AGENT_MAX_ENTRIES	64
+#define AGENT_LINE_MAX		(AGENT_KEY_MAX + AGENT_ID_LENGTH + 16)
+
+
+char *agent_path = NULL;
+
+struct agent_entry {
+	char	id[AGENT_ID_LENGTH + 1];
+	char	key[AGENT_KEY_MAX];
+	time_t	expires;
+};
+
+static struct agent_entry entries[AGENT_MAX_ENTRIES];
+static time_t idle_until;
+
+
+/*
+ * Identify the cipher-text of the given file, id must hold
+ * AGENT_ID_LENGTH + 1 characters. Returns false if the file can't be read.
+ */
+bool
+agent_file_id(const char *path, char *id)
+{
+	static const char hex[] = "0123456789abcdef";
+	static char buf[65536];
+	struct sha256_ctx ctx;
+	uint8_t digest[SHA256_DIGEST_LENGTH];
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return (false);
+
+	sha256_init(&ctx);
+	while ((len = read(fd, buf, sizeof(buf))) > 0)
+		sha256_update(&ctx, buf, len);
+	close(fd);
+
+	if (len == -1)
+		return (false);
+
+	sha256_final(&ctx, digest);
+
+	for (unsigned int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+		id[i * 2] = hex[digest[i] >> 4];
+		id[i * 2 + 1] = hex[digest[i] & 0xf];
+	}
+	id[AGENT_ID_LENGTH] = '\0';
+
+	return (true);
+}
+
+
+static void
+agent_address(struct sockaddr_un *sun)
+{
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	if (strlcpy(sun->sun_path, agent_path, sizeof(sun->sun_path)) >=
+			sizeof(sun->sun_path))
+		errx(EXIT_FAILURE, "agent path too long: %s", agent_path);
+}
+
+
+/*
+ * Drop the expired entries, returns the number of entries left.
+ */
+static unsigned int
+agent_expire(void)
+{
+	unsigned int count = 0;
+	time_t now = time(NULL);
+
+	for (unsigned int i = 0; i < AGENT_MAX_ENTRIES; i++) {
+		if (entries[i].id[0] == '\0')
+			continue;
+		if (entries[i].expires <= now) {
+			debug("agent expired %.16s", entries[i].id);
+			memset(&entries[i], 0, sizeof(entries[i]));
+			continue;
+		}
+		count++;
+	}
+
+	return (count);
+}
+
+
+static struct agent_entry *
+agent_find(const char *id)
+{
+	for (unsigned int i = 0; i < AGENT_MAX_ENTRIES; i++) {
+		if (strcmp(entries[i].id, id) == 0)
+			return (&entries[i]);
+	}
+
+	return (NULL);
+}
+
+
+/*
+ * Store a key, replacing the entry which expires first when full.
+ */
+static void
+agent_insert(const char *id, const char *key)
+{
+	struct agent_entry *entry;
+
+	entry = agent_find(id);
+	for (unsigned int i = 0; entry == NULL && i < AGENT_MAX_ENTRIES; i++) {
+		if (entries[i].id[0] == '\0')
+			entry = &entries[i];
+	}
+	if (entry == NULL) {
+		entry = &entries[0];
+		for (unsigned int i = 1; i < AGENT_MAX_ENTRIES; i++) {
+			if (entries[i].expires < entry->expires)
+				entry = &entries[i];
+		}
+	}
+
+	strlcpy(entry->id, id, sizeof(entry->id));
+	strlcpy(entry->key, key, sizeof(entry->key));
+	entry->expires = time(NULL) + cfg_session_cache;
+}
+
+
+/*
+ * Answer the request waiting on the given connection.
+ */
+static void
+agent_serve(int fd)
+{
+	char line[AGENT_LINE_MAX], reply[AGENT_LINE_MAX];
+	struct agent_entry *entry;
+	char *id, *key;
+	ssize_t len;
+
+	len = read(fd, line, sizeof(line) - 1);
+	if (len <= 0)
+		return;
+	line[len] = '\0';
+	line[strcspn(line, "\n")] = '\0';
+
+	id = line + 4;
+	strlcpy(reply, "NONE\n", sizeof(reply));
+
+	if (strncmp(line, "GET ", 4) == 0) {
+		entry = agent_find(id);
+		if (entry != NULL && id[0] != '\0')
+			snprintf(reply, sizeof(reply), "KEY %s\n", entry->key);
+	} else if (strncmp(line, "PUT ", 4) == 0 &&
+			(key = strchr(id, ' ')) != NULL) {
+		*key++ = '\0';
+		if (strlen(id) == AGENT_ID_LENGTH && *key != '\0') {
+			agent_insert(id, key);
+			strlcpy(reply, "OK\n", sizeof(reply));
+		}
+	}
+
+	if (write(fd, reply, strlen(reply)) == -1)
+		debug("agent write: %s", strerror(errno));
+
+	memset(line, 0, sizeof(line));
+	memset(reply, 0, sizeof(reply));
+}
+
+
+/*
+ * Main loop of the agent, exits when all the entries have expired and no
+ * request came for session_cache seconds.
+ */
+static void
+agent_main(int sock)
+{
+	struct pollfd pfd;
+	int fd;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	idle_until = time(NULL) + cfg_session_cache;
+
+	for (;;) {
+		if (poll(&pfd, 1, 1000) == -1 && errno != EINTR)
+			break;
+
+		if (pfd.revents & POLLIN) {
+			fd = accept(sock, NULL, NULL);
+			if (fd != -1) {
+				agent_serve(fd);
+				close(fd);
+			}
+			idle_until = time(NULL) + cfg_session_cache;
+		}
+
+		if (agent_expire() == 0 && time(NULL) >= idle_until)
+			break;
+	}
+
+	debug("agent exiting");
+	memset(entries, 0, sizeof(entries));
+	unlink(agent_path);
+}
+
+
+/*
+ * Start the agent in the background.
+ *
+ * The agent is forked from the current process, it is given nothing but
+ * its socket: the standard streams are redirected to /dev/null and the
+ * other descriptors closed.
+ */
+static void
+agent_start(void)
+{
+	struct sockaddr_un sun;
+	mode_t mask;
+	int sock, null;
+	pid_t pid;
+
+	agent_address(&sun);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == -1)
+		err(EXIT_FAILURE, "agent socket");
+
+	/* Left over by an agent that was killed. */
+	unlink(agent_path);
+
+	mask = umask(077);
+	if (bind(sock, (struct sockaddr *)&sun, sizeof(sun)) != 0) {
+		debug("agent bind(%s): %s", agent_path, strerror(errno));
+		umask(mask);
+		close(sock);
+		return;
+	}
+	umask(mask);
+
+	if (listen(sock, 8) != 0)
+		err(EXIT_FAILURE, "agent listen");
+
+	pid = fork();
+
+	switch (pid) {
+	case -1:
+		err(EXIT_FAILURE, "agent fork");
+		break;
+	case 0:
+		setsid();
+		signal(SIGINT, SIG_IGN);
+		signal(SIGHUP, SIG_IGN);
+		signal(SIGPIPE, SIG_IGN);
+
+		null = open("/dev/null", O_RDWR);
+		if (null != -1) {
+			dup2(null, STDIN_FILENO);
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+		}
+		for (int fd = STDERR_FILENO + 1; fd < 256; fd++) {
+			if (fd != sock)
+				close(fd);
+		}
+
+		/* Keep the session keys out of swap. */
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+			debug("agent mlockall: %s", strerror(errno));
+
+		agent_main(sock);
+
+		/* Avoid atexit() to run on the child. */
+		_exit(0);
+		/* NOTREACHED */
+	default:
+		break;
+	}
+
+	debug("agent started (pid: %d)", pid);
+	close(sock);
+}
+
+
+/*
+ * Send a request to the agent and read its reply. Returns false if no agent
+ * is running.
+ */
+static bool
+agent_request(const char *request, char *reply, size_t size)
+{
+	struct sockaddr_un sun;
+	ssize_t len;
+	size_t off = 0;
+	int sock;
+
+	agent_address(&sun);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == -1)
+		return (false);
+
+	if (connect(sock, (struct sockaddr *)&sun, sizeof(sun)) != 0) {
+		close(sock);
+		return (false);
+	}
+
+	if (write(sock, request, strlen(request)) == -1) {
+		close(sock);
+		return (false);
+	}
+
+	while (off < size - 1 &&
+			(len = read(sock, reply + off, size - off - 1)) > 0)
+		off += len;
+	reply[off] = '\0';
+	close(sock);
+
+	return (off > 0);
+}
+
+
+/*
+ * Start the agent if the session cache is enabled and it isn't running.
+ *
+ * The agent is forked without exec, this must be called by the main thread
+ * before any other thread is started (gpg_check() does it), never from the
+ * decryption itself.
+ */
+void
+agent_begin(void)
+{
+	char reply[AGENT_LINE_MAX];
+
+	if (cfg_session_cache == 0)
+		return;
+
+	/* Any request gets a reply from a running agent. */
+	if (!agent_request("PING\n", reply, sizeof(reply)))
+		agent_start();
+}
+
+
+/*
+ * Look up the session key of the given cipher-text, key must hold
+ * AGENT_KEY_MAX characters. Returns false if the key is unknown or if no
+ * agent is running (see agent_begin()).
+ */
+bool
+agent_get(const char *id, char *key)
+{
+	char request[AGENT_LINE_MAX], reply[AGENT_LINE_MAX];
+	bool found = false;
+
+	snprintf(request, sizeof(request), "GET %s\n", id);
+
+	if (!agent_request(request, reply, sizeof(reply))) {
+		debug("agent_get no agent running");
+	} else if (strncmp(reply, "KEY ", 4) == 0) {
+		reply[strcspn(reply, "\n")] = '\0';
+		strlcpy(key, reply + 4, AGENT_KEY_MAX);
+		found = true;
+	}
+
+	memset(reply, 0, sizeof(reply));
+	debug("agent_get %.16s: %s", id, found ? "hit" : "miss");
+
+	return (found);
+}
+
+
+/*
+ * Remember the session key of the given cipher-text. Nothing is kept if the
+ * agent is gone.
+ */
+void
+agent_put(const char *id, const char *key)
+{
+	char request[AGENT_LINE_MAX], reply[AGENT_LINE_MAX];
+
+	debug("agent_put %.16s", id);
+
+	snprintf(request, sizeof(request), "PUT %s %s\n", id, key);
+
+	if (!agent_request(request, reply, sizeof(reply)))
+		debug("agent_put no agent running");
+
+	memset(request, 0, sizeof(request));
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _AGENT_H_
+#define _AGENT_H_
+
+#include <stdbool.h>
+
+/* Hex SHA-256 of the cipher-text. */
+#define AGENT_ID_LENGTH	64
+
+/* Session key as printed by gpg, e.g. "9:<hex>". */
+#define AGENT_KEY_MAX	256
+
+extern char	*agent_path;
+
+bool		 agent_file_id(const char *, char *);
+void		 agent_begin(void);
+bool		 agent_get(const char *, char *);
+void		 agent_put(const char *, const char *);
+
+#endif /* _AGENT_H_ */
@@ -1,6 +1,7 @@
 /*
  * Copyright (c) 1996, David Mazieres <dm@uun.org>
  * Copyright (c) 2008, Damien Miller <djm@openbsd.org>
+ * Copyright (c) 2015, Bertrand Janin <b@janin.com>
  *
  * Permission to use, copy, modify, and distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -16,221 +17,225 @@
  */
 
 /*
- * Arc4 random number generator for OpenBSD.
+ * ChaCha20 based random number generator, after the one in OpenBSD libc.
  *
- * This code is derived from section 17.1 of Applied Cryptography,
- * second edition, which describes a stream cipher allegedly
- * compatible with RSA Labs "RC4" cipher (the actual description of
- * which is a trade secret).  The same algorithm is used as a stream
- * cipher called "arcfour" in Tatu Ylonen's ssh package.
+ * The key stream is produced sixteen blocks at a time. The first 44 bytes of
+ * each batch immediately become the next key and nonce, so the state cannot
+ * be rewound to recover earlier output, and the rest is handed out to the
+ * callers. The key is taken from the kernel (getrandom(2), /dev/urandom
+ * otherwise) on first use, after every REKEY_BYTES of output and in any child
+ * after fork(2), so a parent and its children never share a stream.
  *
- * Here the stream cipher has been modified always to include the time
- * when initializing the state.  That makes it impossible to
- * regenerate the same random sequence twice, so this can't be used
- * for encryption, but will generate good random numbers.
- *
- * RC4 is a registered trademark of RSA Laboratories.
+ * This is always built, even where libc has its own arc4random, so that every
+ * random value used by mdp comes from the same generator (glibc's, for one,
+ * calls into the kernel for each word).
  */
 
-#include <sys/cdefs.h>
-
 #include <sys/types.h>
-#include <sys/time.h>
-#include <stdlib.h>
+
+#include <err.h>
+#include <errno.h>
 #include <fcntl.h>
-#include <unistd.h>
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-#include "arc4random.h"
+#ifndef HAS_NO_GETRANDOM
+#include <sys/random.h>
+#endif
 
+#include "arc4random.h"
+#include "chacha.h"
 
-struct arc4_stream {
-	u_int8_t i;
-	u_int8_t j;
-	u_int8_t s[256];
-};
 
 #define	RANDOMDEV	"/dev/urandom"
-#define KEYSIZE		128
+#define SEED_LENGTH	(CHACHA_KEY_LENGTH + CHACHA_NONCE_LENGTH)
+#define BUFFER_BLOCKS	16
+#define REKEY_BYTES	(1024 * 1024)
+
+static struct {
+	uint32_t	state[16];
+	uint8_t		buf[BUFFER_BLOCKS * CHACHA_BLOCK_LENGTH];
+	size_t		have;
+	size_t		count;
+	bool		initialized;
+} rs;
 
-#ifdef __REENTRANT
 static pthread_mutex_t arc4random_mtx = PTHREAD_MUTEX_INITIALIZER;
-#define	THREAD_LOCK()	pthread_mutex_lock(&arc4random_mtx)
-#define	THREAD_UNLOCK()	pthread_mutex_unlock(&arc4random_mtx)
-#else
-#define	THREAD_LOCK()
-#define	THREAD_UNLOCK()
-#endif
-
-static struct arc4_stream rs;
-static int rs_initialized;
-static int rs_stired;
-static int arc4_count;
+static bool arc4random_atfork;
 
-static inline u_int8_t arc4_getbyte(void);
-static void arc4_stir(void);
 
-static inline void
-arc4_init(void)
+/*
+ * Fork handlers: hold the lock across fork() so the child doesn't inherit a
+ * half-updated state, and make the child pick a new key.
+ */
+static void
+arc4_prepare(void)
 {
-	int     n;
+	pthread_mutex_lock(&arc4random_mtx);
+}
 
-	for (n = 0; n < 256; n++)
-		rs.s[n] = n;
-	rs.i = 0;
-	rs.j = 0;
+
+static void
+arc4_parent(void)
+{
+	pthread_mutex_unlock(&arc4random_mtx);
 }
 
-static inline void
-arc4_addrandom(u_char *dat, int datlen)
+
+static void
+arc4_child(void)
 {
-	int     n;
-	u_int8_t si;
-
-	rs.i--;
-	for (n = 0; n < 256; n++) {
-		rs.i = (rs.i + 1);
-		si = rs.s[rs.i];
-		rs.j = (rs.j + si + dat[n % datlen]);
-		rs.s[rs.i] = rs.s[rs.j];
-		rs.s[rs.j] = si;
-	}
-	rs.j = rs.i;
+	memset(&rs, 0, sizeof(rs));
+	pthread_mutex_unlock(&arc4random_mtx);
 }
 
+
+/*
+ * Fill buf with len bytes from the kernel.
+ */
 static void
-arc4_stir(void)
+arc4_seed(uint8_t *buf, size_t len)
 {
-	int done, fd, n;
-	struct {
-		struct timeval	tv;
-		pid_t 		pid;
-		u_int8_t 	rnd[KEYSIZE];
-	} rdat;
-
-	fd = open(RANDOMDEV, O_RDONLY, 0);
-	done = 0;
-	if (fd >= 0) {
-		if (read(fd, &rdat, KEYSIZE) == KEYSIZE)
-			done = 1;
-		(void)close(fd);
-	} 
-	if (!done) {
-		(void)gettimeofday(&rdat.tv, NULL);
-		rdat.pid = getpid();
-		/* We'll just take whatever was on the stack too... */
+	ssize_t n;
+	int fd;
+
+#ifndef HAS_NO_GETRANDOM
+	while (len > 0) {
+		n = getrandom(buf, len, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			break;
+		buf += n;
+		len -= n;
 	}
+	if (len == 0)
+		return;
+#endif
 
-	arc4_addrandom((u_char *)&rdat, KEYSIZE);
-
-	/*
-	 * Throw away the first N bytes of output, as suggested in the
-	 * paper "Weaknesses in the Key Scheduling Algorithm of RC4"
-	 * by Fluher, Mantin, and Shamir.  N=1024 is based on
-	 * suggestions in the paper "(Not So) Random Shuffles of RC4"
-	 * by Ilya Mironov.
-	 */
-	for (n = 0; n < 1024; n++)
-		(void) arc4_getbyte();
-	arc4_count = 1600000;
+	if ((fd = open(RANDOMDEV, O_RDONLY, 0)) == -1)
+		err(EXIT_FAILURE, "arc4random: %s", RANDOMDEV);
+	while (len > 0) {
+		n = read(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			err(EXIT_FAILURE, "arc4random: %s", RANDOMDEV);
+		buf += n;
+		len -= n;
+	}
+	close(fd);
 }
 
-static inline u_int8_t
-arc4_getbyte(void)
-{
-	u_int8_t si, sj;
 
-	rs.i = (rs.i + 1);
-	si = rs.s[rs.i];
-	rs.j = (rs.j + si);
-	sj = rs.s[rs.j];
-	rs.s[rs.i] = sj;
-	rs.s[rs.j] = si;
+/*
+ * Compute the next batch of key stream, mixing in the optional seed, and
+ * re-key from its head.
+ */
+static void
+arc4_rekey(const uint8_t *seed, size_t len)
+{
+	chacha20_blocks(rs.state, rs.buf, BUFFER_BLOCKS);
+	for (size_t i = 0; i < len; i++)
+		rs.buf[i] ^= seed[i];
 
-	return (rs.s[(si + sj) & 0xff]);
+	chacha20_init(rs.state, rs.buf, 0, rs.buf + CHACHA_KEY_LENGTH);
+	memset(rs.buf, 0, SEED_LENGTH);
+	rs.have = sizeof(rs.buf) - SEED_LENGTH;
 }
 
-static inline u_int32_t
-arc4_getword(void)
+
+static void
+arc4_stir(void)
 {
-	u_int32_t val;
+	uint8_t seed[SEED_LENGTH];
 
-	val = arc4_getbyte() << 24;
-	val |= arc4_getbyte() << 16;
-	val |= arc4_getbyte() << 8;
-	val |= arc4_getbyte();
+	if (!arc4random_atfork) {
+		if (pthread_atfork(arc4_prepare, arc4_parent, arc4_child) != 0)
+			errx(EXIT_FAILURE, "arc4random: pthread_atfork failed");
+		arc4random_atfork = true;
+	}
 
-	return (val);
-}
+	arc4_seed(seed, sizeof(seed));
 
-static void
-arc4_check_init(void)
-{
-	if (!rs_initialized) {
-		arc4_init();
-		rs_initialized = 1;
+	if (!rs.initialized) {
+		chacha20_init(rs.state, seed, 0, seed + CHACHA_KEY_LENGTH);
+		rs.initialized = true;
+	} else {
+		arc4_rekey(seed, sizeof(seed));
 	}
+	memset(seed, 0, sizeof(seed));
+
+	/* Discard what was left of the previous key stream. */
+	memset(rs.buf, 0, sizeof(rs.buf));
+	rs.have = 0;
+	rs.count = REKEY_BYTES;
 }
 
-static inline void
-arc4_check_stir(void)
+
+/*
+ * Copy len bytes of key stream to out, each byte is handed out only once.
+ */
+static void
+arc4_read(uint8_t *out, size_t len)
 {
-	if (!rs_stired || arc4_count <= 0) {
+	uint8_t *p;
+	size_t n;
+
+	if (!rs.initialized || rs.count <= len)
 		arc4_stir();
-		rs_stired = 1;
+	else
+		rs.count -= len;
+
+	while (len > 0) {
+		if (rs.have == 0)
+			arc4_rekey(NULL, 0);
+		n = len < rs.have ? len : rs.have;
+		p = rs.buf + sizeof(rs.buf) - rs.have;
+		memcpy(out, p, n);
+		memset(p, 0, n);
+		out += n;
+		len -= n;
+		rs.have -= n;
 	}
 }
 
-void
-arc4random_stir(void)
-{
-	THREAD_LOCK();
-	arc4_check_init();
-	arc4_stir();
-	rs_stired = 1;
-	THREAD_UNLOCK();
-}
 
-void
-arc4random_addrandom(u_char *dat, int datlen)
-{
-	THREAD_LOCK();
-	arc4_check_init();
-	arc4_check_stir();
-	arc4_addrandom(dat, datlen);
-	THREAD_UNLOCK();
-}
-
-u_int32_t
+uint32_t
 arc4random(void)
 {
-	u_int32_t rnd;
-
-	THREAD_LOCK();
-	arc4_check_init();
-	arc4_check_stir();
-	rnd = arc4_getword();
-	arc4_count -= 4;
-	THREAD_UNLOCK();
+	uint32_t rnd;
+	uint8_t *p;
+
+	pthread_mutex_lock(&arc4random_mtx);
+	if (rs.have >= sizeof(rnd) && rs.count > sizeof(rnd)) {
+		/* Most calls are served straight from the buffer. */
+		p = rs.buf + sizeof(rs.buf) - rs.have;
+		memcpy(&rnd, p, sizeof(rnd));
+		memset(p, 0, sizeof(rnd));
+		rs.have -= sizeof(rnd);
+		rs.count -= sizeof(rnd);
+	} else {
+		arc4_read((uint8_t *)&rnd, sizeof(rnd));
+	}
+	pthread_mutex_unlock(&arc4random_mtx);
 
 	return (rnd);
 }
 
+
 void
-arc4random_buf(void *_buf, size_t n)
+arc4random_buf(void *buf, size_t n)
 {
-	u_char *buf = (u_char *)_buf;
-
-	THREAD_LOCK();
-	arc4_check_init();
-	while (n--) {
-		arc4_check_stir();
-		buf[n] = arc4_getbyte();
-		arc4_count--;
-	}
-	THREAD_UNLOCK();
+	pthread_mutex_lock(&arc4random_mtx);
+	arc4_read(buf, n);
+	pthread_mutex_unlock(&arc4random_mtx);
 }
 
+
 /*
  * Calculate a uniformly distributed random number less than upper_bound
  * avoiding "modulo bias".
@@ -241,25 +246,16 @@ arc4random_buf(void *_buf, size_t n)
  * [2**32 % upper_bound, 2**32) which maps back to [0, upper_bound)
  * after reduction modulo upper_bound.
  */
-u_int32_t
-arc4random_uniform(u_int32_t upper_bound)
+uint32_t
+arc4random_uniform(uint32_t upper_bound)
 {
-	u_int32_t r, min;
+	uint32_t r, min;
 
 	if (upper_bound < 2)
 		return (0);
 
-#if (ULONG_MAX > 0xffffffffUL)
-	min = 0x100000000UL % upper_bound;
-#else
-	/* Calculate (2**32 % upper_bound) avoiding 64-bit math */
-	if (upper_bound > 0x80000000)
-		min = 1 + ~upper_bound;		/* 2**32 - upper_bound */
-	else {
-		/* (2**32 - (x * 2)) % x == 2**32 % x when x <= 2**31 */
-		min = ((0xffffffff - (upper_bound * 2)) + 1) % upper_bound;
-	}
-#endif
+	/* 2**32 % x == (2**32 - x) % x */
+	min = -upper_bound % upper_bound;
 
 	/*
 	 * This could theoretically loop forever but each retry has
@@ -275,24 +271,3 @@ arc4random_uniform(u_int32_t upper_bound)
 
 	return (r % upper_bound);
 }
-
-#if 0
-/*-------- Test code for i386 --------*/
-#include <stdio.h>
-#include <machine/pctr.h>
-int
-main(int argc, char **argv)
-{
-	const int iter = 1000000;
-	int     i;
-	pctrval v;
-
-	v = rdtsc();
-	for (i = 0; i < iter; i++)
-		arc4random();
-	v = rdtsc() - v;
-	v /= iter;
-
-	printf("%qd cycles\n", v);
-}
-#endif
@@ -19,12 +19,11 @@
 #ifndef _ARC4RANDOM_H_
 #define _ARC4RANDOM_H_
 
-#include <sys/types.h>
+#include <stddef.h>
+#include <stdint.h>
 
-void		 arc4random_stir(void);
-void		 arc4random_addrandom(u_char *, int);
-u_int32_t	 arc4random(void);
+uint32_t	 arc4random(void);
 void		 arc4random_buf(void *, size_t);
-u_int32_t	 arc4random_uniform(u_int32_t);
+uint32_t	 arc4random_uniform(uint32_t);
 
 #endif /* _ARC4RANDOM_H_ */
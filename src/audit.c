@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Audit of the password file: passwords used on more than one line and
+ * passwords easy to guess. Only line numbers are reported, never the
+ * passwords themselves.
+ *
+ * The strength estimate follows the idea of zxcvbn: a password is covered by
+ * the cheapest sequence of patterns (common words, repeats, sequences,
+ * keyboard runs, years) and single characters, each costing roughly the
+ * number of guesses needed to find it, in bits.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#include "audit.h"
+#include "results.h"
+#include "utils.h"
+#include "xmalloc.h"
+
+
+/* Characters separating the fields of a line. */
+#define FIELD_SEPARATORS	L" \t"
+
+/* Shortest repeat, sequence or keyboard run considered a pattern. */
+#define MIN_PATTERN_LENGTH	3
+
+#define NO_ENTRY		UINT32_MAX
+
+/* Logarithms of small integers are tabulated. */
+#define LOG2_TABLE_SIZE		256
+
+/*
+ * Common passwords and words, most common first. Matched case-insensitively
+ * and through the usual substitutions (p@ssw0rd).
+ */
+static const char *common_words[] = {
+	"password", "qwerty", "dragon", "monkey", "letmein", "football",
+	"iloveyou", "admin", "welcome", "login", "master", "hello",
+	"freedom", "whatever", "qazwsx", "trustno", "starwars", "sunshine",
+	"princess", "shadow", "superman", "michael", "batman", "charlie",
+	"secret", "access", "flower", "hunter", "baseball", "soccer",
+	"hockey", "killer", "jordan", "harley", "ranger", "buster", "thomas",
+	"pepper", "ginger", "cookie", "cheese", "computer", "internet",
+	"server", "summer", "winter", "spring", "autumn", "love", "god",
+	"test", "guest", "root", "user", "changeme", "default", "pass",
+	"abc", "mustang", "ninja", "azerty", "orange", "purple", "silver",
+	"golden", "tiger", "lion", "bear", "eagle", "angel", "apple",
+	"banana", "chocolate", "coffee", "money", "lucky", "happy", "family",
+	"friend", "matrix", "pokemon", "google", "facebook", "linux",
+	"windows", "oracle", "mysql", "january", "february", "march",
+	"april", "june", "july", "august", "september", "october",
+	"november", "december", "monday", "sunday", "london", "paris",
+	"berlin", "hallo", "passe", "motdepasse", "contrasena", "secure",
+	"private", "work", "office", "company", "super", "power", "magic",
+	"wizard", "knight", "soleil",
+};
+
+#define COMMON_WORD_COUNT	(sizeof(common_words) / sizeof(common_words[0]))
+
+/* Characters commonly substituted for letters. */
+static const struct {
+	char		 letter;
+	const char	*substitutes;
+} leet[] = {
+	{ 'a', "@4" }, { 'b', "8" }, { 'c', "(<" }, { 'e', "3" },
+	{ 'g', "69" }, { 'i', "1!|" }, { 'l', "1|7" }, { 'o', "0" },
+	{ 's', "$5" }, { 't', "7+" }, { 'z', "2" },
+};
+
+static const char *keyboard_rows[] = {
+	"1234567890", "qwertyuiop", "asdfghjkl", "zxcvbnm"
+};
+
+/*
+ * For each ASCII character, the letters it may stand for (bit 0 for 'a'),
+ * whether it is a substitute and its keyboard position (row 0 for none).
+ * Common words by first letter.
+ */
+static bool		 tables_ready = false;
+static uint32_t		 letter_mask[128];
+static uint32_t		 substitute_mask[128];
+static int8_t		 key_row[128];
+static int8_t		 key_col[128];
+static uint8_t		 bucket[26][COMMON_WORD_COUNT];
+static unsigned int	 bucket_length[26];
+static size_t		 word_length[COMMON_WORD_COUNT];
+static double		 log2_table[LOG2_TABLE_SIZE];
+
+/*
+ * A line with a password, linked to the other lines with the same password.
+ */
+struct audit_entry {
+	const wchar_t	*secret;
+	size_t		 len;
+	unsigned int	 line;
+	uint32_t	 first;
+	uint32_t	 next;
+	uint32_t	 tail;
+	unsigned int	 count;
+	bool		 leader;
+	double		 bits;
+};
+
+
+static void
+audit_init_tables(void)
+{
+	const char *p;
+	uint32_t bit;
+
+	for (int c = 'a'; c <= 'z'; c++) {
+		letter_mask[c] = 1U << (c - 'a');
+		letter_mask[c - 'a' + 'A'] = 1U << (c - 'a');
+	}
+
+	for (size_t i = 0; i < sizeof(leet) / sizeof(leet[0]); i++) {
+		bit = 1U << (leet[i].letter - 'a');
+		for (p = leet[i].substitutes; *p != '\0'; p++) {
+			letter_mask[(int)*p] |= bit;
+			substitute_mask[(int)*p] |= bit;
+		}
+	}
+
+	for (int row = 0; row < 4; row++) {
+		for (p = keyboard_rows[row]; *p != '\0'; p++) {
+			key_row[(int)*p] = row + 1;
+			key_col[(int)*p] = p - keyboard_rows[row];
+			if (*p >= 'a' && *p <= 'z') {
+				key_row[*p - 'a' + 'A'] = row + 1;
+				key_col[*p - 'a' + 'A'] = p - keyboard_rows[row];
+			}
+		}
+	}
+
+	for (size_t i = 0; i < COMMON_WORD_COUNT; i++) {
+		int first = common_words[i][0] - 'a';
+		bucket[first][bucket_length[first]++] = i;
+		word_length[i] = strlen(common_words[i]);
+	}
+
+	for (int i = 1; i < LOG2_TABLE_SIZE; i++)
+		log2_table[i] = log2_approx(i);
+
+	tables_ready = true;
+}
+
+
+static double
+log2_of(size_t n)
+{
+	return (n < LOG2_TABLE_SIZE ? log2_table[n] : log2_approx(n));
+}
+
+
+static uint32_t
+letters_of(wchar_t c)
+{
+	return (c < 128 && c >= 0 ? letter_mask[c] : 0);
+}
+
+
+/*
+ * Number of possible characters, in bits, for a brute force over the classes
+ * found in the password.
+ */
+static double
+brute_force_bits(const wchar_t *s, size_t len)
+{
+	bool lower = false, upper = false, digit = false, symbol = false;
+	bool other = false;
+	unsigned int pool = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] >= 128 || s[i] < 0) {
+			other = true;
+		} else if (s[i] >= L'0' && s[i] <= L'9') {
+			digit = true;
+		} else if (s[i] >= L'a' && s[i] <= L'z') {
+			lower = true;
+		} else if (s[i] >= L'A' && s[i] <= L'Z') {
+			upper = true;
+		} else {
+			symbol = true;
+		}
+	}
+
+	pool = (lower ? 26 : 0) + (upper ? 26 : 0) + (digit ? 10 : 0) +
+	    (symbol ? 33 : 0) + (other ? 100 : 0);
+
+	return (log2_of(pool > 1 ? pool : 2));
+}
+
+
+/*
+ * Length of the run of characters after s[0] whose code points (or keyboard
+ * columns) keep changing by the same +1 or -1. Code point sequences stay
+ * within digits or letters.
+ */
+static size_t
+sequence_length(const wchar_t *s, size_t len, bool keyboard)
+{
+	int delta = 0, step;
+	size_t i;
+
+	for (i = 1; i < len; i++) {
+		if (keyboard) {
+			if (s[i - 1] >= 128 || s[i] >= 128 ||
+			    s[i - 1] < 0 || s[i] < 0 ||
+			    key_row[s[i - 1]] == 0 ||
+			    key_row[s[i - 1]] != key_row[s[i]])
+				break;
+			step = key_col[s[i]] - key_col[s[i - 1]];
+		} else {
+			step = s[i] - s[i - 1];
+			if ((step != 1 && step != -1) ||
+			    !iswalnum(s[i - 1]) || !iswalnum(s[i]) ||
+			    !iswdigit(s[i - 1]) != !iswdigit(s[i]))
+				break;
+		}
+		if ((step != 1 && step != -1) || (delta != 0 && step != delta))
+			break;
+		delta = step;
+	}
+
+	return (i);
+}
+
+
+/*
+ * Check if the common word of the given rank is found at s, return its cost
+ * in bits or a negative value.
+ */
+static double
+word_bits(const wchar_t *s, size_t len, unsigned int rank)
+{
+	const char *w = common_words[rank];
+	size_t wlen = word_length[rank];
+	unsigned int upper = 0, substituted = 0;
+	double bits;
+
+	if (wlen > len)
+		return (-1);
+
+	for (size_t i = 0; i < wlen; i++) {
+		uint32_t bit = 1U << (w[i] - 'a');
+
+		if ((letters_of(s[i]) & bit) == 0)
+			return (-1);
+		if (s[i] < 128 && (substitute_mask[s[i]] & bit) != 0 &&
+		    towlower(s[i]) != (wint_t)w[i])
+			substituted++;
+		else if (iswupper(s[i]))
+			upper++;
+	}
+
+	bits = log2_of(rank + 2);
+	if (upper == wlen || (upper == 1 && iswupper(s[0])))
+		bits += 1;
+	else if (upper > 0)
+		bits += log2_of(wlen) * upper;
+	if (substituted > 0)
+		bits += substituted + 1;
+
+	return (bits);
+}
+
+
+static void
+relax(double *cost, size_t from, size_t to, double bits)
+{
+	if (cost[from] + bits < cost[to])
+		cost[to] = cost[from] + bits;
+}
+
+
+/*
+ * Estimate the strength of a password in bits.
+ */
+double
+audit_strength(const wchar_t *s, size_t len)
+{
+	static double *cost = NULL;
+	static size_t cost_size = 0;
+	double char_bits, bits;
+	uint32_t letters;
+	size_t n, i, k;
+	int first;
+
+	if (len == 0)
+		return (0);
+
+	if (!tables_ready)
+		audit_init_tables();
+
+	if (cost_size < len + 1) {
+		cost_size = len + 1;
+		cost = xrealloc(cost, cost_size, sizeof(double));
+	}
+
+	char_bits = brute_force_bits(s, len);
+	cost[0] = 0;
+	for (i = 1; i <= len; i++)
+		cost[i] = char_bits * i;
+
+	for (i = 0; i < len; i++) {
+		relax(cost, i, i + 1, char_bits);
+
+		/* aaaa */
+		for (n = 1; i + n < len && s[i + n] == s[i]; n++)
+			;
+		for (k = MIN_PATTERN_LENGTH; k <= n; k++)
+			relax(cost, i, i + k, char_bits + log2_of(k));
+
+		/* abcd, 4321 */
+		n = sequence_length(s + i, len - i, false);
+		bits = (s[i] == L'a' || s[i] == L'1' || s[i] == L'z' ||
+		    s[i] == L'9') ? 1 : log2_of(iswdigit(s[i]) ? 10 : 26);
+		for (k = MIN_PATTERN_LENGTH; k <= n; k++)
+			relax(cost, i, i + k, bits + log2_of(k) + 1);
+
+		/* qwerty, 7890 */
+		n = sequence_length(s + i, len - i, true);
+		for (k = MIN_PATTERN_LENGTH; k <= n; k++)
+			relax(cost, i, i + k, log2_of(47) +
+			    log2_of(k) + 1);
+
+		/* 1987, 2015 */
+		if (i + 4 <= len && iswdigit(s[i]) && iswdigit(s[i + 1]) &&
+		    iswdigit(s[i + 2]) && iswdigit(s[i + 3]) &&
+		    ((s[i] == L'1' && s[i + 1] == L'9') ||
+		    (s[i] == L'2' && s[i + 1] == L'0')))
+			relax(cost, i, i + 4, log2_of(120));
+
+		/* p@ssw0rd */
+		letters = letters_of(s[i]);
+		for (first = 0; letters != 0; first++, letters >>= 1) {
+			if ((letters & 1) == 0)
+				continue;
+			for (k = 0; k < bucket_length[first]; k++) {
+				unsigned int rank = bucket[first][k];
+
+				if ((bits = word_bits(s + i, len - i, rank)) >= 0)
+					relax(cost, i, i + word_length[rank],
+					    bits);
+			}
+		}
+	}
+
+	return (cost[len]);
+}
+
+
+/*
+ * Find the password of a line: the given field counting from 1 (or from the
+ * end if negative), by default the last field of lines with at least two.
+ */
+static bool
+audit_field(const wchar_t *s, int field, const wchar_t **start, size_t *len)
+{
+	const wchar_t *p;
+	int count = 0, index;
+
+	for (p = s + wcsspn(s, FIELD_SEPARATORS); *p != L'\0';
+	    p += wcsspn(p, FIELD_SEPARATORS)) {
+		p += wcscspn(p, FIELD_SEPARATORS);
+		count++;
+	}
+
+	if (field == 0) {
+		if (count < 2)
+			return (false);
+		index = count - 1;
+	} else if (field < 0) {
+		index = count + field;
+	} else {
+		index = field - 1;
+	}
+
+	if (index < 0 || index >= count)
+		return (false);
+
+	for (p = s + wcsspn(s, FIELD_SEPARATORS); index > 0; index--) {
+		p += wcscspn(p, FIELD_SEPARATORS);
+		p += wcsspn(p, FIELD_SEPARATORS);
+	}
+
+	*start = p;
+	*len = wcscspn(p, FIELD_SEPARATORS);
+
+	return (true);
+}
+
+
+static uint32_t
+audit_hash(const wchar_t *s, size_t len)
+{
+	uint32_t h = 2166136261U;
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= (uint32_t)s[i];
+		h *= 16777619U;
+	}
+
+	return (h);
+}
+
+
+/*
+ * Link each entry to the first one with the same password, with a hash table
+ * so the whole file is covered in one pass.
+ */
+static void
+audit_find_duplicates(struct audit_entry *entries, uint32_t count)
+{
+	struct audit_entry *e, *first;
+	uint32_t *slots, size = 16, mask, slot;
+
+	while (size < count * 2)
+		size *= 2;
+	mask = size - 1;
+	slots = xcalloc(size, sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < count; i++) {
+		e = &entries[i];
+		slot = audit_hash(e->secret, e->len) & mask;
+		for (; slots[slot] != 0; slot = (slot + 1) & mask) {
+			first = &entries[slots[slot] - 1];
+			if (first->len == e->len &&
+			    wmemcmp(first->secret, e->secret, e->len) == 0)
+				break;
+		}
+
+		if (slots[slot] == 0) {
+			slots[slot] = i + 1;
+			e->leader = true;
+			e->first = i;
+			e->tail = i;
+			continue;
+		}
+
+		e->first = slots[slot] - 1;
+		first = &entries[e->first];
+		entries[first->tail].next = i;
+		first->tail = i;
+		first->count++;
+	}
+
+	xfree(slots);
+}
+
+
+/*
+ * Report the lines sharing a password and the lines with a password estimated
+ * below minimum bits. Comments and empty lines are skipped. Returns the
+ * number of problems found.
+ */
+unsigned int
+audit_results(FILE *fp, int field, unsigned int minimum)
+{
+	struct audit_entry *entries;
+	unsigned int problems = 0;
+	const wchar_t *s;
+	uint32_t count = 0;
+	double bits;
+
+	entries = xcalloc(ARRAY_LENGTH(&results) + 1,
+	    sizeof(struct audit_entry));
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
+		s = ARRAY_ITEM(&results, i)->wcs_value;
+		s += wcsspn(s, FIELD_SEPARATORS);
+		if (*s == L'\0' || *s == L'#')
+			continue;
+		if (!audit_field(s, field, &entries[count].secret,
+		    &entries[count].len))
+			continue;
+		entries[count].line = i + 1;
+		entries[count].next = NO_ENTRY;
+		entries[count].count = 1;
+		count++;
+	}
+
+	audit_find_duplicates(entries, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (!entries[i].leader || entries[i].count < 2)
+			continue;
+		fprintf(fp, "lines %u", entries[i].line);
+		for (uint32_t j = entries[i].next; j != NO_ENTRY;
+		    j = entries[j].next)
+			fprintf(fp, ", %u", entries[j].line);
+		fprintf(fp, ": same password\n");
+		problems++;
+	}
+
+	/* The first line with a password always comes before the others. */
+	for (uint32_t i = 0; i < count; i++) {
+		if (entries[i].leader)
+			entries[i].bits = audit_strength(entries[i].secret,
+			    entries[i].len);
+		bits = entries[entries[i].first].bits;
+		if (bits < minimum) {
+			fprintf(fp, "line %u: weak password (%.0f bits)\n",
+			    entries[i].line, bits);
+			problems++;
+		}
+	}
+
+	xfree(entries);
+
+	return (problems);
+}
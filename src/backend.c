@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * Choice of the backend (see backend.h) for each file of the store: files
+ * are written with the configured backend and read with the backend of their
+ * format, whatever the configuration, so the backend can be changed at any
+ * time.
+ */
+
+#include <string.h>
+
+#include "backend.h"
+#include "config.h"
+
+
+static const struct backend_ops *backends[] = {
+	&native_backend,
+	&chunked_backend,
+	&gpg_backend,
+};
+
+
+/*
+ * Backend writing the given target, the password file or a journal segment.
+ * The chunked backend only applies to the password file, the segments are
+ * written by the native backend.
+ */
+const struct backend_ops *
+backend_get(const char *target)
+{
+	switch (cfg_backend) {
+	case BACKEND_CHUNKED:
+		if (strcmp(target, cfg_password_file) == 0)
+			return (&chunked_backend);
+		return (&native_backend);
+	case BACKEND_NATIVE:
+		return (&native_backend);
+	default:
+		return (&gpg_backend);
+	}
+}
+
+
+/*
+ * Backend reading the given file, gpg unless another backend recognizes it.
+ */
+const struct backend_ops *
+backend_for_file(const char *path)
+{
+	for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+		if (backends[i]->is_file != NULL && backends[i]->is_file(path))
+			return (backends[i]);
+	}
+
+	return (&gpg_backend);
+}
+
+
+/*
+ * Let every backend clean up after a save of the password file, not only the
+ * one that wrote it: blocks of the chunked backend are removed once it is no
+ * longer used.
+ */
+void
+backend_collect(const char *target)
+{
+	for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+		if (backends[i]->collect != NULL)
+			backends[i]->collect(target);
+	}
+}
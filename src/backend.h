@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef _BACKEND_H_
+#define _BACKEND_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+
+struct gpg_plain;
+
+/*
+ * A backend encrypts and decrypts the files of the store, gpg.c drives it:
+ * decryption through gpg_decrypt_all(), encryption through gpg_encrypt_open()
+ * and gpg_encrypt_close() which take care of the temporary file, the backup
+ * and the rename. The optional operations are NULL.
+ *
+ *	check		ensure the backend can be used (or exit)
+ *	is_file		whether a file is in the format of the backend
+ *	decrypt_open	start decrypting file->path, the plain-text is read
+ *			from file->fd, returns false on error
+ *	decrypt_close	wait for the end of the decryption (file->fd reached
+ *			EOF or was given up on), sets file->retcode
+ *	decrypt_expire	(optional) interrupt a decryption past its deadline,
+ *			called again if it is still running KILL_GRACE_MS
+ *			later, without it a decryption has no deadline
+ *	encrypt_open	start encrypting to the given descriptor for the
+ *			given target, returns the stream of the plain-text
+ *	encrypt_close	flush the plain-text, wait for the cipher-text to be
+ *			written, returns false on error
+ *	collect		(optional) remove what the previous saves of the
+ *			password file left behind, after each save
+ */
+struct backend_ops {
+	const char	*name;
+	void		 (*check)(void);
+	bool		 (*is_file)(const char *);
+	bool		 (*decrypt_open)(struct gpg_plain *);
+	void		 (*decrypt_close)(struct gpg_plain *);
+	void		 (*decrypt_expire)(struct gpg_plain *);
+	FILE		*(*encrypt_open)(int, const char *, void **);
+	bool		 (*encrypt_close)(FILE *, void *);
+	void		 (*collect)(const char *);
+};
+
+extern const struct backend_ops gpg_backend;
+extern const struct backend_ops native_backend;
+extern const struct backend_ops chunked_backend;
+
+const struct backend_ops *backend_get(const char *);
+const struct backend_ops *backend_for_file(const char *);
+void		 backend_collect(const char *);
+
+#endif /* _BACKEND_H_ */
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * ChaCha20 as described in RFC 8439 (32-bit counter, 96-bit nonce) and the
+ * HChaCha20 sub-key derivation used by XChaCha20.
+ */
+
+#include <string.h>
+
+#include "chacha.h"
+
+
+#define ROTL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d) do {				\
+	a += b; d ^= a; d = ROTL(d, 16);			\
+	c += d; b ^= c; b = ROTL(b, 12);			\
+	a += b; d ^= a; d = ROTL(d, 8);				\
+	c += d; b ^= c; b = ROTL(b, 7);				\
+} while (0)
+
+#define DOUBLEROUNDS(x) do {					\
+	for (int i = 0; i < 10; i++) {				\
+		QUARTERROUND(x[0], x[4], x[8], x[12]);		\
+		QUARTERROUND(x[1], x[5], x[9], x[13]);		\
+		QUARTERROUND(x[2], x[6], x[10], x[14]);		\
+		QUARTERROUND(x[3], x[7], x[11], x[15]);		\
+		QUARTERROUND(x[0], x[5], x[10], x[15]);		\
+		QUARTERROUND(x[1], x[6], x[11], x[12]);		\
+		QUARTERROUND(x[2], x[7], x[8], x[13]);		\
+		QUARTERROUND(x[3], x[4], x[9], x[14]);		\
+	}							\
+} while (0)
+
+/*
+ * With GCC and clang, four blocks can be computed at once, one per lane of a
+ * 128-bit vector (SSE2 on amd64, NEON on arm64, plain words elsewhere).
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define CHACHA_HAVE_VECTOR
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+#endif
+
+
+static uint32_t
+load32_le(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+	    (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+
+static void
+store32_le(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+
+/*
+ * The 20 rounds, applied in place.
+ */
+static void
+chacha20_rounds(uint32_t x[16])
+{
+	DOUBLEROUNDS(x);
+}
+
+
+#ifdef CHACHA_HAVE_VECTOR
+/*
+ * Produce four consecutive blocks of key stream (256 bytes).
+ */
+static void
+chacha20_block4(uint32_t state[16], uint8_t *out)
+{
+	v4u32 x[16], s[16];
+
+	for (int i = 0; i < 16; i++)
+		s[i] = (v4u32){ state[i], state[i], state[i], state[i] };
+	s[12] += (v4u32){ 0, 1, 2, 3 };
+	memcpy(x, s, sizeof(x));
+
+	DOUBLEROUNDS(x);
+
+	for (int i = 0; i < 16; i++)
+		x[i] += s[i];
+	for (int j = 0; j < 4; j++)
+		for (int i = 0; i < 16; i++)
+			store32_le(out + j * CHACHA_BLOCK_LENGTH + i * 4,
+			    x[i][j]);
+
+	state[12] += 4;
+	memset(x, 0, sizeof(x));
+}
+#endif
+
+
+/*
+ * Set up the state for the given key, block counter and nonce.
+ */
+void
+chacha20_init(uint32_t state[16], const uint8_t *key,
+    uint32_t counter, const uint8_t *nonce)
+{
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	for (int i = 0; i < 8; i++)
+		state[4 + i] = load32_le(key + i * 4);
+	state[12] = counter;
+	for (int i = 0; i < 3; i++)
+		state[13 + i] = load32_le(nonce + i * 4);
+}
+
+
+/*
+ * Produce the next 64 bytes of key stream and increment the block counter.
+ */
+void
+chacha20_block(uint32_t state[16], uint8_t *out)
+{
+	uint32_t x[16];
+
+	memcpy(x, state, sizeof(x));
+	chacha20_rounds(x);
+
+	for (int i = 0; i < 16; i++)
+		store32_le(out + i * 4, x[i] + state[i]);
+
+	state[12]++;
+	memset(x, 0, sizeof(x));
+}
+
+
+/*
+ * Produce count blocks of key stream, four at a time when possible.
+ */
+void
+chacha20_blocks(uint32_t state[16], uint8_t *out, size_t count)
+{
+#ifdef CHACHA_HAVE_VECTOR
+	for (; count >= 4; count -= 4) {
+		chacha20_block4(state, out);
+		out += 4 * CHACHA_BLOCK_LENGTH;
+	}
+#endif
+	for (; count > 0; count--) {
+		chacha20_block(state, out);
+		out += CHACHA_BLOCK_LENGTH;
+	}
+}
+
+
+/*
+ * XOR len bytes of src with the key stream into dst (which may be src).
+ */
+void
+chacha20_xor(uint32_t state[16], uint8_t *dst, const uint8_t *src,
+    size_t len)
+{
+	uint8_t block[4 * CHACHA_BLOCK_LENGTH];
+	size_t n, count;
+
+	while (len > 0) {
+		count = (len + CHACHA_BLOCK_LENGTH - 1) / CHACHA_BLOCK_LENGTH;
+		chacha20_blocks(state, block, count < 4 ? count : 4);
+		n = len < sizeof(block) ? len : sizeof(block);
+		for (size_t i = 0; i < n; i++)
+			dst[i] = src[i] ^ block[i];
+		dst += n;
+		src += n;
+		len -= n;
+	}
+
+	memset(block, 0, sizeof(block));
+}
+
+
+/*
+ * Derive a sub-key from a key and the first 16 bytes of an XChaCha20 nonce.
+ */
+void
+hchacha20(uint8_t *out, const uint8_t *key, const uint8_t *nonce)
+{
+	uint32_t x[16];
+
+	x[0] = 0x61707865;
+	x[1] = 0x3320646e;
+	x[2] = 0x79622d32;
+	x[3] = 0x6b206574;
+	for (int i = 0; i < 8; i++)
+		x[4 + i] = load32_le(key + i * 4);
+	for (int i = 0; i < 4; i++)
+		x[12 + i] = load32_le(nonce + i * 4);
+
+	chacha20_rounds(x);
+
+	for (int i = 0; i < 4; i++) {
+		store32_le(out + i * 4, x[i]);
+		store32_le(out + 16 + i * 4, x[12 + i]);
+	}
+
+	memset(x, 0, sizeof(x));
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _CHACHA_H_
+#define _CHACHA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHACHA_KEY_LENGTH	32
+#define CHACHA_NONCE_LENGTH	12
+#define CHACHA_BLOCK_LENGTH	64
+
+void		 chacha20_init(uint32_t [16], const uint8_t *, uint32_t,
+		     const uint8_t *);
+void		 chacha20_block(uint32_t [16], uint8_t *);
+void		 chacha20_blocks(uint32_t [16], uint8_t *, size_t);
+void		 chacha20_xor(uint32_t [16], uint8_t *, const uint8_t *, size_t);
+void		 hchacha20(uint8_t *, const uint8_t *, const uint8_t *);
+
+#endif /* _CHACHA_H_ */
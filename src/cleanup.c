@@ -21,6 +21,7 @@
 #include "cleanup.h"
 #include "debug.h"
 #include "editor.h"
+#include "gpg.h"
 #include "lock.h"
 #include "ui-curses.h"
 
@@ -37,6 +38,10 @@ cleanup(void)
 		err(EXIT_FAILURE, "unable to remove '%s'", editor_tmp_path);
 	}
 
+	/* Cipher-text of an interrupted save. */
+	if (gpg_tmp_path != NULL)
+		unlink(gpg_tmp_path);
+
 	/* Just in case we error'd out somewhere during the pager. */
 	shutdown_curses();
 }
@@ -24,21 +24,30 @@
 #include <stdarg.h>
 #include <err.h>
 
+#include "audit.h"
 #include "cmd.h"
 #include "debug.h"
 #include "keywords.h"
+#include "mdp.h"
 #include "str.h"
 #include "xmalloc.h"
 
 
 wchar_t		*cmd_add_prefix = NULL;
+unsigned int	 cmd_audit_minimum = AUDIT_DEFAULT_MINIMUM;
+char		*cmd_batch_path = NULL;
 char		*cmd_config_path = NULL;
 char		*cmd_gpg_key_id = NULL;
 char		*cmd_profile_name = NULL;
 bool		 cmd_regex = false;
 bool		 cmd_raw = false;
+enum output_format cmd_output_format = OUTPUT_LINES;
+int		 cmd_output_field = 0;
 unsigned int	 cmd_character_count = 0;
+bool		 cmd_entropy = false;
+unsigned int	 cmd_job_count = 1;
 unsigned int	 cmd_password_count = 0;
+wchar_t		*cmd_value = NULL;
 
 
 /*
@@ -62,6 +71,51 @@ command_match(const char *s, const char *name, size_t min)
 }
 
 
+/*
+ * Parse the argument of -f, a non-zero field number (negative from the end),
+ * trailing garbage (e.g. "1x") is refused.
+ */
+static int
+parse_field(const char *s)
+{
+	char *end;
+	intmax_t field;
+
+	field = strtoimax(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || field == 0 || field < INT_MIN ||
+			field > INT_MAX)
+		errx(EXIT_FAILURE, "invalid field: %s", s);
+
+	return ((int)field);
+}
+
+
+/*
+ * Parse the number of generating threads, capped to the online processors
+ * since more threads only wait on each other.
+ */
+static unsigned int
+parse_jobs(const char *s)
+{
+	char *end;
+	intmax_t jobs;
+	long cpus;
+
+	jobs = strtoimax(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || jobs < 1 || jobs > CMD_MAX_JOBS)
+		errx(EXIT_FAILURE, "jobs must be between 1 and %d",
+				CMD_MAX_JOBS);
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0 && jobs > cpus) {
+		debug("parse_jobs: %jd jobs capped to %ld", jobs, cpus);
+		jobs = cpus;
+	}
+
+	return ((unsigned int)jobs);
+}
+
+
 /*
  * Core usage and parse (everything before the command).
  */
@@ -80,10 +134,15 @@ cmd_usage_core_with_commands(void)
 	printf("\n");
 	printf("The mdp commands are:\n");
 	printf("   add        Add new random passwords at the end of your file.\n");
+	printf("   audit      Report reused and weak passwords.\n");
+	printf("   compact    Fold the journal segments in the password file.\n");
 	printf("   edit       Edit your passwords.\n");
 	printf("   generate   Generate random passwords.\n");
 	printf("   get        Get passwords by keywords or regexes.\n");
 	printf("   prompt     Interactive prompt session.\n");
+	printf("   replace    Replace the line matching the keywords.\n");
+	printf("   rm         Remove the line matching the keywords.\n");
+	printf("   set        Set the password of the line matching the keywords.\n");
 	printf("\n");
 	printf("'mdp <command> -h' returns this command's usage.\n");
 }
@@ -205,6 +264,86 @@ cmd_parse_add(int argc, char **argv)
 }
 
 
+/*
+ * mdp audit usage and parse
+ */
+
+static void
+cmd_usage_audit(void)
+{
+	printf("usage: mdp au[dit] [-h] [-m bits] [-f field]\n");
+}
+
+void
+cmd_parse_audit(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "hm:f:")) != -1) {
+		switch (opt) {
+		case 'h':
+			cmd_usage_audit();
+			exit(EXIT_FAILURE);
+		case 'm':
+			cmd_audit_minimum = strtoumax(optarg, NULL, 10);
+			break;
+		case 'f':
+			cmd_output_field = parse_field(optarg);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+			break;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc > 0) {
+		cmd_usage_audit();
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/*
+ * mdp compact usage and parse
+ */
+
+static void
+cmd_usage_compact(void)
+{
+	printf("usage: mdp c[ompact] [-h] [-k key_id]\n");
+}
+
+void
+cmd_parse_compact(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "hk:")) != -1) {
+		switch (opt) {
+		case 'h':
+			cmd_usage_compact();
+			exit(EXIT_FAILURE);
+		case 'k':
+			cmd_gpg_key_id = strdup(optarg);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+			break;
+		}
+	}
+
+	argc -= optind;
+
+	if (argc > 0) {
+		cmd_usage_compact();
+		exit(EXIT_FAILURE);
+	}
+}
+
+
 /*
  * mdp edit usage and parse
  */
@@ -252,8 +391,8 @@ cmd_parse_edit(int argc, char **argv)
 static void
 cmd_usage_generate(void)
 {
-	printf("usage: mdp gen[erate] [-h] [-p profile] [-n count] "
-			"[-l length]\n");
+	printf("usage: mdp gen[erate] [-he] [-p profile] [-n count] "
+			"[-l length] [-j jobs]\n");
 }
 
 void
@@ -261,17 +400,23 @@ cmd_parse_generate(int argc, char **argv)
 {
 	int opt;
 
-	while ((opt = getopt(argc, argv, "hp:l:n:")) != -1) {
+	while ((opt = getopt(argc, argv, "hep:l:n:j:")) != -1) {
 		switch (opt) {
 		case 'h':
 			cmd_usage_generate();
 			exit(EXIT_FAILURE);
+		case 'e':
+			cmd_entropy = true;
+			break;
 		case 'p':
 			cmd_profile_name = strdup(optarg);
 			break;
 		case 'l':
 			cmd_character_count = strtoumax(optarg, NULL, 10);
 			break;
+		case 'j':
+			cmd_job_count = parse_jobs(optarg);
+			break;
 		case 'n':
 			cmd_password_count = strtoumax(optarg, NULL, 10);
 			break;
@@ -298,7 +443,8 @@ cmd_parse_generate(int argc, char **argv)
 static void
 cmd_usage_get(void)
 {
-	printf("usage: mdp get [-hrE] keyword ...\n");
+	printf("usage: mdp get [-hrE] [-o format] [-f field] keyword ...\n");
+	printf("       mdp get [-hE] [-o format] [-f field] -b file\n");
 }
 
 void
@@ -306,17 +452,28 @@ cmd_parse_get(int argc, char **argv)
 {
 	int opt;
 
-	while ((opt = getopt(argc, argv, "hrE")) != -1) {
+	while ((opt = getopt(argc, argv, "hrEb:o:f:")) != -1) {
 		switch (opt) {
 		case 'h':
 			cmd_usage_get();
 			exit(EXIT_FAILURE);
+		case 'b':
+			cmd_batch_path = strdup(optarg);
+			break;
 		case 'r':
 			cmd_raw = true;
 			break;
 		case 'E':
 			cmd_regex = true;
 			break;
+		case 'o':
+			cmd_output_format = output_format_parse(optarg);
+			cmd_raw = true;
+			break;
+		case 'f':
+			cmd_output_field = parse_field(optarg);
+			cmd_raw = true;
+			break;
 		default:
 			exit(EXIT_FAILURE);
 			break;
@@ -326,6 +483,15 @@ cmd_parse_get(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
+	/* Keywords are read from the batch file instead. */
+	if (cmd_batch_path != NULL) {
+		if (argc > 0) {
+			cmd_usage_get();
+			exit(EXIT_FAILURE);
+		}
+		return;
+	}
+
 	if (argc == 0) {
 		cmd_usage_get();
 		exit(EXIT_FAILURE);
@@ -372,3 +538,163 @@ cmd_parse_prompt(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 }
+
+
+/*
+ * 'mdp set', 'mdp rm' and 'mdp replace' - usage and parse
+ */
+
+static void
+cmd_usage_set(void)
+{
+	printf("usage: mdp set [-hE] [-p profile] [-l length] [-k key_id] "
+			"[-v -]\n");
+	printf("               [-o format] [-f field] keyword ...\n");
+	printf("       mdp set [-hE] [-p profile] [-l length] [-k key_id] "
+			"-b file\n");
+}
+
+static void
+cmd_usage_rm(void)
+{
+	printf("usage: mdp rm [-hE] [-k key_id] keyword ...\n");
+	printf("       mdp rm [-hE] [-k key_id] -b file\n");
+}
+
+static void
+cmd_usage_replace(void)
+{
+	printf("usage: mdp replace [-hE] [-k key_id] -t - keyword ...\n");
+	printf("       mdp replace [-hE] [-k key_id] -b file\n");
+}
+
+
+/*
+ * Read the new value given with '-v -' or '-t -' from stdin. It doesn't
+ * belong on the command line, where other users see it (ps, /proc) and the
+ * shell keeps it in its history.
+ */
+static wchar_t *
+cmd_read_value(void)
+{
+	static char line[MAX_LINE_SIZE];
+	wchar_t *value;
+
+	if (fgets(line, sizeof(line), stdin) == NULL)
+		errx(EXIT_FAILURE, "unable to read the new value from stdin");
+
+	strip_trailing_whitespaces(line);
+	if (line[0] == '\0')
+		errx(EXIT_FAILURE, "empty value on stdin");
+
+	value = mbs_duplicate_as_wcs(line);
+	memset(line, 0, sizeof(line));
+	if (value == NULL) {
+		errx(EXIT_FAILURE, "unable to read the new value (wrong "
+				"locale?)");
+	}
+
+	return (value);
+}
+
+
+/*
+ * Shared by the three commands, 'options' lists the flags each one accepts
+ * on top of -h, -E, -k and -b.
+ */
+static void
+cmd_parse_mutation(int argc, char **argv, const char *options,
+		void (*usage)(void))
+{
+	char optstring[32];
+	bool from_stdin = false;
+	int opt;
+
+	snprintf(optstring, sizeof(optstring), "hEk:b:%s", options);
+
+	while ((opt = getopt(argc, argv, optstring)) != -1) {
+		switch (opt) {
+		case 'h':
+			usage();
+			exit(EXIT_FAILURE);
+		case 'E':
+			cmd_regex = true;
+			break;
+		case 'k':
+			cmd_gpg_key_id = strdup(optarg);
+			break;
+		case 'b':
+			cmd_batch_path = strdup(optarg);
+			break;
+		case 'p':
+			cmd_profile_name = strdup(optarg);
+			break;
+		case 'l':
+			cmd_character_count = strtoumax(optarg, NULL, 10);
+			break;
+		case 'o':
+			cmd_output_format = output_format_parse(optarg);
+			break;
+		case 'f':
+			cmd_output_field = parse_field(optarg);
+			break;
+		case 't':
+		case 'v':
+			if (strcmp(optarg, "-") != 0) {
+				errx(EXIT_FAILURE, "-%c: the new value is read "
+						"from stdin, use -%c -", opt,
+						opt);
+			}
+			from_stdin = true;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+			break;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	/* Keywords and values are read from the batch file instead. */
+	if (cmd_batch_path != NULL) {
+		if (argc > 0 || from_stdin) {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+		return;
+	}
+
+	if (argc == 0) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	keywords_load_from_argv(argv);
+
+	if (from_stdin)
+		cmd_value = cmd_read_value();
+}
+
+void
+cmd_parse_set(int argc, char **argv)
+{
+	cmd_parse_mutation(argc, argv, "p:l:v:o:f:", cmd_usage_set);
+}
+
+void
+cmd_parse_rm(int argc, char **argv)
+{
+	cmd_parse_mutation(argc, argv, "", cmd_usage_rm);
+}
+
+void
+cmd_parse_replace(int argc, char **argv)
+{
+	cmd_parse_mutation(argc, argv, "t:", cmd_usage_replace);
+
+	if (cmd_batch_path == NULL && cmd_value == NULL) {
+		cmd_usage_replace();
+		exit(EXIT_FAILURE);
+	}
+}
@@ -20,6 +20,10 @@
 #include <stdbool.h>
 #include <wchar.h>
 
+#include "output.h"
+
+#define CMD_MAX_JOBS	64
+
 enum command {
 	COMMAND_VERSION,
 	COMMAND_USAGE,
@@ -30,21 +34,33 @@ enum command {
 };
 
 extern wchar_t		*cmd_add_prefix;
+extern unsigned int	 cmd_audit_minimum;
+extern char		*cmd_batch_path;
 extern char		*cmd_config_path;
 extern char		*cmd_gpg_key_id;
 extern char		*cmd_profile_name;
 extern bool		 cmd_regex;
 extern bool		 cmd_raw;
+extern enum output_format cmd_output_format;
+extern int		 cmd_output_field;
 extern unsigned int	 cmd_character_count;
+extern bool		 cmd_entropy;
+extern unsigned int	 cmd_job_count;
 extern unsigned int	 cmd_password_count;
+extern wchar_t		*cmd_value;
 
 enum command		 cmd_parse(int, char **);
 int			 cmd_parse_core(int, char **);
 void			 cmd_parse_add(int, char **);
+void			 cmd_parse_audit(int, char **);
+void			 cmd_parse_compact(int, char **);
 void			 cmd_parse_edit(int, char **);
 void			 cmd_parse_generate(int, char **);
 void			 cmd_parse_get(int, char **);
 void			 cmd_parse_prompt(int, char **);
+void			 cmd_parse_replace(int, char **);
+void			 cmd_parse_rm(int, char **);
+void			 cmd_parse_set(int, char **);
 void			 cmd_usage_core(void);
 void			 cmd_usage_core_with_commands(void);
 bool			 command_match(const char *, const char *, size_t);
@@ -26,6 +26,7 @@
 #include <wchar.h>
 #include <stdbool.h>
 
+#include "agent.h"
 #include "cmd.h"
 #include "config.h"
 #include "lock.h"
@@ -34,20 +35,41 @@
 #include "str.h"
 #include "strdelim.h"
 #include "utils.h"
+#include "wordlist.h"
 #include "xmalloc.h"
 #include "wcsdup.h"
 
 
+enum backend	 cfg_backend = BACKEND_GPG;
 bool		 cfg_backup = true;
 unsigned int	 cfg_character_count = DEFAULT_CHARACTER_COUNT;
 wchar_t		*cfg_character_set = NULL;
 char		*cfg_editor = NULL;
+bool		 cfg_edit_fallback = true;
+enum edit_storage cfg_edit_storage = EDIT_STORAGE_TMPFS;
+wchar_t		*cfg_excluded_characters = NULL;
+unsigned int	 cfg_gpg_jobs = 0;
 char		*cfg_gpg_path = NULL;
 char		*cfg_gpg_key_id = NULL;
 unsigned int	 cfg_gpg_timeout = 20;
+bool		 cfg_journal = false;
+char		*cfg_key_file = NULL;
+unsigned int	 cfg_lock_timeout = 10;
+unsigned int	 cfg_minimum_digits = 0;
+unsigned int	 cfg_minimum_lowercase = 0;
+unsigned int	 cfg_minimum_symbols = 0;
+unsigned int	 cfg_minimum_uppercase = 0;
 unsigned int	 cfg_password_count = DEFAULT_PASSWORD_COUNT;
 char		*cfg_password_file = NULL;
+bool		 cfg_prompt_prefetch = true;
+unsigned int	 cfg_session_cache = 0;
+char		*cfg_storage_get_command = NULL;
+char		*cfg_storage_put_command = NULL;
+char		*cfg_syllable_set = NULL;
 unsigned int	 cfg_timeout = 10;
+unsigned int	 cfg_word_count = DEFAULT_WORD_COUNT;
+char		*cfg_word_list = NULL;
+char		*cfg_word_separator = NULL;
 
 
 #define parse_boolean(v) (v != NULL && *v == 'o') ? true : false
@@ -78,6 +100,8 @@ config_resolve_character_set(const char *value)
 			character_set = wcsdup(CHARSET_SYMBOLS);
 		} else if (streq(value, "$PRINTABLE")) {
 			character_set = wcsdup(CHARSET_PRINTABLE);
+		} else if (streq(value, "$AMBIGUOUS")) {
+			character_set = wcsdup(CHARSET_AMBIGUOUS);
 		}
 	}
 
@@ -89,6 +113,20 @@ config_resolve_character_set(const char *value)
 }
 
 
+/*
+ * Replace the string at *dst by a copy of value (or NULL).
+ */
+static void
+replace_string(char **dst, const char *value)
+{
+	if (*dst != NULL) {
+		xfree(*dst);
+	}
+
+	*dst = value != NULL ? strdup(value) : NULL;
+}
+
+
 /*
  * Sets the value of the given variable, also do some type check
  * just in case.
@@ -96,8 +134,24 @@ config_resolve_character_set(const char *value)
 static void
 set_variable(char *name, char *value, int linenum)
 {
+	/* set backend gpg|native|chunked */
+	if (strcmp(name, "backend") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for backend");
+		}
+
+		if (strcmp(value, "gpg") == 0) {
+			cfg_backend = BACKEND_GPG;
+		} else if (strcmp(value, "native") == 0) {
+			cfg_backend = BACKEND_NATIVE;
+		} else if (strcmp(value, "chunked") == 0) {
+			cfg_backend = BACKEND_CHUNKED;
+		} else {
+			conf_err("invalid value for backend");
+		}
+
 	/* set backup <bool> */
-	if (strcmp(name, "backup") == 0) {
+	} else if (strcmp(name, "backup") == 0) {
 		cfg_backup = parse_boolean(value);
 
 	/* set character_count <integer> */
@@ -122,6 +176,28 @@ set_variable(char *name, char *value, int linenum)
 			err(EXIT_FAILURE, "unable to load global "
 					"character_set (wrong locale?)");
 		}
+		replace_string(&cfg_word_list, NULL);
+		replace_string(&cfg_syllable_set, NULL);
+
+	/* set edit_fallback <bool> */
+	} else if (strcmp(name, "edit_fallback") == 0) {
+		cfg_edit_fallback = parse_boolean(value);
+
+	/* set edit_storage memfd|tmpfs|disk */
+	} else if (strcmp(name, "edit_storage") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for edit_storage");
+		}
+
+		if (strcmp(value, "memfd") == 0) {
+			cfg_edit_storage = EDIT_STORAGE_MEMFD;
+		} else if (strcmp(value, "tmpfs") == 0) {
+			cfg_edit_storage = EDIT_STORAGE_TMPFS;
+		} else if (strcmp(value, "disk") == 0) {
+			cfg_edit_storage = EDIT_STORAGE_DISK;
+		} else {
+			conf_err("invalid value for edit_storage");
+		}
 
 	/* set editor <string> */
 	} else if (strcmp(name, "editor") == 0) {
@@ -134,6 +210,29 @@ set_variable(char *name, char *value, int linenum)
 		}
 		cfg_editor = strdup(value);
 
+	/* set excluded_characters <string> */
+	} else if (strcmp(name, "excluded_characters") == 0) {
+		if (cfg_excluded_characters != NULL) {
+			xfree(cfg_excluded_characters);
+		}
+
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for excluded_characters");
+		}
+		cfg_excluded_characters = config_resolve_character_set(value);
+		if (cfg_excluded_characters == NULL) {
+			err(EXIT_FAILURE, "unable to load global "
+					"excluded_characters (wrong locale?)");
+		}
+
+	/* set gpg_jobs <integer> */
+	} else if (strcmp(name, "gpg_jobs") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for gpg_jobs");
+		}
+
+		cfg_gpg_jobs = strtoull(value, NULL, 10);
+
 	/* set gpg_key_id <string> */
 	} else if (strcmp(name, "gpg_key_id") == 0) {
 		if (cfg_gpg_key_id != NULL) {
@@ -166,6 +265,62 @@ set_variable(char *name, char *value, int linenum)
 
 		cfg_gpg_timeout = strtoull(value, NULL, 10);
 
+	/* set journal <bool> */
+	} else if (strcmp(name, "journal") == 0) {
+		cfg_journal = parse_boolean(value);
+
+	/* set key_file <string> */
+	} else if (strcmp(name, "key_file") == 0) {
+		if (cfg_key_file != NULL) {
+			conf_err("key_file defined multiple times");
+		}
+
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for key_file");
+		}
+
+		cfg_key_file = strdup(value);
+
+	/* set lock_timeout <integer> */
+	} else if (strcmp(name, "lock_timeout") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for lock_timeout");
+		}
+
+		cfg_lock_timeout = strtoull(value, NULL, 10);
+
+	/* set minimum_digits <integer> */
+	} else if (strcmp(name, "minimum_digits") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_digits");
+		}
+
+		cfg_minimum_digits = strtoull(value, NULL, 10);
+
+	/* set minimum_lowercase <integer> */
+	} else if (strcmp(name, "minimum_lowercase") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_lowercase");
+		}
+
+		cfg_minimum_lowercase = strtoull(value, NULL, 10);
+
+	/* set minimum_symbols <integer> */
+	} else if (strcmp(name, "minimum_symbols") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_symbols");
+		}
+
+		cfg_minimum_symbols = strtoull(value, NULL, 10);
+
+	/* set minimum_uppercase <integer> */
+	} else if (strcmp(name, "minimum_uppercase") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_uppercase");
+		}
+
+		cfg_minimum_uppercase = strtoull(value, NULL, 10);
+
 	/* set password_count <integer> */
 	} else if (strcmp(name, "password_count") == 0) {
 		if (value == NULL || *value == '\0') {
@@ -186,6 +341,43 @@ set_variable(char *name, char *value, int linenum)
 
 		cfg_password_file = strdup(value);
 
+	/* set prompt_prefetch <bool> */
+	} else if (strcmp(name, "prompt_prefetch") == 0) {
+		cfg_prompt_prefetch = parse_boolean(value);
+
+	/* set session_cache <integer> */
+	} else if (strcmp(name, "session_cache") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for session_cache");
+		}
+
+		cfg_session_cache = strtoull(value, NULL, 10);
+
+	/* set storage_get_command <string> */
+	} else if (strcmp(name, "storage_get_command") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for storage_get_command");
+		}
+
+		replace_string(&cfg_storage_get_command, value);
+
+	/* set storage_put_command <string> */
+	} else if (strcmp(name, "storage_put_command") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for storage_put_command");
+		}
+
+		replace_string(&cfg_storage_put_command, value);
+
+	/* set syllable_set <string> */
+	} else if (strcmp(name, "syllable_set") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for syllable_set");
+		}
+
+		replace_string(&cfg_syllable_set, value);
+		replace_string(&cfg_word_list, NULL);
+
 	/* set timeout <integer> */
 	} else if (strcmp(name, "timeout") == 0) {
 		if (value == NULL || *value == '\0') {
@@ -194,6 +386,31 @@ set_variable(char *name, char *value, int linenum)
 
 		cfg_timeout = strtoull(value, NULL, 10);
 
+	/* set word_count <integer> */
+	} else if (strcmp(name, "word_count") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for word_count");
+		}
+
+		cfg_word_count = strtoull(value, NULL, 10);
+
+	/* set word_list <string> */
+	} else if (strcmp(name, "word_list") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for word_list");
+		}
+
+		replace_string(&cfg_word_list, value);
+		replace_string(&cfg_syllable_set, NULL);
+
+	/* set word_separator <string> */
+	} else if (strcmp(name, "word_separator") == 0) {
+		if (value == NULL) {
+			conf_err("invalid value for word_separator");
+		}
+
+		replace_string(&cfg_word_separator, value);
+
 	/* ??? */
 	} else {
 		conf_err("unknown variable");
@@ -232,6 +449,59 @@ set_profile_variable(struct profile *profile, char *name, char *value,
 					"character_set for profile '%s' "
 					"(wrong locale?)", profile->name);
 		}
+		replace_string(&profile->word_list, NULL);
+		replace_string(&profile->syllable_set, NULL);
+
+	/* set excluded_characters <string> */
+	} else if (strcmp(name, "excluded_characters") == 0) {
+		if (profile->excluded_characters != NULL) {
+			xfree(profile->excluded_characters);
+		}
+
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for excluded_characters");
+		}
+		profile->excluded_characters =
+				config_resolve_character_set(value);
+		if (profile->excluded_characters == NULL) {
+			err(EXIT_FAILURE, "unable to load excluded_characters "
+					"for profile '%s' (wrong locale?)",
+					profile->name);
+		}
+
+	/* set minimum_digits <unsigned integer> */
+	} else if (strcmp(name, "minimum_digits") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_digits");
+		}
+
+		profile->minimum[RANDPASS_DIGITS] = strtoull(value, NULL, 10);
+
+	/* set minimum_lowercase <unsigned integer> */
+	} else if (strcmp(name, "minimum_lowercase") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_lowercase");
+		}
+
+		profile->minimum[RANDPASS_LOWERCASE] = strtoull(value, NULL,
+				10);
+
+	/* set minimum_symbols <unsigned integer> */
+	} else if (strcmp(name, "minimum_symbols") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_symbols");
+		}
+
+		profile->minimum[RANDPASS_SYMBOLS] = strtoull(value, NULL, 10);
+
+	/* set minimum_uppercase <unsigned integer> */
+	} else if (strcmp(name, "minimum_uppercase") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for minimum_uppercase");
+		}
+
+		profile->minimum[RANDPASS_UPPERCASE] = strtoull(value, NULL,
+				10);
 
 	/* set password_count <unsigned integer> */
 	} else if (strcmp(name, "password_count") == 0) {
@@ -241,6 +511,40 @@ set_profile_variable(struct profile *profile, char *name, char *value,
 
 		profile->password_count = strtoull(value, NULL, 10);
 
+	/* set syllable_set <string> */
+	} else if (strcmp(name, "syllable_set") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for syllable_set");
+		}
+
+		replace_string(&profile->syllable_set, value);
+		replace_string(&profile->word_list, NULL);
+
+	/* set word_count <unsigned integer> */
+	} else if (strcmp(name, "word_count") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for word_count");
+		}
+
+		profile->word_count = strtoull(value, NULL, 10);
+
+	/* set word_list <string> */
+	} else if (strcmp(name, "word_list") == 0) {
+		if (value == NULL || *value == '\0') {
+			conf_err("invalid value for word_list");
+		}
+
+		replace_string(&profile->word_list, value);
+		replace_string(&profile->syllable_set, NULL);
+
+	/* set word_separator <string> */
+	} else if (strcmp(name, "word_separator") == 0) {
+		if (value == NULL) {
+			conf_err("invalid value for word_separator");
+		}
+
+		replace_string(&profile->word_separator, value);
+
 	/* ??? */
 	} else {
 		conf_err("unknown profile variable");
@@ -419,6 +723,12 @@ config_set_defaults(const char *config_dir)
 		cfg_gpg_path = strdup("/usr/bin/gpg");
 	}
 
+	/* One gpg per processor, the work is mostly public key crypto. */
+	if (cfg_gpg_jobs == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		cfg_gpg_jobs = n > 0 ? n : 1;
+	}
+
 	if (cmd_gpg_key_id != NULL) {
 		if (cfg_gpg_key_id != NULL) {
 			xfree(cfg_gpg_key_id);
@@ -430,13 +740,27 @@ config_set_defaults(const char *config_dir)
 		cfg_password_file = join_path(config_dir, "passwords");
 	}
 
+	/* The blocks of a container are not part of the password file. */
+	if (cfg_backend == BACKEND_CHUNKED && (cfg_storage_get_command != NULL ||
+			cfg_storage_put_command != NULL)) {
+		errx(EXIT_FAILURE, "the storage commands can't be used with the "
+				"chunked backend");
+	}
+
+	if (cfg_key_file == NULL) {
+		cfg_key_file = join_path(config_dir, "key");
+	}
+
 	if (cfg_editor == NULL) {
 		fprintf(stderr, "WARNING: neither $EDITOR or 'set editor' was "
 				"defined, defaulting to /usr/bin/vi.\n");
 		cfg_editor = strdup("/usr/bin/vi");
 	}
 
+	wordlist_cache_dir = strdup(config_dir);
 	lock_path = join_path(config_dir, "lock");
+	lock_timeout = cfg_lock_timeout;
+	agent_path = join_path(config_dir, "agent");
 }
 
 
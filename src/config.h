@@ -18,18 +18,51 @@
 #define _CONFIG_H_
 
 #include <stdbool.h>
+#include <wchar.h>
 
+enum backend {
+	BACKEND_GPG,
+	BACKEND_NATIVE,
+	BACKEND_CHUNKED
+};
+
+enum edit_storage {
+	EDIT_STORAGE_MEMFD,
+	EDIT_STORAGE_TMPFS,
+	EDIT_STORAGE_DISK
+};
+
+extern enum backend	 cfg_backend;
 extern bool		 cfg_backup;
 extern unsigned int	 cfg_character_count;
 extern wchar_t		*cfg_character_set;
 extern char		*cfg_config_path;
 extern char		*cfg_editor;
+extern bool		 cfg_edit_fallback;
+extern enum edit_storage cfg_edit_storage;
+extern wchar_t		*cfg_excluded_characters;
+extern unsigned int	 cfg_gpg_jobs;
 extern char		*cfg_gpg_path;
 extern char		*cfg_gpg_key_id;
 extern unsigned int	 cfg_gpg_timeout;
+extern bool		 cfg_journal;
+extern char		*cfg_key_file;
+extern unsigned int	 cfg_lock_timeout;
+extern unsigned int	 cfg_minimum_digits;
+extern unsigned int	 cfg_minimum_lowercase;
+extern unsigned int	 cfg_minimum_symbols;
+extern unsigned int	 cfg_minimum_uppercase;
 extern unsigned int	 cfg_password_count;
 extern char		*cfg_password_file;
+extern bool		 cfg_prompt_prefetch;
+extern unsigned int	 cfg_session_cache;
+extern char		*cfg_storage_get_command;
+extern char		*cfg_storage_put_command;
+extern char		*cfg_syllable_set;
 extern unsigned int	 cfg_timeout;
+extern unsigned int	 cfg_word_count;
+extern char		*cfg_word_list;
+extern char		*cfg_word_separator;
 
 void			 config_ensure_directory(const char *);
 void			 config_check_file(const char *);
@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Chunked container, 'set backend chunked'.
+ *
+ * The password file is an index (a native file of type index, see native.c)
+ * listing in order the blocks holding its plain-text. Each block is a few KB
+ * of lines encrypted as its own native file, in a directory next to the
+ * password file (~/.mdp/passwords.d). It is named after the HMAC-SHA256 of
+ * its plain-text, with a key derived from the key file.
+ *
+ * A block is cut after a line once it is at least CONTAINER_BLOCK_MIN bytes
+ * long, if the CRC of that line ends with six zero bits (or wherever it
+ * reaches CONTAINER_BLOCK_MAX). The boundaries only depend on the lines
+ * around them: editing a line changes its block and maybe the next one, all
+ * the others keep their name. Saving only writes the blocks which don't exist
+ * yet and a new index. The backup is a link to the previous index, it shares
+ * the blocks left unchanged. Blocks no longer listed by the password file or
+ * its backup are removed after each save, see container_collect().
+ *
+ * The name of a block is also the salt of its key derivation. It is checked
+ * against the (authenticated) header when the block is read, a block can't
+ * be swapped for another one.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <err.h>
+
+#include "array.h"
+#include "backend.h"
+#include "container.h"
+#include "crc.h"
+#include "debug.h"
+#include "native.h"
+#include "sha256.h"
+#include "utils.h"
+#include "xmalloc.h"
+
+
+#define CONTAINER_INFO		"mdp container id v1"
+
+ARRAY_DECL(container_ids, char *);
+
+/*
+ * State of the encryption thread.
+ */
+struct container_writer {
+	struct native_stream *stream;
+	char		*dir;
+	uint8_t		 key[SHA256_DIGEST_LENGTH];
+	uint8_t		*index;
+	size_t		 index_length;
+	unsigned int	 blocks;
+	unsigned int	 written;
+};
+
+
+/*
+ * Directory of the blocks of the given index.
+ */
+char *
+container_dir(const char *path)
+{
+	char *dir;
+
+	xasprintf(&dir, "%s.d", path);
+
+	return (dir);
+}
+
+
+static void
+container_id_key(uint8_t *key)
+{
+	native_derive(key, SHA256_DIGEST_LENGTH, (const uint8_t *)"", 0,
+	    CONTAINER_INFO);
+}
+
+
+static void
+container_id_hex(const uint8_t *mac, char *id)
+{
+	for (int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+		snprintf(id + i * 2, 3, "%02x", mac[i]);
+}
+
+
+/*
+ * Block ids are the only file names read from an index, nothing else is
+ * accepted.
+ */
+static bool
+container_is_id(const char *id)
+{
+	if (strlen(id) != CONTAINER_ID_LENGTH)
+		return (false);
+
+	return (strspn(id, "0123456789abcdef") == CONTAINER_ID_LENGTH);
+}
+
+
+/*
+ * Read the block ids listed by the index read by the stream (past its
+ * header).
+ */
+static bool
+container_index_read(struct native_stream *stream, struct container_ids *ids)
+{
+	char id[CONTAINER_ID_LENGTH + 1];
+	size_t id_length = 0;
+	uint8_t *buf;
+	ssize_t len;
+	bool final = false;
+
+	buf = xmalloc(stream->chunk_length);
+
+	while (!final && stream->error == NULL) {
+		len = native_chunk_read(stream, buf, &final);
+
+		for (ssize_t i = 0; i < len; i++) {
+			if (buf[i] != '\n') {
+				if (id_length == CONTAINER_ID_LENGTH) {
+					stream->error = "invalid index";
+					break;
+				}
+				id[id_length++] = buf[i];
+				continue;
+			}
+
+			id[id_length] = '\0';
+			id_length = 0;
+			if (!container_is_id(id)) {
+				stream->error = "invalid index";
+				break;
+			}
+			ARRAY_ADD(ids, xstrdup(id));
+		}
+	}
+
+	if (stream->error == NULL && id_length != 0)
+		stream->error = "invalid index";
+
+	xfree(buf);
+
+	return (stream->error == NULL);
+}
+
+
+/*
+ * Decrypt a block and pass its plain-text to the pipe of the stream.
+ */
+static bool
+container_block_read(struct native_stream *stream, const char *dir,
+    const char *id)
+{
+	struct native_stream *block;
+	char salt[CONTAINER_ID_LENGTH + 1];
+	char *path;
+	uint8_t *buf = NULL;
+	ssize_t len = -1;
+	bool final = false;
+	int fd;
+
+	path = join_path(dir, id);
+	fd = open(path, O_RDONLY);
+	xfree(path);
+	if (fd == -1) {
+		stream->error = "missing block";
+		return (false);
+	}
+
+	/* A block is a single chunk. */
+	block = native_stream_new(fd, NULL);
+	if (native_header_read(block) &&
+	    block->header[10] == NATIVE_TYPE_DATA) {
+		buf = xmalloc(block->chunk_length);
+		len = native_chunk_read(block, buf, &final);
+	}
+
+	if (len == -1 || !final || len > CONTAINER_BLOCK_MAX) {
+		stream->error = block->error != NULL ? block->error :
+		    "invalid block";
+	} else {
+		container_id_hex(block->header + 16, salt);
+		if (strcmp(salt, id) != 0) {
+			stream->error = "block doesn't match its name";
+		} else if (!write_full(stream->pipe_fd, buf, len)) {
+			stream->error = "unable to write the plain-text";
+		}
+	}
+
+	if (buf != NULL) {
+		memset(buf, 0, block->chunk_length);
+		xfree(buf);
+	}
+	close(fd);
+	block->error = NULL;
+	native_stream_free(block);
+
+	return (stream->error == NULL);
+}
+
+
+/*
+ * Decryption thread of an index (see native_open()), from the blocks it lists
+ * to the pipe.
+ */
+void *
+container_decrypt_main(void *arg)
+{
+	struct native_stream *stream = arg;
+	struct container_ids ids;
+	char *dir;
+
+	ARRAY_INIT(&ids);
+	dir = container_dir(stream->path);
+
+	if (container_index_read(stream, &ids)) {
+		for (unsigned int i = 0; i < ARRAY_LENGTH(&ids); i++) {
+			if (!container_block_read(stream, dir,
+			    ARRAY_ITEM(&ids, i)))
+				break;
+		}
+	}
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&ids); i++)
+		xfree(ARRAY_ITEM(&ids, i));
+	if (ARRAY_DATA(&ids) != NULL)
+		xfree(ARRAY_DATA(&ids));
+	xfree(dir);
+
+	close(stream->pipe_fd);
+	close(stream->fd);
+
+	return (NULL);
+}
+
+
+/*
+ * Write a block unless it already exists and add it to the index.
+ */
+static bool
+container_block_write(struct container_writer *writer, uint8_t *buf,
+    size_t len)
+{
+	struct native_stream *stream = writer->stream, *block;
+	uint8_t mac[SHA256_DIGEST_LENGTH];
+	char id[CONTAINER_ID_LENGTH + 2];
+	char *path, *tmp_path;
+	struct stat sb;
+	bool success;
+	int fd;
+
+	hmac_sha256(mac, writer->key, sizeof(writer->key), buf, len);
+	container_id_hex(mac, id);
+	writer->blocks++;
+
+	path = join_path(writer->dir, id);
+	if (stat(path, &sb) != 0) {
+		xasprintf(&tmp_path, "%s.XXXXXXXX", path);
+		fd = mkstemp(tmp_path);
+
+		block = native_stream_new(fd, NULL);
+		success = fd != -1 && native_header_new(block,
+		    NATIVE_TYPE_DATA, mac) && native_chunk_write(block, buf, len,
+		    true) && fsync(fd) == 0;
+		if (fd != -1 && close(fd) != 0)
+			success = false;
+		if (success && rename(tmp_path, path) != 0)
+			success = false;
+		if (!success) {
+			unlink(tmp_path);
+			stream->error = "unable to write a block";
+		}
+
+		block->error = NULL;
+		native_stream_free(block);
+		xfree(tmp_path);
+		writer->written++;
+	}
+	xfree(path);
+
+	if (stream->error != NULL)
+		return (false);
+
+	/* The index is sealed a chunk at a time. */
+	id[CONTAINER_ID_LENGTH] = '\n';
+	id[CONTAINER_ID_LENGTH + 1] = '\0';
+	for (char *p = id; *p != '\0'; p++) {
+		if (writer->index_length == stream->chunk_length) {
+			if (!native_chunk_write(stream, writer->index,
+			    writer->index_length, false))
+				return (false);
+			writer->index_length = 0;
+		}
+		writer->index[writer->index_length++] = *p;
+	}
+
+	return (true);
+}
+
+
+/*
+ * Flush the directory so the new blocks are there before the index listing
+ * them replaces the previous one.
+ */
+static bool
+container_sync_dir(const char *dir)
+{
+	bool success;
+	int fd;
+
+	fd = open(dir, O_RDONLY);
+	if (fd == -1)
+		return (false);
+	success = fsync(fd) == 0 || errno == EINVAL;
+	close(fd);
+
+	return (success);
+}
+
+
+/*
+ * Encryption thread, cuts the plain-text from the pipe in blocks and writes
+ * the index.
+ */
+static void *
+container_encrypt_main(void *arg)
+{
+	struct container_writer writer;
+	struct native_stream *stream = arg;
+	struct crc_ctx crc;
+	uint8_t buf[4096];
+	uint8_t *block;
+	size_t len = 0, line = 0;
+	ssize_t r;
+	bool cut;
+
+	memset(&writer, 0, sizeof(writer));
+	writer.stream = stream;
+	writer.dir = container_dir(stream->path);
+	writer.index = xmalloc(stream->chunk_length);
+	container_id_key(writer.key);
+	block = xmalloc(CONTAINER_BLOCK_MAX);
+
+	while (stream->error == NULL &&
+	    (r = read(stream->pipe_fd, buf, sizeof(buf))) != 0) {
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r == -1) {
+			stream->error = "unable to read the plain-text";
+			break;
+		}
+
+		for (ssize_t i = 0; i < r; i++) {
+			block[len++] = buf[i];
+			cut = len == CONTAINER_BLOCK_MAX;
+
+			if (buf[i] == '\n') {
+				if (len >= CONTAINER_BLOCK_MIN) {
+					crc_init(&crc);
+					crc_update(&crc, block + line,
+					    len - line);
+					if ((crc_final(&crc) &
+					    CONTAINER_BOUNDARY_MASK) == 0)
+						cut = true;
+				}
+				line = len;
+			}
+
+			if (!cut)
+				continue;
+			if (!container_block_write(&writer, block, len))
+				break;
+			len = line = 0;
+		}
+	}
+
+	if (stream->error == NULL && len > 0)
+		container_block_write(&writer, block, len);
+
+	if (stream->error == NULL && !container_sync_dir(writer.dir))
+		stream->error = "unable to sync the blocks";
+
+	if (stream->error == NULL)
+		native_chunk_write(stream, writer.index, writer.index_length,
+		    true);
+
+	debug("container_encrypt %u blocks, %u written", writer.blocks,
+	    writer.written);
+
+	memset(buf, 0, sizeof(buf));
+	memset(block, 0, CONTAINER_BLOCK_MAX);
+	memset(&writer.key, 0, sizeof(writer.key));
+	xfree(block);
+	xfree(writer.index);
+	xfree(writer.dir);
+
+	close(stream->pipe_fd);
+
+	return (NULL);
+}
+
+
+/*
+ * Start encrypting to the given file descriptor as the index of the target,
+ * the blocks are written in its directory. The plain-text is written to the
+ * returned stream, native_encrypt_close() waits for everything to be written.
+ */
+static FILE *
+container_encrypt_open(int fd, const char *target, void **handle)
+{
+	struct native_stream *stream;
+	char *dir;
+
+	debug("container_encrypt_open %s", target);
+
+	dir = container_dir(target);
+	if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+		err(EXIT_FAILURE, "container_encrypt_open mkdir(%s)", dir);
+	xfree(dir);
+
+	stream = native_stream_new(fd, target);
+	if (!native_header_new(stream, NATIVE_TYPE_INDEX, NULL) ||
+	    !native_stream_start(stream, container_encrypt_main, true))
+		errx(EXIT_FAILURE, "chunked backend: %s", stream->error);
+
+	*handle = stream;
+
+	return (stream->fp);
+}
+
+
+/*
+ * Add the blocks listed by the given file to ids, if it is an index. Returns
+ * false if it couldn't be read.
+ */
+static bool
+container_collect_index(const char *path, struct container_ids *ids)
+{
+	struct native_stream *stream;
+	bool success = true;
+	int fd;
+
+	if (!native_is_file(path))
+		return (true);
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return (false);
+
+	stream = native_stream_new(fd, path);
+	if (!native_header_read(stream)) {
+		success = false;
+	} else if (stream->header[10] == NATIVE_TYPE_INDEX) {
+		success = container_index_read(stream, ids);
+	}
+	close(fd);
+
+	if (native_stream_free(stream) != 0)
+		success = false;
+
+	return (success);
+}
+
+
+static int
+container_id_cmp(const void *a, const void *b)
+{
+	return (strcmp(*(char * const *)a, *(char * const *)b));
+}
+
+
+/*
+ * Remove the blocks which are neither listed by the given index (the password
+ * file) nor by its backup. Nothing is removed if either can't be read.
+ */
+void
+container_collect(const char *target)
+{
+	struct container_ids ids;
+	struct dirent *entry;
+	unsigned int removed = 0;
+	char *dir, *backup, *path, *name;
+	DIR *dirp;
+
+	dir = container_dir(target);
+	dirp = opendir(dir);
+	if (dirp == NULL) {
+		if (errno != ENOENT)
+			warn("container_collect opendir(%s)", dir);
+		xfree(dir);
+		return;
+	}
+
+	ARRAY_INIT(&ids);
+	xasprintf(&backup, "%s.bak", target);
+
+	if (container_collect_index(target, &ids) &&
+	    container_collect_index(backup, &ids)) {
+		qsort(ARRAY_DATA(&ids), ARRAY_LENGTH(&ids), sizeof(char *),
+		    container_id_cmp);
+
+		while ((entry = readdir(dirp)) != NULL) {
+			name = entry->d_name;
+			if (!container_is_id(name) ||
+			    bsearch(&name, ARRAY_DATA(&ids),
+			    ARRAY_LENGTH(&ids), sizeof(char *),
+			    container_id_cmp) != NULL)
+				continue;
+
+			path = join_path(dir, name);
+			if (unlink(path) == 0)
+				removed++;
+			xfree(path);
+		}
+	}
+	closedir(dirp);
+
+	debug("container_collect %u blocks listed, %u removed",
+	    ARRAY_LENGTH(&ids), removed);
+
+	/* Nothing uses the container anymore. */
+	if (ARRAY_LENGTH(&ids) == 0)
+		rmdir(dir);
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&ids); i++)
+		xfree(ARRAY_ITEM(&ids, i));
+	if (ARRAY_DATA(&ids) != NULL)
+		xfree(ARRAY_DATA(&ids));
+	xfree(backup);
+	xfree(dir);
+}
+
+
+/*
+ * The chunked backend writes the password file as an index and blocks, both
+ * in the native format: they are read by the native backend.
+ */
+const struct backend_ops chunked_backend = {
+	"chunked backend",
+	native_check,
+	NULL,
+	native_decrypt_open,
+	native_decrypt_close,
+	NULL,
+	container_encrypt_open,
+	native_encrypt_close,
+	container_collect,
+};
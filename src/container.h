@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _CONTAINER_H_
+#define _CONTAINER_H_
+
+#include "native.h"
+
+/* Hex HMAC-SHA256 of the plain-text of a block, also its file name. */
+#define CONTAINER_ID_LENGTH	64
+
+/* Blocks are cut after a line once they reach the minimum, see below. */
+#define CONTAINER_BLOCK_MIN	8192
+#define CONTAINER_BLOCK_MAX	32768
+#define CONTAINER_BOUNDARY_MASK	63
+
+char		*container_dir(const char *);
+void		*container_decrypt_main(void *);
+void		 container_collect(const char *);
+
+#endif /* _CONTAINER_H_ */
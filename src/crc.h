@@ -1,7 +1,5 @@
-/*	$OpenBSD: crc.h,v 1.2 2014/03/20 22:03:56 tedu Exp $	*/
-
 /*
- * Copyright (c) 2004 Todd C. Miller <Todd.Miller@courtesan.com>
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
  *
  * Permission to use, copy, modify, and distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -16,16 +14,22 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#define	CKSUM_DIGEST_LENGTH		4
-#define	CKSUM_DIGEST_STRING_LENGTH	(10 + 1 + 19)
+#ifndef _CRC_H_
+#define _CRC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct crc_ctx {
+	uint32_t	crc;
+	uint64_t	len;
+};
 
-typedef struct CKSUMContext {
-	u_int32_t crc;
-	off_t len;
-} CKSUM_CTX;
+void		 crc_init(struct crc_ctx *);
+void		 crc_update(struct crc_ctx *, const void *, size_t);
+uint32_t	 crc_final(struct crc_ctx *);
+const char	*crc_kernel(void);
+bool		 crc_use_hardware(bool);
 
-void	 CKSUM_Init(CKSUM_CTX *);
-void	 CKSUM_Update(CKSUM_CTX *, const u_int8_t *, size_t);
-void	 CKSUM_Final(CKSUM_CTX *);
-char    *CKSUM_End(CKSUM_CTX *, char *);
-char    *CKSUM_Data(const u_int8_t *, size_t, char *);
+#endif /* _CRC_H_ */
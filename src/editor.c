@@ -14,6 +14,14 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+#ifndef HAS_NO_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+
+#include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -25,15 +33,31 @@
 #include "debug.h"
 #include "editor.h"
 #include "gpg.h"
+#include "journal.h"
+#include "lock.h"
+#include "mdp.h"
+#include "merge.h"
 #include "results.h"
+#include "sha256.h"
 #include "str.h"
 #include "utils.h"
 #include "xmalloc.h"
 
 
+/* Magic number of tmpfs in statfs(2)'s f_type. */
+#define TMPFS_MAGIC_NUMBER	0x01021994
+
+
 char *editor_tmp_path = NULL;
 
-extern uint32_t result_crc32;
+static char *editor_config_dir = NULL;
+
+/* Path given to the editor and the file descriptor behind it. */
+static char *edit_path = NULL;
+static int edit_fd = -1;
+
+/* Digest of the file as given to the editor. */
+static uint8_t edit_digest[SHA256_DIGEST_LENGTH];
 
 
 /*
@@ -48,7 +72,7 @@ editor_init(const char *config_dir)
 {
 	char *s;
 
-	editor_tmp_path = join_path(config_dir, "tmp_edit.XXXXXXXX");
+	editor_config_dir = xstrdup(config_dir);
 
 	s = getenv("EDITOR");
 	if (s == NULL) {
@@ -122,31 +146,252 @@ spawn_editor(char *path)
 
 
 /*
- * Check if the given path has the right sum and size.
- *
- * This is far from perfect, but for the purpose of detecting change, this is
- * just fine. Returns 1 if it matches.
+ * Compare the digest of the given file with the one of the content given to
+ * the editor. Returns 1 if it changed.
  */
 static int
 has_changed(char *path)
 {
+	static uint8_t buf[65536];
+	uint8_t digest[SHA256_DIGEST_LENGTH];
+	struct sha256_ctx ctx;
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		err(EXIT_FAILURE, "has_changed open(%s)", path);
+
+	sha256_init(&ctx);
+	while ((len = read(fd, buf, sizeof(buf))) > 0)
+		sha256_update(&ctx, buf, len);
+	if (len == -1)
+		err(EXIT_FAILURE, "has_changed read(%s)", path);
+	sha256_final(&ctx, digest);
+
+	close(fd);
+	memset(buf, 0, sizeof(buf));
+
+	if (memcmp(digest, edit_digest, sizeof(digest)) != 0)
+		return (1);
+
+	return (0);
+}
+
+
+/*
+ * Create the temporary file in the given directory, editor_tmp_path is set so
+ * it gets removed on exit.
+ */
+static int
+open_edit_file_in(const char *dir)
+{
+	int fd;
+
+	editor_tmp_path = join_path(dir, "tmp_edit.XXXXXXXX");
+
+	fd = mkstemp(editor_tmp_path);
+	if (fd == -1) {
+		debug("open_edit_file_in mkstemp(%s) failed", editor_tmp_path);
+		xfree(editor_tmp_path);
+		editor_tmp_path = NULL;
+		return (-1);
+	}
+
+	edit_path = editor_tmp_path;
+
+	return (fd);
+}
+
+
+/*
+ * Back the file with anonymous memory, the editor opens it through the file
+ * descriptor it inherits from us.
+ */
+static int
+open_edit_file_memfd(void)
+{
+#ifdef HAS_NO_MEMFD_CREATE
+	debug("open_edit_file_memfd not supported");
+	return (-1);
+#else
+	int fd;
+
+	fd = memfd_create("mdp_edit", 0);
+	if (fd == -1) {
+		debug("open_edit_file_memfd memfd_create() failed");
+		return (-1);
+	}
+
+	xasprintf(&edit_path, "/proc/self/fd/%d", fd);
+
+	return (fd);
+#endif
+}
+
+
+/*
+ * Use a private tmpfs, the user's runtime directory if it is one, else
+ * /dev/shm.
+ */
+static int
+open_edit_file_tmpfs(void)
+{
+#ifdef __linux__
+	const char *dirs[2] = { getenv("XDG_RUNTIME_DIR"), "/dev/shm" };
+	struct statfs sb;
+
+	for (unsigned int i = 0; i < 2; i++) {
+		if (dirs[i] == NULL || statfs(dirs[i], &sb) != 0)
+			continue;
+		if ((unsigned long)sb.f_type != TMPFS_MAGIC_NUMBER)
+			continue;
+		return (open_edit_file_in(dirs[i]));
+	}
+#endif
+
+	debug("open_edit_file_tmpfs no tmpfs found");
+	return (-1);
+}
+
+
+/*
+ * Create the file holding the plain-text during the edit, as configured by
+ * edit_storage. Each storage falls back on the next one (memfd, tmpfs, then
+ * the config directory) unless edit_fallback is off.
+ */
+static int
+open_edit_file(void)
+{
+	int fd = -1;
+
+	switch (cfg_edit_storage) {
+	case EDIT_STORAGE_MEMFD:
+		fd = open_edit_file_memfd();
+		if (fd != -1 || !cfg_edit_fallback)
+			break;
+		/* FALLTHROUGH */
+	case EDIT_STORAGE_TMPFS:
+		fd = open_edit_file_tmpfs();
+		if (fd != -1 || !cfg_edit_fallback)
+			break;
+		/* FALLTHROUGH */
+	case EDIT_STORAGE_DISK:
+		fd = open_edit_file_in(editor_config_dir);
+		break;
+	}
+
+	if (fd == -1) {
+		errx(EXIT_FAILURE, "unable to create the temporary file for "
+				"edition (check edit_storage)");
+	}
+
+	debug("open_edit_file: %s", edit_path);
+
+	return (fd);
+}
+
+
+/*
+ * Append the results from first to last (excluded) to the text.
+ */
+static void
+results_to_text(struct merge_text *text, unsigned int first, unsigned int last)
+{
+	static char line[MAX_LINE_SIZE];
+	size_t len;
+
+	for (unsigned int i = first; i < last; i++) {
+		len = wcstombs(line, ARRAY_ITEM(&results, i)->wcs_value,
+				sizeof(line) - 1);
+		if (len == (size_t)-1 || len >= sizeof(line) - 1) {
+			errx(EXIT_FAILURE, "edit_merge unable to convert "
+					"line %u", i + 1);
+		}
+		merge_text_add(text, line, len);
+	}
+
+	memset(line, 0, sizeof(line));
+}
+
+
+/*
+ * The password file was saved during the edit. Merge the changes from the
+ * password file as loaded to the edited file and to the current password
+ * file, in the edited file (see merge.c).
+ *
+ * On conflict, nothing is saved but the merge with the conflicts marked,
+ * encrypted next to the password file.
+ */
+static void
+edit_merge(void)
+{
+	struct merge_text base = ARRAY_INITIALIZER;
+	struct merge_text ours = ARRAY_INITIALIZER;
+	struct merge_text theirs = ARRAY_INITIALIZER;
+	unsigned int conflicts;
+	char *conflict_path;
 	FILE *fp;
-	uint32_t previous_crc32;
 
-	/*
-	 * Keep track of the previous sum/size so we can check if anything
-	 * changed.
-	 */
-	previous_crc32 = result_crc32;
+	debug("edit_merge");
 
-	fp = fopen(path, "r");
-	load_results_fp(fp);
+	results_to_text(&base, 0, results_generation()->lines);
+
+	if ((fp = fopen(edit_path, "r")) == NULL)
+		err(EXIT_FAILURE, "edit_merge fopen(%s)", edit_path);
+	merge_text_read(&ours, fp);
 	fclose(fp);
 
-	if (previous_crc32 != result_crc32)
-		return (1);
+	results_clear();
+	load_results_gpg();
+	results_to_text(&theirs, 0, ARRAY_LENGTH(&results));
+
+	if ((fp = fopen(edit_path, "w")) == NULL)
+		err(EXIT_FAILURE, "edit_merge fopen(%s)", edit_path);
+	conflicts = merge3(&base, &ours, &theirs, fp);
+	if (fclose(fp) != 0)
+		err(EXIT_FAILURE, "edit_merge fclose(%s)", edit_path);
+
+	merge_text_free(&base);
+	merge_text_free(&ours);
+	merge_text_free(&theirs);
+
+	if (conflicts > 0) {
+		xasprintf(&conflict_path, "%s.conflict", cfg_password_file);
+		gpg_encrypt(edit_path, conflict_path);
+		errx(EXIT_FAILURE, "the password file was saved during the "
+				"edit, %u conflict(s), nothing saved (your "
+				"changes are in %s)", conflicts, conflict_path);
+	}
 
-	return (0);
+	fprintf(stderr, "The password file was saved during the edit, the "
+			"changes were merged.\n");
+}
+
+
+/*
+ * Save the edited file to the target, or to a new journal segment if the
+ * target is NULL. The lock is only taken now, if someone saved the password
+ * file since it was loaded, the changes are merged first.
+ */
+static void
+edit_commit(const char *target)
+{
+	char *segment;
+
+	lock_set();
+
+	if (target == NULL) {
+		segment = journal_next_segment();
+		gpg_encrypt(edit_path, segment);
+		xfree(segment);
+		return;
+	}
+
+	if (results_store_changed())
+		edit_merge();
+
+	gpg_encrypt(edit_path, target);
 }
 
 
@@ -154,39 +399,65 @@ has_changed(char *path)
  * Edit the passwords.
  *
  * This function dumps all the plain-text passwords ("results") in a temporary
- * file in your ~/.mdp/ folder, fires your editor and save the output back to
- * your password file.
+ * file (see open_edit_file), fires your editor and save the output back to
+ * the target (your password file, or a new journal segment if NULL). No lock
+ * is held while the editor runs, see edit_commit().
+ *
+ * The file is only saved if the editor changed it, or if modified is set
+ * because the results no longer match the target (e.g. new passwords from
+ * 'mdp add').
  */
 void
-edit_results(void)
+edit_results(const char *target, bool modified)
 {
-	int tmp_fd = -1;
+	size_t len;
 	struct result *result;
+	struct sha256_ctx ctx;
+	static char line[MAX_LINE_SIZE];
 
-	/* Create the temporary file for edit mode. */
-	tmp_fd = mkstemp(editor_tmp_path);
-	if (tmp_fd == -1) {
-		err(EXIT_FAILURE, "edit_results mkstemp()");
-	}
+	edit_fd = open_edit_file();
+	sha256_init(&ctx);
 
 	/* Iterate over the results and dump them in this file. */
 	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
 		result = ARRAY_ITEM(&results, i);
-		if (write(tmp_fd, result->mbs_value, result->mbs_len) == -1)
+		len = wcstombs(line, result->wcs_value, sizeof(line) - 1);
+		if (len == (size_t)-1 || len >= sizeof(line) - 1) {
+			errx(EXIT_FAILURE, "edit_results unable to convert "
+					"line %u", i + 1);
+		}
+		line[len++] = '\n';
+		if (!write_full(edit_fd, line, len))
 			err(EXIT_FAILURE, "edit_results write");
-		if (write(tmp_fd, "\n", 1) == -1)
-			err(EXIT_FAILURE, "edit_results write (new-line)");
+		sha256_update(&ctx, line, len);
 	}
 
-	if (close(tmp_fd) != 0) {
-		err(EXIT_FAILURE, "edit_results close(tmp_fd)");
+	memset(line, 0, sizeof(line));
+	sha256_final(&ctx, edit_digest);
+
+	/* A memfd only lives as long as we keep it open. */
+	if (editor_tmp_path != NULL) {
+		if (close(edit_fd) != 0)
+			err(EXIT_FAILURE, "edit_results close(edit_fd)");
+		edit_fd = -1;
 	}
 
-	spawn_editor(editor_tmp_path);
+	spawn_editor(edit_path);
+
+	/* Only the editor needs the memfd, not the processes we start next. */
+	if (edit_fd != -1 && fcntl(edit_fd, F_SETFD, FD_CLOEXEC) == -1)
+		err(EXIT_FAILURE, "edit_results fcntl(edit_fd)");
 
-	if (has_changed(editor_tmp_path)) {
-		gpg_encrypt(editor_tmp_path);
+	if (modified || has_changed(edit_path)) {
+		edit_commit(target);
 	} else {
 		fprintf(stderr, "No changes, exiting...\n");
 	}
+
+	if (edit_fd != -1) {
+		if (ftruncate(edit_fd, 0) != 0)
+			err(EXIT_FAILURE, "edit_results ftruncate(edit_fd)");
+		close(edit_fd);
+		edit_fd = -1;
+	}
 }
@@ -19,7 +19,7 @@
 
 extern char	*editor_tmp_path;
 
-void		 edit_results(void);
+void		 edit_results(const char *, bool);
 void		 editor_init(const char *);
 bool		 editor_is_vim(const char *);
 
@@ -14,35 +14,94 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  *
  *
- * This file contains all the tools to read and write gpg files.
+ * This file contains all the tools to read and write the files of the store
+ * and the gpg backend. The files are decrypted and encrypted by the backend
+ * of their format or of the configuration (see backend.c), gpg unless
+ * configured otherwise.
  */
 
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <stdarg.h>
 #include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <signal.h>
 #include <errno.h>
 #include <err.h>
 
+#include "agent.h"
+#include "backend.h"
 #include "config.h"
 #include "debug.h"
 #include "gpg.h"
+#include "journal.h"
+#include "lock.h"
+#include "storage.h"
 #include "str.h"
 #include "utils.h"
 #include "xmalloc.h"
 
 
-static pid_t gpg_pid;
+/*
+ * Session key cache state of a gpg process (see agent.c): the identity of
+ * the cipher-text and the pipe where gpg reports the session key, -1 when
+ * the key was already known or the cache is disabled. The pipe is drained
+ * into log while gpg runs so it never blocks on it, what doesn't fit is
+ * dropped.
+ */
+struct gpg_session {
+	int		 status_fd;
+	char		 id[AGENT_ID_LENGTH + 1];
+	char		 log[16384];
+	size_t		 len;
+};
+
+/*
+ * A gpg process decrypting or encrypting a file, the handle of the gpg
+ * backend.
+ */
+struct gpg_process {
+	pid_t		 pid;
+	long long	 deadline;
+	bool		 interrupted;
+	sigset_t	 sigmask;
+	struct gpg_session session;
+};
+
+char *gpg_tmp_path = NULL;
+
+static const struct backend_ops *encrypt_backend = NULL;
+static void *encrypt_handle = NULL;
+static int encrypt_fd = -1;
+static char *encrypt_target = NULL;
 
 
 /*
- * Ensures gpg exists, runs and is configured. Also makes sure we have a
- * recipient key configured or passed via the command-line argument.
+ * Ensures the backend writing the password file can be used. The agent is
+ * started from here, before the loader and native threads.
  */
 void
 gpg_check(void)
+{
+	agent_begin();
+	backend_get(cfg_password_file)->check();
+}
+
+
+/*
+ * Ensures gpg exists, runs and is configured. Also makes sure we have a
+ * recipient key configured or passed via the command-line argument.
+ */
+static void
+gpg_backend_check(void)
 {
 	char *cmd;
 
@@ -67,165 +126,787 @@ gpg_check(void)
 
 
 /*
- * Opens the gpg process and stream from its output.
+ * Start gpg decrypting the given file to a pipe, the read side is stored in
+ * fd. Returns the pid of gpg, -1 (with errno set) if it couldn't be started.
  *
- * Returns NULL if the password file was not found.
+ * With the session cache, a known session key is given to gpg through a
+ * pipe. Otherwise gpg is asked to report it on the status pipe of the
+ * session, along with its log so the key doesn't reach the terminal, see
+ * gpg_session_finish().
  */
-FILE *
-gpg_open()
+static pid_t
+gpg_spawn_decrypt(const char *path, int *fd, struct gpg_session *session)
 {
-	int pout[2];	// {read, write}
-	FILE *fp;
-
-	if (!file_exists(cfg_password_file)) {
-		debug("gpg_open password file does not exist (yet)");
-		return (NULL);
+	char key[AGENT_KEY_MAX + 1];
+	char fdarg[16];
+	int pout[2] = { -1, -1 };	// {read, write}
+	int pkey[2] = { -1, -1 };
+	int pstatus[2] = { -1, -1 };
+	int saved_errno;
+	size_t len;
+	pid_t pid = -1;
+
+	session->status_fd = -1;
+	session->id[0] = '\0';
+
+	if (cfg_session_cache > 0 && agent_file_id(path, session->id)) {
+		if (agent_get(session->id, key)) {
+			len = strlen(key);
+			key[len++] = '\n';
+			if (pipe(pkey) != 0 ||
+					write(pkey[1], key, len) != (ssize_t)len)
+				goto out;
+			close(pkey[1]);
+			pkey[1] = -1;
+			snprintf(fdarg, sizeof(fdarg), "%d", pkey[0]);
+		} else {
+			if (pipe(pstatus) != 0)
+				goto out;
+			snprintf(fdarg, sizeof(fdarg), "%d", pstatus[1]);
+		}
 	}
 
-	debug("gpg_open %s %s", cfg_gpg_path, cfg_password_file);
+	debug("gpg_spawn_decrypt %s %s%s", cfg_gpg_path, path, pkey[0] != -1 ?
+			" (cached session key)" : "");
 
 	if (pipe(pout) != 0)
-		err(EXIT_FAILURE, "gpg_decode pipe(pout)");
+		goto out;
 
-	gpg_pid = fork();
+	pid = fork();
 
-	switch (gpg_pid) {
+	switch (pid) {
 	case -1:
-		err(EXIT_FAILURE, "gpg_decode fork");
-		break;
+		goto out;
 	case 0:
 		/* Child process pipe dance. */
-		if (close(pout[0]))
-			err(EXIT_FAILURE, "child close(pout[0])");
-
+		close(pout[0]);
 		if (dup2(pout[1], STDOUT_FILENO) == -1)
-			err(EXIT_FAILURE, "dup2 (child stdout)");
-
+			_exit(127);
 		if (pout[1] != STDOUT_FILENO)
-			if (close(pout[1]))
-				err(EXIT_FAILURE, "child close(pipe_out[1])");
-
-		debug("gpg_open child pid: %d", getpid());
+			close(pout[1]);
+
+		if (pkey[0] != -1) {
+			execlp(cfg_gpg_path, cfg_gpg_path, "-q",
+					"--override-session-key-fd", fdarg,
+					"--decrypt", path, NULL);
+		} else if (pstatus[1] != -1) {
+			close(pstatus[0]);
+			execlp(cfg_gpg_path, cfg_gpg_path, "-q",
+					"--status-fd", fdarg, "--logger-fd", fdarg,
+					"--show-session-key", "--decrypt", path,
+					NULL);
+		} else {
+			execlp(cfg_gpg_path, cfg_gpg_path, "-q", "--decrypt",
+					path, NULL);
+		}
+		warn("couldn't execute %s", cfg_gpg_path);
 
-		execlp(cfg_gpg_path, "-q", "--decrypt", cfg_password_file,
-				NULL);
-		err(EXIT_FAILURE, "couldn't execute");
+		/* Avoid atexit() to run on the child. */
+		_exit(127);
 		/* NOTREACHED */
 	default:
 		/* Parent process. NOP'ing. */
 		break;
 	}
 
-	/* We are the parent. Close the child side of the pipe. */
-	if (close(pout[1]) != 0) {
-		err(EXIT_FAILURE, "close(pout[1])");
+	*fd = pout[0];
+	pout[0] = -1;
+	if (pstatus[0] != -1) {
+		session->status_fd = pstatus[0];
+		pstatus[0] = -1;
 	}
 
-	fp = fdopen(pout[0], "r");
+out:
+	/* Close the child side of the pipes, everything on error. */
+	saved_errno = errno;
+	memset(key, 0, sizeof(key));
+	for (int i = 0; i < 2; i++) {
+		if (pout[i] != -1)
+			close(pout[i]);
+		if (pkey[i] != -1)
+			close(pkey[i]);
+		if (pstatus[i] != -1)
+			close(pstatus[i]);
+	}
+	errno = saved_errno;
+
+	return (pid);
+}
 
-	/*
-	 * Since we spawned a new process, we keep track of it and shut it down
-	 * by force if it takes too long.
-	 */
-	set_pid_timeout(gpg_pid, cfg_gpg_timeout);
 
-	return (fp);
+/*
+ * Append what is waiting on the status pipe of a session to its log, the
+ * pipe is closed once gpg closed its side. Returns what read() returned.
+ */
+static ssize_t
+gpg_session_read(struct gpg_session *session)
+{
+	char discard[512];
+	ssize_t r;
+
+	if (session->len < sizeof(session->log) - 1) {
+		r = read(session->status_fd, session->log + session->len,
+				sizeof(session->log) - 1 - session->len);
+		if (r > 0)
+			session->len += r;
+	} else {
+		r = read(session->status_fd, discard, sizeof(discard));
+		memset(discard, 0, sizeof(discard));
+	}
+
+	if (r == 0 || (r == -1 && errno != EINTR && errno != EAGAIN)) {
+		close(session->status_fd);
+		session->status_fd = -1;
+	}
+
+	return (r);
 }
 
 
 /*
- * Close the gpg output stream and the process.
+ * The session of the gpg process of a file, NULL for the other backends.
+ */
+static struct gpg_session *
+gpg_plain_session(struct gpg_plain *file)
+{
+	struct gpg_process *gpg = file->handle;
+
+	if (file->backend != &gpg_backend || gpg == NULL)
+		return (NULL);
+
+	return (&gpg->session);
+}
+
+
+/*
+ * Read what is left on the status pipe once gpg is done, without waiting for
+ * whatever might still hold it. The session key is handed to the agent if
+ * gpg was successful, the rest of its log is passed through to stderr or
+ * kept as the error of the file if it failed.
+ */
+static void
+gpg_session_finish(struct gpg_plain *file, struct gpg_session *session)
+{
+	bool success = file->retcode == 0;
+	static const char status_key[] = "[GNUPG:] SESSION_KEY ";
+	char *line, *next;
+
+	if (session->status_fd != -1) {
+		fcntl(session->status_fd, F_SETFL, O_NONBLOCK);
+		while (gpg_session_read(session) > 0)
+			;
+		if (session->status_fd != -1)
+			close(session->status_fd);
+		session->status_fd = -1;
+	}
+	session->log[session->len] = '\0';
+
+	for (line = session->log; *line != '\0'; line = next) {
+		next = line + strcspn(line, "\n");
+		if (*next == '\n')
+			*next++ = '\0';
+
+		if (strncmp(line, status_key, sizeof(status_key) - 1) == 0) {
+			if (success)
+				agent_put(session->id,
+						line + sizeof(status_key) - 1);
+			continue;
+		}
+
+		/* Other status lines and the log of the session key. */
+		if (strncmp(line, "[GNUPG:] ", 9) == 0 ||
+				strstr(line, "session key") != NULL ||
+				strstr(line, "seskey") != NULL)
+			continue;
+
+		/* The log explains the failure, reported by the caller. */
+		if (success) {
+			fprintf(stderr, "%s\n", line);
+		} else if (*line != '\0') {
+			gpg_plain_fail(file, "%s", line);
+		}
+	}
+
+	memset(session->log, 0, sizeof(session->log));
+	session->len = 0;
+}
+
+
+/*
+ * Append what is waiting on the pipe of the given file to its buffer.
+ * Returns false once gpg closed its side.
  *
- * Returns the exit code from GnuPG.
+ * The buffer holds plain-text, it is never realloc'd to avoid leaving copies
+ * of it around: a bigger one is allocated and the previous one wiped.
  */
-int
-gpg_close(FILE *fp)
+static bool
+gpg_plain_read(struct gpg_plain *file)
 {
-	int x, status;
-	int retcode;
+	char *data;
+	ssize_t len;
+
+	if (file->size - file->len < GPG_PLAIN_CHUNK) {
+		data = xmalloc(file->size * 2 + GPG_PLAIN_CHUNK);
+		if (file->data != NULL) {
+			memcpy(data, file->data, file->len);
+			memset(file->data, 0, file->size);
+			xfree(file->data);
+		}
+		file->data = data;
+		file->size = file->size * 2 + GPG_PLAIN_CHUNK;
+	}
+
+	len = read(file->fd, file->data + file->len, file->size - file->len);
+	if (len == -1) {
+		if (errno == EINTR || errno == EAGAIN)
+			return (true);
+		gpg_plain_fail(file, "%s: %s", file->path, strerror(errno));
+		return (false);
+	}
 
-	debug("gpg_close");
+	file->len += len;
 
-	if (fclose(fp) != 0) {
-		err(EXIT_FAILURE, "gpg_close fclose()");
+	return (len > 0);
+}
+
+
+/*
+ * Start gpg decrypting a file for gpg_decrypt_all().
+ */
+static bool
+gpg_backend_decrypt_open(struct gpg_plain *file)
+{
+	struct gpg_process *gpg;
+
+	gpg = xcalloc(1, sizeof(struct gpg_process));
+	gpg->pid = gpg_spawn_decrypt(file->path, &file->fd, &gpg->session);
+	if (gpg->pid == -1) {
+		gpg_plain_fail(file, "unable to start gpg: %s",
+				strerror(errno));
+		xfree(gpg);
+		return (false);
 	}
+	file->handle = gpg;
 
-	x = waitpid(gpg_pid, &status, 0);
+	return (true);
+}
 
-	if (WIFSIGNALED(status)) {
-		errx(EXIT_FAILURE, "gpg_close gpg interrupted");
+
+/*
+ * Wait for the gpg process of a file that reached EOF.
+ */
+static void
+gpg_backend_decrypt_close(struct gpg_plain *file)
+{
+	struct gpg_process *gpg = file->handle;
+	int status;
+
+	close(file->fd);
+
+	/* gpg closed its output but might still be stuck after that. */
+	if (wait_child(gpg->pid, &status, file->deadline) &&
+			!file->timed_out) {
+		gpg_plain_fail(file, "gpg timed out after %d seconds",
+				cfg_gpg_timeout);
+		file->timed_out = true;
 	}
 
-	if (x == -1) {
-		err(EXIT_FAILURE, "gpg_close wait()");
+	if (WIFEXITED(status) && file->retcode == 0) {
+		file->retcode = WEXITSTATUS(status);
+	} else {
+		file->retcode = -1;
 	}
 
-	retcode = WEXITSTATUS(status);
-	debug("gpg_close return code: %d", retcode);
+	gpg_session_finish(file, &gpg->session);
+
+	xfree(gpg);
+	file->handle = NULL;
+}
 
-	cancel_pid_timeout();
 
-	return (retcode);
+/*
+ * Interrupt a gpg process past its deadline, kill it if it is still running
+ * after the grace period.
+ */
+static void
+gpg_backend_decrypt_expire(struct gpg_plain *file)
+{
+	struct gpg_process *gpg = file->handle;
+
+	debug("gpg_backend_decrypt_expire %s (pid: %d): %s", file->path,
+			gpg->pid, gpg->interrupted ? "SIGKILL" : "SIGINT");
+	kill(gpg->pid, gpg->interrupted ? SIGKILL : SIGINT);
+	gpg->interrupted = true;
 }
 
 
 /*
- * Saves the file back though GnuPG by saving to a temp file.
+ * Record why the decryption of a file failed, only the first reason is kept.
  */
 void
-gpg_encrypt(const char *tmp_path)
+gpg_plain_fail(struct gpg_plain *file, const char *fmt, ...)
 {
-	char *cmd, *backup_path, *tmp_encrypted_path;
+	va_list ap;
 
-	xasprintf(&cmd, "%s -r %s -e %s", cfg_gpg_path, cfg_gpg_key_id,
-			tmp_path);
+	file->retcode = -1;
+	if (file->error != NULL)
+		return;
 
-	debug("gpg_encrypt system(%s)", cmd);
-	if (system(cmd) != 0) {
-		errx(EXIT_FAILURE, "gpg_encrypt system(%s) != 0", cmd);
-	}
+	va_start(ap, fmt);
+	if (vasprintf(&file->error, fmt, ap) == -1)
+		file->error = NULL;
+	va_end(ap);
+}
+
+
+/*
+ * Wait for the backend of a file that reached EOF (or failed).
+ */
+static void
+gpg_plain_reap(struct gpg_plain *file)
+{
+	int retcode = file->retcode;
 
-	/* Generate the backup filename. */
-	xasprintf(&backup_path, "%s.bak", cfg_password_file);
+	file->backend->decrypt_close(file);
+	file->fd = -1;
 
-	if (file_exists(cfg_password_file)) {
-		/* Backup the previous password file. */
-		if (cfg_backup) {
-			debug("gpg_encrypt backup: %s", backup_path);
+	/* A failure seen while reading is not undone by the backend. */
+	if (retcode != 0)
+		file->retcode = retcode;
 
-			/* Delete the previous backup. */
-			if (unlink(backup_path) != 0) {
-				if (errno != ENOENT) {
-					err(EXIT_FAILURE, "gpg_encrypt backup "
-							"unlink");
-				}
+	debug("gpg_decrypt_all %s (%s): %zu bytes, return code: %d",
+			file->path, file->backend->name, file->len,
+			file->retcode);
+}
+
+
+/*
+ * Decrypt all the given files at once, with at most 'jobs' of them being
+ * decrypted at the same time, each by the backend of its format. The outputs
+ * are read with poll() as they come and kept in memory in the order of the
+ * files, whichever finishes first. The status pipes of the gpg processes
+ * (see gpg_session_read()) are polled along so gpg never blocks on them.
+ *
+ * Each gpg process is given gpg_timeout seconds, it is interrupted after
+ * that and killed if it is still there KILL_GRACE_MS later. Returns false
+ * if any of them did not return successfully, with the reason in its error
+ * when known. Nothing is printed and the process is not exited, this runs
+ * in the background while the prompt is shown. The caller is expected
+ * to wipe the buffers (see gpg_plain_free()) either way.
+ * The native backend takes a slot as well, with a thread instead of a
+ * process and no deadline: only the backends that can expire count for the
+ * timeout of poll().
+ */
+bool
+gpg_decrypt_all(struct gpg_plain *files, unsigned int count, unsigned int jobs)
+{
+	struct pollfd *pfds;
+	struct gpg_plain **running;
+	struct gpg_session *session;
+	unsigned int next = 0, active = 0, polled;
+	long long now, deadline;
+	int timeout;
+	bool success = true;
+
+	if (jobs == 0)
+		jobs = 1;
+
+	/* The outputs, then the status pipes in the same order. */
+	pfds = xcalloc(jobs * 2, sizeof(struct pollfd));
+	running = xcalloc(jobs, sizeof(struct gpg_plain *));
+
+	/* No new gpg is started once one of them failed. */
+	while ((success && next < count) || active > 0) {
+		/* Fill the free slots. */
+		while (success && next < count && active < jobs) {
+			files[next].backend = backend_for_file(
+					files[next].path);
+			if (!files[next].backend->decrypt_open(&files[next])) {
+				files[next++].fd = -1;
+				success = false;
+				break;
 			}
+			files[next].deadline = now_ms() +
+				(long long)cfg_gpg_timeout * 1000;
+			running[active++] = &files[next++];
+		}
+
+		if (active == 0)
+			continue;
+
+		now = now_ms();
+		deadline = -1;
+		polled = active;
+		for (unsigned int i = 0; i < active; i++) {
+			pfds[i].fd = running[i]->fd;
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+			session = gpg_plain_session(running[i]);
+			pfds[active + i].fd = session != NULL ?
+			    session->status_fd : -1;
+			pfds[active + i].events = POLLIN;
+			pfds[active + i].revents = 0;
+			if (running[i]->backend->decrypt_expire == NULL)
+				continue;
+			if (deadline == -1 || running[i]->deadline < deadline)
+				deadline = running[i]->deadline;
+		}
+		if (deadline == -1) {
+			timeout = -1;
+		} else {
+			timeout = deadline > now ? (int)(deadline - now) : 0;
+		}
 
-			/* Create a physical link. */
-			if (link(cfg_password_file, backup_path) != 0) {
-				err(EXIT_FAILURE, "gpg_encrypt backup link");
+		if (poll(pfds, active * 2, timeout) == -1) {
+			if (errno == EINTR)
+				continue;
+
+			/* Give up on everything still running. */
+			for (unsigned int i = 0; i < active; i++) {
+				gpg_plain_fail(running[i], "poll(): %s",
+						strerror(errno));
+				gpg_plain_reap(running[i]);
 			}
+			success = false;
+			active = 0;
+			break;
+		}
+
+		for (unsigned int i = 0; i < polled; i++) {
+			if (pfds[polled + i].revents != 0)
+				gpg_session_read(gpg_plain_session(running[i]));
 		}
 
-		/* Unlink the previous location, keeping only the backup. */
-		if (unlink(cfg_password_file) != 0) {
-			err(EXIT_FAILURE, "gpg_encrypt unlink(cfg_password_file)");
+		now = now_ms();
+		for (unsigned int i = 0; i < active; i++) {
+			/*
+			 * Interrupted first, killed and given up on (whatever
+			 * still holds its pipe) after the grace period.
+			 */
+			if (running[i]->deadline <= now &&
+					running[i]->backend->decrypt_expire !=
+					NULL) {
+				if (!running[i]->timed_out)
+					gpg_plain_fail(running[i], "gpg timed "
+							"out after %d seconds",
+							cfg_gpg_timeout);
+				running[i]->backend->decrypt_expire(running[i]);
+				running[i]->deadline = now + KILL_GRACE_MS;
+				if (!running[i]->timed_out) {
+					running[i]->timed_out = true;
+					continue;
+				}
+			} else if (pfds[i].revents == 0 ||
+					gpg_plain_read(running[i])) {
+				continue;
+			}
+
+			gpg_plain_reap(running[i]);
+			if (running[i]->retcode != 0)
+				success = false;
+
+			/* Keep pfds in line with running for this round. */
+			active--;
+			running[i] = running[active];
+			pfds[i] = pfds[active];
+			i--;
 		}
 	}
 
+	xfree(pfds);
+	xfree(running);
+
+	return (success);
+}
+
+
+/*
+ * Wipe and release the plain-text read by gpg_decrypt_all().
+ */
+void
+gpg_plain_free(struct gpg_plain *file)
+{
+	if (file->data != NULL) {
+		memset(file->data, 0, file->size);
+		xfree(file->data);
+	}
+
+	file->data = NULL;
+	file->len = file->size = 0;
+
+	if (file->error != NULL) {
+		xfree(file->error);
+		file->error = NULL;
+	}
+}
+
+
+/*
+ * Start a gpg process encrypting its stdin to the given descriptor, returns
+ * the stream feeding gpg.
+ */
+static FILE *
+gpg_backend_encrypt_open(int fd, const char *target, void **handle)
+{
+	struct gpg_process *gpg;
+	int pin[2];	// {read, write}
+	FILE *fp;
+
+	if (pipe(pin) != 0)
+		err(EXIT_FAILURE, "gpg_encrypt_open pipe(pin)");
+
+	debug("gpg_encrypt_open %s -r %s -e > %s", cfg_gpg_path,
+			cfg_gpg_key_id, target);
+
+	gpg = xcalloc(1, sizeof(struct gpg_process));
+	gpg->deadline = now_ms() + (long long)cfg_gpg_timeout * 1000;
+	gpg->pid = fork();
+
+	switch (gpg->pid) {
+	case -1:
+		err(EXIT_FAILURE, "gpg_encrypt_open fork");
+		break;
+	case 0:
+		/* Child process pipe dance. */
+		if (close(pin[1]))
+			err(EXIT_FAILURE, "child close(pin[1])");
+
+		if (dup2(pin[0], STDIN_FILENO) == -1)
+			err(EXIT_FAILURE, "dup2 (child stdin)");
+
+		if (dup2(fd, STDOUT_FILENO) == -1)
+			err(EXIT_FAILURE, "dup2 (child stdout)");
+
+		if (pin[0] != STDIN_FILENO)
+			close(pin[0]);
+		if (fd != STDOUT_FILENO)
+			close(fd);
+
+		execlp(cfg_gpg_path, cfg_gpg_path, "-q", "-r", cfg_gpg_key_id,
+				"-e", NULL);
+		err(EXIT_FAILURE, "couldn't execute");
+		/* NOTREACHED */
+	default:
+		/* Parent process. NOP'ing. */
+		break;
+	}
+
+	/* We are the parent. Close the child side of the pipe. */
+	if (close(pin[0]) != 0)
+		err(EXIT_FAILURE, "close(pin[0])");
+
+	/* gpg dying early is reported by gpg_encrypt_close(). */
+	sigpipe_block(&gpg->sigmask);
+
+	fp = fdopen(pin[1], "w");
+	if (fp == NULL)
+		err(EXIT_FAILURE, "gpg_encrypt_open fdopen");
+
+	*handle = gpg;
+
+	return (fp);
+}
+
+
+/*
+ * Close the stream feeding gpg and wait for it to be done.
+ */
+static bool
+gpg_backend_encrypt_close(FILE *fp, void *handle)
+{
+	struct gpg_process *gpg = handle;
+	int status, write_error;
+
+	write_error = fclose(fp);
+	sigpipe_restore(&gpg->sigmask);
+
+	if (wait_child(gpg->pid, &status, gpg->deadline))
+		fprintf(stderr, "gpg timed out after %d seconds, aborting\n",
+				cfg_gpg_timeout);
+
+	xfree(gpg);
+
+	return (write_error == 0 && WIFEXITED(status) &&
+			WEXITSTATUS(status) == 0);
+}
+
+
+const struct backend_ops gpg_backend = {
+	"gpg",
+	gpg_backend_check,
+	NULL,
+	gpg_backend_decrypt_open,
+	gpg_backend_decrypt_close,
+	gpg_backend_decrypt_expire,
+	gpg_backend_encrypt_open,
+	gpg_backend_encrypt_close,
+	NULL,
+};
+
+
+/*
+ * Start encrypting to a temporary file next to the target (the password file
+ * or a journal segment) with the configured backend. Returns the stream of
+ * the plain-text, the caller writes it and commits the new file with
+ * gpg_encrypt_close().
+ */
+FILE *
+gpg_encrypt_open(const char *target)
+{
+	encrypt_target = xstrdup(target);
+	xasprintf(&gpg_tmp_path, "%s.XXXXXXXX", target);
+
+	encrypt_fd = mkstemp(gpg_tmp_path);
+	if (encrypt_fd == -1)
+		err(EXIT_FAILURE, "gpg_encrypt_open mkstemp(%s)", gpg_tmp_path);
+
+	encrypt_backend = backend_get(target);
+
+	return (encrypt_backend->encrypt_open(encrypt_fd, target,
+				&encrypt_handle));
+}
+
+
+/*
+ * Flush the directory holding the password file so a rename survives a
+ * crash.
+ */
+static void
+sync_password_dir(void)
+{
+	char *path, *dir;
+	int fd;
+
+	path = xstrdup(encrypt_target);
+	dir = dirname(path);
+
+	fd = open(dir, O_RDONLY);
+	if (fd == -1)
+		err(EXIT_FAILURE, "gpg_encrypt open(%s)", dir);
+	if (fsync(fd) != 0 && errno != EINVAL)
+		err(EXIT_FAILURE, "gpg_encrypt fsync(%s)", dir);
+	close(fd);
+
+	xfree(path);
+}
+
+
+/*
+ * Wait for the backend to be done with the plain-text and replace the target
+ * with the new cipher-text in a single rename().
+ *
+ * When the target is the password file, a hard link to the previous one is
+ * kept as backup if configured and the journal segments, now part of the
+ * password file, are removed along with what the backends no longer use
+ * (e.g. the blocks of the chunked backend). The segments are recorded as
+ * folded before the rename (see journal_fold_begin()), readers don't read
+ * them twice if the removal is interrupted.
+ */
+void
+gpg_encrypt_close(FILE *fp)
+{
+	char *backup_path;
+	bool is_password_file, failed;
+	unsigned int folded = 0;
+
+	debug("gpg_encrypt_close %s", encrypt_target);
+
+	is_password_file = strcmp(encrypt_target, cfg_password_file) == 0;
+
+	failed = !encrypt_backend->encrypt_close(fp, encrypt_handle);
+	encrypt_handle = NULL;
+
+	if (failed) {
+		close(encrypt_fd);
+		unlink(gpg_tmp_path);
+		errx(EXIT_FAILURE, "gpg_encrypt %s returned with an error",
+				encrypt_backend->name);
+	}
+
+	if (fsync(encrypt_fd) != 0)
+		err(EXIT_FAILURE, "gpg_encrypt fsync(%s)", gpg_tmp_path);
+	if (close(encrypt_fd) != 0)
+		err(EXIT_FAILURE, "gpg_encrypt close(%s)", gpg_tmp_path);
+	encrypt_fd = -1;
+
+	/* Readers wait for the new file and its journal to be in place. */
+	lock_store_exclusive();
+
+	if (is_password_file) {
+		folded = journal_fold_begin(gpg_tmp_path);
+		if (folded > 0)
+			sync_password_dir();
+	}
+
+	/* Backup the previous password file. */
+	if (is_password_file && cfg_backup && file_exists(cfg_password_file)) {
+		xasprintf(&backup_path, "%s.bak", cfg_password_file);
+		debug("gpg_encrypt backup: %s", backup_path);
+
+		/* Delete the previous backup. */
+		if (unlink(backup_path) != 0 && errno != ENOENT)
+			err(EXIT_FAILURE, "gpg_encrypt backup unlink");
+
+		/* Create a physical link. */
+		if (link(cfg_password_file, backup_path) != 0)
+			err(EXIT_FAILURE, "gpg_encrypt backup link");
+
+		xfree(backup_path);
+	}
+
 	/* Move the newly encrypted file to its new location. */
-	xasprintf(&tmp_encrypted_path, "%s.gpg", tmp_path);
-	if (link(tmp_encrypted_path, cfg_password_file) != 0) {
-		err(EXIT_FAILURE, "gpg_encrypt link(tmp_encrypted_path=%s, "
-				"cfg_password_file=%s)", tmp_encrypted_path,
-				cfg_password_file);
-	} else {
-		if (chmod(cfg_password_file, S_IRUSR | S_IWUSR) !=0) {
-			err(EXIT_FAILURE, "gpg_encrypt chmod");
-		}
+	if (rename(gpg_tmp_path, encrypt_target) != 0) {
+		err(EXIT_FAILURE, "gpg_encrypt rename(%s, %s)", gpg_tmp_path,
+				encrypt_target);
 	}
 
-	if (unlink(tmp_encrypted_path) != 0) {
-		err(EXIT_FAILURE, "gpg_encrypt unlink(tmp_encrypted_path)");
+	xfree(gpg_tmp_path);
+	gpg_tmp_path = NULL;
+
+	sync_password_dir();
+
+	if (is_password_file) {
+		journal_remove(folded);
+		backend_collect(encrypt_target);
 	}
+
+	lock_store_unset();
+
+	if (is_password_file)
+		storage_push_begin();
+
+	xfree(encrypt_target);
+	encrypt_target = NULL;
+}
+
+
+/*
+ * Saves the content of the given plain-text file through GnuPG to the target.
+ */
+void
+gpg_encrypt(const char *path, const char *target)
+{
+	static char buf[65536];
+	ssize_t len;
+	FILE *fp;
+	int fd;
+
+	/* The plain-text must not leak into the gpg process. */
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		err(EXIT_FAILURE, "gpg_encrypt open(%s)", path);
+
+	fp = gpg_encrypt_open(target);
+
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		if (fwrite(buf, 1, len, fp) != (size_t)len)
+			break;
+	}
+	if (len == -1)
+		err(EXIT_FAILURE, "gpg_encrypt read(%s)", path);
+
+	close(fd);
+	memset(buf, 0, sizeof(buf));
+
+	gpg_encrypt_close(fp);
 }
@@ -17,11 +17,45 @@
 #ifndef _GPG_H_
 #define _GPG_H_
 
+#include <sys/types.h>
+
 #include <stdio.h>
+#include <stdbool.h>
+
+#include "backend.h"
+
+/* Read size of gpg_decrypt_all(), also the initial buffer size. */
+#define GPG_PLAIN_CHUNK 65536
+
+/*
+ * A file decrypted in memory by gpg_decrypt_all(), by the backend of its
+ * format (see backend.h) which keeps its state in handle. The reason of a
+ * failure is kept in error (see gpg_plain_fail()).
+ */
+struct gpg_plain {
+	char		*path;
+	char		*data;
+	size_t		 len;
+	size_t		 size;
+	int		 fd;
+	const struct backend_ops *backend;
+	void		*handle;
+	long long	 deadline;
+	bool		 timed_out;
+	int		 retcode;
+	char		*error;
+};
+
+extern char	*gpg_tmp_path;
 
-FILE 		*gpg_open(void);
-int		 gpg_close(FILE *);
-void		 gpg_encrypt(const char *);
+bool		 gpg_decrypt_all(struct gpg_plain *, unsigned int,
+		     unsigned int);
+void		 gpg_plain_fail(struct gpg_plain *, const char *, ...)
+		     __attribute__((format(printf, 2, 3)));
+void		 gpg_plain_free(struct gpg_plain *);
+FILE		*gpg_encrypt_open(const char *);
+void		 gpg_encrypt_close(FILE *);
+void		 gpg_encrypt(const char *, const char *);
 void		 gpg_check(void);
 
 #endif /* _GPG_H_ */
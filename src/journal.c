@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Journal of the password file.
+ *
+ * With 'set journal on', new passwords are not merged in the password file,
+ * they are encrypted on their own in segments next to it (passwords.1,
+ * passwords.2, ...). Readers decrypt the password file then each segment in
+ * order, stopping at the first missing one. Any full rewrite of the password
+ * file (edit, set, compact, ...) folds the segments in it and removes them.
+ *
+ * The rewrite can't replace the password file and remove the segments at
+ * once. Before the rename, a marker (passwords.folded) names the new file
+ * (inode and size) and the last segment it holds. If the process dies before
+ * the segments are gone, readers skip those the password file already has
+ * and the next save finishes the removal. A marker naming another file is
+ * from a save that never got to its rename, it is ignored.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+
+#include "config.h"
+#include "debug.h"
+#include "journal.h"
+#include "utils.h"
+#include "xmalloc.h"
+
+
+/*
+ * Path of the nth segment (starting at 1), callers free it.
+ */
+char *
+journal_segment_path(unsigned int n)
+{
+	char *path;
+
+	xasprintf(&path, "%s.%u", cfg_password_file, n);
+
+	return (path);
+}
+
+
+/*
+ * Path of the marker of the segments folded in the password file, callers
+ * free it.
+ */
+static char *
+journal_fold_path(void)
+{
+	char *path;
+
+	xasprintf(&path, "%s.folded", cfg_password_file);
+
+	return (path);
+}
+
+
+/*
+ * Number of leading segments already part of the password file, left behind
+ * by a save that was interrupted after its rename (see journal_fold_begin()).
+ */
+unsigned int
+journal_folded(void)
+{
+	unsigned long long ino;
+	long long size;
+	unsigned int last;
+	struct stat sb;
+	char *path;
+	FILE *fp;
+	int n;
+
+	path = journal_fold_path();
+	fp = fopen(path, "r");
+	xfree(path);
+	if (fp == NULL)
+		return (0);
+
+	n = fscanf(fp, "%u %llu %lld", &last, &ino, &size);
+	fclose(fp);
+
+	if (n != 3 || stat(cfg_password_file, &sb) != 0 ||
+			(unsigned long long)sb.st_ino != ino ||
+			(long long)sb.st_size != size)
+		return (0);
+
+	debug("journal_folded: segments 1 to %u are in the password file",
+			last);
+
+	return (last);
+}
+
+
+/*
+ * Number of the last segment to read after the password file, those up to
+ * journal_folded() are skipped.
+ */
+unsigned int
+journal_segment_count(void)
+{
+	unsigned int count = journal_folded();
+	char *path;
+
+	for (;;) {
+		path = journal_segment_path(count + 1);
+		if (!file_exists(path)) {
+			xfree(path);
+			break;
+		}
+		xfree(path);
+		count++;
+	}
+
+	return (count);
+}
+
+
+/*
+ * Path of the segment to create, callers free it.
+ *
+ * The removal of an interrupted fold is finished first. Segments left past a
+ * gap (an interrupted journal_remove) are already part of the password file,
+ * they are removed so they aren't read again after the new one.
+ */
+char *
+journal_next_segment(void)
+{
+	unsigned int n;
+	char *path;
+
+	journal_remove(journal_folded());
+
+	n = journal_segment_count() + 1;
+
+	for (unsigned int i = n + 1; ; i++) {
+		path = journal_segment_path(i);
+		if (unlink(path) != 0) {
+			xfree(path);
+			break;
+		}
+		debug("journal_next_segment removed stale %s", path);
+		xfree(path);
+	}
+
+	return (journal_segment_path(n));
+}
+
+
+/*
+ * Record that the new password file at new_path, about to be renamed in
+ * place, holds all the segments that were read. Returns the number of the
+ * last one for journal_remove(). The marker is written (and renamed) before
+ * the password file, the caller syncs the directory.
+ */
+unsigned int
+journal_fold_begin(const char *new_path)
+{
+	char *path, *tmp_path, buf[64];
+	unsigned int last;
+	struct stat sb;
+	int fd, len;
+
+	last = journal_segment_count();
+	path = journal_fold_path();
+
+	if (last == 0) {
+		if (unlink(path) != 0 && errno != ENOENT)
+			err(EXIT_FAILURE, "journal_fold_begin unlink(%s)",
+					path);
+		xfree(path);
+		return (0);
+	}
+
+	if (stat(new_path, &sb) != 0)
+		err(EXIT_FAILURE, "journal_fold_begin stat(%s)", new_path);
+	len = snprintf(buf, sizeof(buf), "%u %llu %lld\n", last,
+			(unsigned long long)sb.st_ino, (long long)sb.st_size);
+
+	xasprintf(&tmp_path, "%s.tmp", path);
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1)
+		err(EXIT_FAILURE, "journal_fold_begin open(%s)", tmp_path);
+	if (!write_full(fd, buf, len) || fsync(fd) != 0)
+		err(EXIT_FAILURE, "journal_fold_begin write(%s)", tmp_path);
+	close(fd);
+	if (rename(tmp_path, path) != 0)
+		err(EXIT_FAILURE, "journal_fold_begin rename(%s)", path);
+
+	debug("journal_fold_begin: segments 1 to %u", last);
+
+	xfree(tmp_path);
+	xfree(path);
+
+	return (last);
+}
+
+
+/*
+ * Remove the segments up to last, once the password file holding them is in
+ * place, then the marker. They are removed in order so an interruption
+ * leaves a gap and the remaining ones are not read.
+ */
+void
+journal_remove(unsigned int last)
+{
+	char *path;
+
+	for (unsigned int n = 1; n <= last; n++) {
+		path = journal_segment_path(n);
+		if (unlink(path) != 0 && errno != ENOENT)
+			err(EXIT_FAILURE, "journal_remove unlink(%s)", path);
+		debug("journal_remove %s", path);
+		xfree(path);
+	}
+
+	path = journal_fold_path();
+	if (unlink(path) != 0 && errno != ENOENT)
+		err(EXIT_FAILURE, "journal_remove unlink(%s)", path);
+	xfree(path);
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2014 Bertrand Janin <b@janin.com>
+ * Copyright (c) 2012-2015 Bertrand Janin <b@janin.com>
  *
  * Permission to use, copy, modify, and distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -14,56 +14,207 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+/*
+ * Advisory locks on byte ranges of the lock file, with fcntl(2). The locks
+ * belong to the process and vanish with it, the file itself stays.
+ *
+ *  - LOCK_WRITER is held exclusively by the commands changing the password
+ *    file, from the moment they read it until they exit.
+ *  - LOCK_STORE is shared while the password file and its journal segments
+ *    are read, exclusive while they are replaced (renames and removals). A
+ *    reader never sees half of a save.
+ *
+ * Waiting for a lock is bounded by lock_timeout, except for the exclusive
+ * LOCK_STORE: the readers holding it are themselves bounded by the gpg
+ * timeout and giving up there would lose the changes being saved.
+ */
+
+#include <sys/types.h>
+
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
 #include <err.h>
 
+#include "debug.h"
 #include "utils.h"
 #include "lock.h"
 
 
-char *lock_path = NULL;
+#define LOCK_WRITER	0
+#define LOCK_STORE	1
+
+/* Longest pause between two attempts, in nanoseconds. */
+#define LOCK_MAX_DELAY	100000000L
+
+char		*lock_path = NULL;
+unsigned int	 lock_timeout = 10;
+
+static int	 lock_fd = -1;
+
+
+/*
+ * Open the lock file, created as needed.
+ */
+static void
+lock_open(void)
+{
+	if (lock_fd != -1)
+		return;
+
+	lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (lock_fd == -1)
+		err(EXIT_FAILURE, "lock open(%s)", lock_path);
+}
+
+
+/*
+ * Lock (F_RDLCK, F_WRLCK) or unlock (F_UNLCK) a byte of the lock file.
+ * Without wait, returns false if someone else holds a conflicting lock.
+ */
+static bool
+lock_byte(off_t offset, short type, bool wait)
+{
+	struct flock fl;
+
+	lock_open();
+
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = offset;
+	fl.l_len = 1;
+
+	while (fcntl(lock_fd, wait ? F_SETLKW : F_SETLK, &fl) == -1) {
+		if (errno == EINTR)
+			continue;
+		if (!wait && (errno == EACCES || errno == EAGAIN))
+			return (false);
+		err(EXIT_FAILURE, "lock fcntl(%s)", lock_path);
+	}
+
+	return (true);
+}
+
+
+/*
+ * Try to lock the byte until lock_timeout seconds have passed, backing off
+ * from 1 ms to LOCK_MAX_DELAY between attempts. Exit the program with error
+ * status on timeout.
+ */
+static void
+lock_byte_bounded(off_t offset, short type)
+{
+	struct timespec delay = { 0, 1000000L };
+	long long deadline;
+
+	if (lock_byte(offset, type, false))
+		return;
+
+	debug("lock: waiting up to %u seconds", lock_timeout);
+	deadline = now_ms() + (long long)lock_timeout * 1000;
+
+	do {
+		if (now_ms() >= deadline)
+			errx(EXIT_FAILURE, "locked (%s)", lock_path);
+
+		nanosleep(&delay, NULL);
+		if (delay.tv_nsec < LOCK_MAX_DELAY)
+			delay.tv_nsec *= 2;
+		if (delay.tv_nsec > LOCK_MAX_DELAY)
+			delay.tv_nsec = LOCK_MAX_DELAY;
+	} while (!lock_byte(offset, type, false));
+}
 
 
 /*
- * Test if the lock exist.
+ * Test if another process holds the writer lock.
  */
 bool
 lock_exists()
 {
-	return file_exists(lock_path);
+	struct flock fl;
+
+	lock_open();
+
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = LOCK_WRITER;
+	fl.l_len = 1;
+
+	if (fcntl(lock_fd, F_GETLK, &fl) == -1)
+		err(EXIT_FAILURE, "lock fcntl(%s)", lock_path);
+
+	return (fl.l_type != F_UNLCK);
 }
 
 
 /*
- * Sets the lock. Exit the program with error status if the lock is already
- * present.
+ * Sets the writer lock, waiting for the current writer at most lock_timeout
+ * seconds. Exit the program with error status if it is still held.
  */
 void
 lock_set()
 {
-	FILE *fp;
+	lock_byte_bounded(LOCK_WRITER, F_WRLCK);
+}
 
-	if (lock_exists()) {
-		errx(EXIT_FAILURE, "locked (%s)", lock_path);
-	}
 
-	fp = fopen(lock_path, "w");
-	fprintf(fp, "%d", getpid());
-	fclose(fp);
+/*
+ * Sets the writer lock if no one holds it, without waiting.
+ */
+bool
+lock_try()
+{
+	return (lock_byte(LOCK_WRITER, F_WRLCK, false));
 }
 
 
 /*
- * Unset the lock. Exit silently if already gone.
+ * Release all the locks. Exit silently if none was held.
  */
 void
 lock_unset()
 {
-	if (lock_exists()) {
-		if (unlink(lock_path) != 0) {
-			err(EXIT_FAILURE, "lock_unset:unlink()");
-		}
-	}
+	if (lock_fd == -1)
+		return;
+
+	/* Closing the file releases all the locks of the process on it. */
+	close(lock_fd);
+	lock_fd = -1;
+}
+
+
+/*
+ * Share the store lock to read the password file, waiting at most
+ * lock_timeout seconds for a save to complete.
+ */
+void
+lock_store_shared()
+{
+	lock_byte_bounded(LOCK_STORE, F_RDLCK);
+}
+
+
+/*
+ * Hold the store lock exclusively to replace the password file, once the
+ * current readers are done.
+ */
+void
+lock_store_exclusive()
+{
+	lock_byte(LOCK_STORE, F_WRLCK, true);
+}
+
+
+/*
+ * Release the store lock, the writer lock is kept.
+ */
+void
+lock_store_unset()
+{
+	if (lock_fd != -1)
+		lock_byte(LOCK_STORE, F_UNLCK, false);
 }
@@ -19,10 +19,15 @@
 
 #include <stdbool.h>
 
-extern char	*lock_path;
+extern char		*lock_path;
+extern unsigned int	 lock_timeout;
 
 bool		 lock_exists(void);
 void		 lock_set(void);
+bool		 lock_try(void);
 void		 lock_unset(void);
+void		 lock_store_shared(void);
+void		 lock_store_exclusive(void);
+void		 lock_store_unset(void);
 
 #endif /* _LOCK_H_ */
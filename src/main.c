@@ -14,21 +14,27 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <err.h>
 #include <locale.h>
 #include <signal.h>
 
+#include "audit.h"
 #include "cleanup.h"
 #include "cmd.h"
 #include "config.h"
 #include "debug.h"
 #include "editor.h"
 #include "gpg.h"
+#include "journal.h"
 #include "lock.h"
+#include "mutate.h"
 #include "pager.h"
 #include "profile.h"
 #include "results.h"
+#include "storage.h"
 #include "utils.h"
 #include "xmalloc.h"
 
@@ -49,6 +55,22 @@ setup_signals_and_atexit(void)
 }
 
 
+/*
+ * Bring the password file up to date before an edit. The lock is released
+ * right away, the edit only takes it to save (see edit_results).
+ */
+static void
+sync_storage(void)
+{
+	if (!storage_enabled())
+		return;
+
+	lock_set();
+	storage_sync();
+	lock_unset();
+}
+
+
 static void
 mdp_add(void)
 {
@@ -67,13 +89,52 @@ mdp_add(void)
 	}
 
 	gpg_check();
-	lock_set();
 
 	setup_signals_and_atexit();
+	sync_storage();
+
+	/*
+	 * In journal mode, only the new passwords are edited and they are
+	 * saved in their own segment, the password file isn't decrypted.
+	 */
+	if (cfg_journal) {
+		profile_passwords_to_results(profile, cmd_add_prefix);
+		edit_results(NULL, true);
+		return;
+	}
 
 	load_results_gpg();
 	profile_passwords_to_results(profile, cmd_add_prefix);
-	edit_results();
+	edit_results(cfg_password_file, true);
+}
+
+
+static void
+mdp_compact(void)
+{
+	unsigned int count;
+
+	debug("mdp_compact()");
+
+	gpg_check();
+	lock_set();
+
+	setup_signals_and_atexit();
+	storage_sync();
+
+	/* What an interrupted save left behind only needs to be removed. */
+	count = journal_segment_count() - journal_folded();
+	if (count == 0) {
+		journal_remove(journal_folded());
+		fprintf(stderr, "No journal segments, exiting...\n");
+		return;
+	}
+
+	/* Saving the password file folds the segments in it. */
+	load_results_gpg();
+	save_results_gpg(cfg_password_file);
+
+	fprintf(stderr, "%u journal segment(s) compacted.\n", count);
 }
 
 
@@ -83,12 +144,30 @@ mdp_edit(void)
 	debug("mdp_edit()");
 
 	gpg_check();
-	lock_set();
 
 	setup_signals_and_atexit();
+	sync_storage();
 
 	load_results_gpg();
-	edit_results();
+	edit_results(cfg_password_file, false);
+}
+
+
+/*
+ * Report reused and weak passwords, by line number only.
+ */
+static void
+mdp_audit(void)
+{
+	debug("mdp_audit()");
+
+	gpg_check();
+	storage_refresh_begin();
+
+	if (load_results_gpg() == 0)
+		errx(EXIT_FAILURE, "no passwords");
+
+	audit_results(stdout, cmd_output_field, cmd_audit_minimum);
 }
 
 
@@ -109,16 +188,101 @@ mdp_generate(void)
 		errx(EXIT_FAILURE, "unknown profile");
 	}
 
+	if (cmd_entropy) {
+		fprintf(stderr, "%.1f bits\n", profile_entropy(profile));
+	}
+
 	profile_fprint_passwords(stdout, profile);
 }
 
 
+/*
+ * Shared by set, rm and replace. The password file is decrypted, changed in
+ * memory and encrypted back, no temporary file nor editor involved.
+ */
+static void
+mdp_mutate(enum mutation op)
+{
+	struct profile *profile = NULL;
+	FILE *fp = NULL;
+
+	debug("mdp_mutate(%d)", op);
+
+	if (cmd_profile_name == NULL) {
+		profile = profile_new("default");
+	} else {
+		profile = profile_get_from_name(cmd_profile_name);
+	}
+
+	if (profile == NULL) {
+		errx(EXIT_FAILURE, "unknown profile");
+	}
+
+	if (cmd_batch_path != NULL) {
+		if (strcmp(cmd_batch_path, "-") == 0) {
+			fp = stdin;
+		} else if ((fp = fopen(cmd_batch_path, "r")) == NULL) {
+			err(EXIT_FAILURE, "unable to open %s", cmd_batch_path);
+		}
+	}
+
+	gpg_check();
+	lock_set();
+
+	setup_signals_and_atexit();
+	storage_sync();
+
+	if (load_results_gpg() == 0)
+		errx(EXIT_FAILURE, "no passwords");
+
+	if (fp == NULL) {
+		mutate_results(op, profile, cmd_value);
+	} else {
+		mutate_results_batch(op, profile, fp);
+		if (fp != stdin)
+			fclose(fp);
+	}
+}
+
+
+static void
+mdp_get_batch(void)
+{
+	FILE *fp;
+
+	debug("mdp_get_batch(%s)", cmd_batch_path);
+
+	if (strcmp(cmd_batch_path, "-") == 0) {
+		fp = stdin;
+	} else if ((fp = fopen(cmd_batch_path, "r")) == NULL) {
+		err(EXIT_FAILURE, "unable to open %s", cmd_batch_path);
+	}
+
+	gpg_check();
+	storage_refresh_begin();
+
+	if (load_results_gpg() == 0)
+		errx(EXIT_FAILURE, "no passwords");
+
+	print_results_batch(fp);
+
+	if (fp != stdin)
+		fclose(fp);
+}
+
+
 static void
 mdp_get(void)
 {
 	debug("mdp_get()");
 
+	if (cmd_batch_path != NULL) {
+		mdp_get_batch();
+		return;
+	}
+
 	gpg_check();
+	storage_refresh_begin();
 
 	if (load_results_gpg() == 0)
 		errx(EXIT_FAILURE, "no passwords");
@@ -139,9 +303,17 @@ mdp_prompt(void)
 	debug("mdp_prompt()");
 
 	gpg_check();
+	storage_refresh_begin();
 
-	if (load_results_gpg() == 0)
+	/*
+	 * Decrypt while the user is typing keywords, unless GnuPG might need
+	 * the terminal to ask for a passphrase.
+	 */
+	if (cfg_prompt_prefetch) {
+		load_results_gpg_begin();
+	} else if (load_results_gpg() == 0) {
 		errx(EXIT_FAILURE, "no passwords");
+	}
 
 	pager_with_prompt();
 }
@@ -215,12 +387,27 @@ main(int argc, char **argv)
 	} else if (command_match(argv[0], "add", 1)) {
 		cmd_parse_add(argc, argv);
 		mdp_add();
+	} else if (command_match(argv[0], "audit", 2)) {
+		cmd_parse_audit(argc, argv);
+		mdp_audit();
+	} else if (command_match(argv[0], "compact", 1)) {
+		cmd_parse_compact(argc, argv);
+		mdp_compact();
 	} else if (command_match(argv[0], "get", 3)) {
 		cmd_parse_get(argc, argv);
 		mdp_get();
 	} else if (command_match(argv[0], "prompt", 1)) {
 		cmd_parse_prompt(argc, argv);
 		mdp_prompt();
+	} else if (command_match(argv[0], "set", 3)) {
+		cmd_parse_set(argc, argv);
+		mdp_mutate(MUTATION_SET);
+	} else if (command_match(argv[0], "rm", 2)) {
+		cmd_parse_rm(argc, argv);
+		mdp_mutate(MUTATION_REMOVE);
+	} else if (command_match(argv[0], "replace", 3)) {
+		cmd_parse_replace(argc, argv);
+		mdp_mutate(MUTATION_REPLACE);
 	} else {
 		errx(EXIT_FAILURE, "unknown command '%s' (try mdp -h)", argv[0]);
 	}
@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Line-level three-way merge, as diff3(1).
+ *
+ * The lines of the base are matched with the lines of each side along a
+ * shortest edit script (Myers' O(ND) diff, after the common prefix and
+ * suffix are set aside). The base lines matched on both sides split the
+ * texts in stable chunks, copied as is, and unstable ones in between. An
+ * unstable chunk changed on one side only takes that side, one changed the
+ * same way on both sides is taken once. Lines added at the same place on
+ * both sides are all kept, theirs first: the order of the lines of a
+ * password file doesn't matter much. Anything else is a conflict, both
+ * versions are written between markers.
+ */
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "merge.h"
+#include "xmalloc.h"
+
+
+#define MERGE_OURS	"<<<<<<< yours"
+#define MERGE_SEPARATOR	"======="
+#define MERGE_THEIRS	">>>>>>> saved meanwhile"
+
+/*
+ * A text with the hash of each line, to compare lines quickly.
+ */
+struct merge_side {
+	struct merge_text *text;
+	uint32_t	*hashes;
+};
+
+
+/*
+ * Append a copy of the line (without its new line).
+ */
+void
+merge_text_add(struct merge_text *text, const char *line, size_t len)
+{
+	char *copy;
+
+	copy = xmalloc(len + 1);
+	memcpy(copy, line, len);
+	copy[len] = '\0';
+
+	ARRAY_ADD(text, copy);
+}
+
+
+/*
+ * Append all the lines of the stream.
+ */
+void
+merge_text_read(struct merge_text *text, FILE *fp)
+{
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+
+	while ((len = getline(&line, &size, fp)) != -1) {
+		if (len > 0 && line[len - 1] == '\n')
+			len--;
+		merge_text_add(text, line, len);
+	}
+
+	if (line != NULL) {
+		memset(line, 0, size);
+		xfree(line);
+	}
+}
+
+
+/*
+ * Wipe and free the lines.
+ */
+void
+merge_text_free(struct merge_text *text)
+{
+	char *line;
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(text); i++) {
+		line = ARRAY_ITEM(text, i);
+		memset(line, 0, strlen(line));
+		xfree(line);
+	}
+
+	ARRAY_FREE(text);
+}
+
+
+/*
+ * FNV-1a of each line.
+ */
+static void
+merge_side_init(struct merge_side *side, struct merge_text *text)
+{
+	const unsigned char *c;
+	uint32_t h;
+
+	side->text = text;
+	side->hashes = xcalloc(ARRAY_LENGTH(text) + 1, sizeof(uint32_t));
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(text); i++) {
+		h = 2166136261u;
+		for (c = (unsigned char *)ARRAY_ITEM(text, i); *c != '\0'; c++)
+			h = (h ^ *c) * 16777619u;
+		side->hashes[i] = h;
+	}
+}
+
+
+static bool
+merge_line_eq(struct merge_side *a, int i, struct merge_side *b, int j)
+{
+	return (a->hashes[i] == b->hashes[j] &&
+			strcmp(ARRAY_ITEM(a->text, i), ARRAY_ITEM(b->text, j)) == 0);
+}
+
+
+/*
+ * Match the lines of a (from a0 to a1) with the lines of b (from b0 to b1)
+ * along a shortest edit script: match[i] is set to the line of b equal to
+ * the line i of a, it is left to -1 for the lines removed from a. Returns
+ * false if more than MERGE_MAX_EDITS are needed.
+ *
+ * The furthest point reached on each diagonal k before step d is kept in
+ * trace[d][k + d + 1] to walk the script back.
+ */
+static bool
+merge_myers(struct merge_side *a, int a0, int a1, struct merge_side *b,
+    int b0, int b1, int *match)
+{
+	int n = a1 - a0, m = b1 - b0, max, off, x, y, k, d, prev_k, prev_x;
+	int *v, **trace;
+	bool found = false;
+
+	max = n + m;
+	if (max > MERGE_MAX_EDITS)
+		max = MERGE_MAX_EDITS;
+	off = max + 1;
+
+	v = xcalloc(2 * max + 3, sizeof(int));
+	trace = xcalloc(max + 1, sizeof(int *));
+
+	for (d = 0; d <= max && !found; d++) {
+		trace[d] = xcalloc(2 * d + 3, sizeof(int));
+		memcpy(trace[d], v + off - d - 1, (2 * d + 3) * sizeof(int));
+
+		for (k = -d; k <= d; k += 2) {
+			if (k == -d || (k != d && v[off + k - 1] < v[off + k + 1]))
+				x = v[off + k + 1];
+			else
+				x = v[off + k - 1] + 1;
+			y = x - k;
+			while (x < n && y < m &&
+					merge_line_eq(a, a0 + x, b, b0 + y)) {
+				x++;
+				y++;
+			}
+			v[off + k] = x;
+			if (x >= n && y >= m) {
+				found = true;
+				break;
+			}
+		}
+	}
+
+	if (found) {
+		x = n;
+		y = m;
+		for (d--; d > 0; d--) {
+			k = x - y;
+			if (k == -d || (k != d && trace[d][k - 1 + d + 1] <
+					trace[d][k + 1 + d + 1]))
+				prev_k = k + 1;
+			else
+				prev_k = k - 1;
+			prev_x = trace[d][prev_k + d + 1];
+			while (x > prev_x && y > prev_x - prev_k) {
+				match[a0 + --x] = b0 + --y;
+			}
+			x = prev_x;
+			y = prev_x - prev_k;
+		}
+		while (x > 0 && y > 0)
+			match[a0 + --x] = b0 + --y;
+	}
+
+	for (d = 0; d <= max && trace[d] != NULL; d++)
+		xfree(trace[d]);
+	xfree(trace);
+	xfree(v);
+
+	return (found);
+}
+
+
+/*
+ * Match the lines of the base with the lines of one side, see merge_myers.
+ * If they are too different, only their common prefix and suffix match.
+ */
+static int *
+merge_match(struct merge_side *base, struct merge_side *side)
+{
+	int n = ARRAY_LENGTH(base->text), m = ARRAY_LENGTH(side->text);
+	int prefix = 0, suffix = 0;
+	int *match;
+
+	match = xcalloc(n + 1, sizeof(int));
+	for (int i = 0; i < n; i++)
+		match[i] = -1;
+
+	while (prefix < n && prefix < m &&
+			merge_line_eq(base, prefix, side, prefix)) {
+		match[prefix] = prefix;
+		prefix++;
+	}
+	while (suffix < n - prefix && suffix < m - prefix &&
+			merge_line_eq(base, n - suffix - 1, side, m - suffix - 1)) {
+		match[n - suffix - 1] = m - suffix - 1;
+		suffix++;
+	}
+
+	merge_myers(base, prefix, n - suffix, side, prefix, m - suffix, match);
+
+	return (match);
+}
+
+
+static bool
+merge_range_eq(struct merge_side *a, int a0, int a1, struct merge_side *b,
+    int b0, int b1)
+{
+	if (a1 - a0 != b1 - b0)
+		return (false);
+
+	for (int i = 0; i < a1 - a0; i++) {
+		if (!merge_line_eq(a, a0 + i, b, b0 + i))
+			return (false);
+	}
+
+	return (true);
+}
+
+
+static void
+merge_write(FILE *out, struct merge_side *side, int from, int to)
+{
+	for (int i = from; i < to; i++)
+		fprintf(out, "%s\n", ARRAY_ITEM(side->text, i));
+}
+
+
+/*
+ * Merge the changes made from base to ours and from base to theirs, write the
+ * result to out. Returns the number of conflicts, each written as both
+ * versions between markers.
+ */
+unsigned int
+merge3(struct merge_text *base_text, struct merge_text *ours_text,
+    struct merge_text *theirs_text, FILE *out)
+{
+	struct merge_side base, ours, theirs;
+	int nb, no, nt, ib = 0, io = 0, it = 0, jb, jo, jt;
+	int *match_ours, *match_theirs;
+	unsigned int conflicts = 0;
+
+	merge_side_init(&base, base_text);
+	merge_side_init(&ours, ours_text);
+	merge_side_init(&theirs, theirs_text);
+
+	nb = ARRAY_LENGTH(base_text);
+	no = ARRAY_LENGTH(ours_text);
+	nt = ARRAY_LENGTH(theirs_text);
+
+	match_ours = merge_match(&base, &ours);
+	match_theirs = merge_match(&base, &theirs);
+
+	while (ib < nb || io < no || it < nt) {
+		/* Stable line, unchanged on both sides. */
+		if (ib < nb && match_ours[ib] == io && match_theirs[ib] == it) {
+			merge_write(out, &base, ib, ib + 1);
+			ib++;
+			io++;
+			it++;
+			continue;
+		}
+
+		/* The unstable chunk ends at the next base line kept by both. */
+		for (jb = ib; jb < nb; jb++) {
+			if (match_ours[jb] != -1 && match_theirs[jb] != -1)
+				break;
+		}
+		jo = jb < nb ? match_ours[jb] : no;
+		jt = jb < nb ? match_theirs[jb] : nt;
+
+		if (merge_range_eq(&base, ib, jb, &ours, io, jo)) {
+			merge_write(out, &theirs, it, jt);
+		} else if (merge_range_eq(&base, ib, jb, &theirs, it, jt) ||
+				merge_range_eq(&ours, io, jo, &theirs, it, jt)) {
+			merge_write(out, &ours, io, jo);
+		} else if (ib == jb) {
+			merge_write(out, &theirs, it, jt);
+			merge_write(out, &ours, io, jo);
+		} else {
+			fprintf(out, "%s\n", MERGE_OURS);
+			merge_write(out, &ours, io, jo);
+			fprintf(out, "%s\n", MERGE_SEPARATOR);
+			merge_write(out, &theirs, it, jt);
+			fprintf(out, "%s\n", MERGE_THEIRS);
+			conflicts++;
+		}
+
+		ib = jb;
+		io = jo;
+		it = jt;
+	}
+
+	xfree(match_ours);
+	xfree(match_theirs);
+	xfree(base.hashes);
+	xfree(ours.hashes);
+	xfree(theirs.hashes);
+
+	return (conflicts);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _MERGE_H_
+#define _MERGE_H_
+
+#include <stdio.h>
+
+#include "array.h"
+
+/* Changes too far apart to be matched line by line are one conflict. */
+#define MERGE_MAX_EDITS		2048
+
+ARRAY_DECL(merge_text, char *);
+
+void		 merge_text_add(struct merge_text *, const char *, size_t);
+void		 merge_text_read(struct merge_text *, FILE *);
+void		 merge_text_free(struct merge_text *);
+unsigned int	 merge3(struct merge_text *, struct merge_text *,
+		     struct merge_text *, FILE *);
+
+#endif /* _MERGE_H_ */
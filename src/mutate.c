@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Editor-less changes to the password file (set, rm and replace commands).
+ *
+ * Each query has to select exactly one line, and a line can only be changed
+ * once per batch. All the changes are made on the results in memory and the
+ * password file is encrypted once at the end, if any query fails nothing is
+ * saved.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <err.h>
+
+#include "array.h"
+#include "config.h"
+#include "keywords.h"
+#include "mdp.h"
+#include "mutate.h"
+#include "output.h"
+#include "profile.h"
+#include "results.h"
+#include "str.h"
+#include "xmalloc.h"
+
+
+/*
+ * Lines changed so far (by 'set' or 'replace'), those of 'set' are printed
+ * once the password file is saved.
+ */
+struct change {
+	unsigned int	 query_id;
+	struct result	*result;
+	bool		 print;
+};
+
+ARRAY_DECL(changelist, struct change);
+
+static struct changelist changes = ARRAY_INITIALIZER;
+
+
+/*
+ * Exit with the given message, prefixed by the query id in batch mode.
+ */
+static void
+query_err(unsigned int query_id, const char *msg)
+{
+	if (query_id > 0)
+		errx(EXIT_FAILURE, "query %u: %s", query_id, msg);
+
+	errx(EXIT_FAILURE, "%s", msg);
+}
+
+
+/*
+ * Return the index of the only line matching the current keywords.
+ */
+static unsigned int
+find_one(unsigned int query_id)
+{
+	unsigned int index = 0, count = 0;
+
+	filter_results();
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
+		if (ARRAY_ITEM(&results, i)->visible) {
+			index = i;
+			count++;
+		}
+	}
+
+	if (count == 1)
+		return (index);
+
+	if (query_id > 0) {
+		errx(EXIT_FAILURE, "query %u: %s", query_id, count == 0 ?
+				"no matching line" : "ambiguous, matches more "
+				"than one line");
+	}
+
+	errx(EXIT_FAILURE, "%s", count == 0 ? "no matching line" :
+			"ambiguous query, matches more than one line");
+}
+
+
+/*
+ * Swap the line at the given index with a new value, the previous value is
+ * wiped.
+ */
+static struct result *
+replace_line(unsigned int index, const wchar_t *value)
+{
+	struct result *old, *new;
+
+	new = result_new(value);
+	if (new == NULL)
+		errx(EXIT_FAILURE, "unable to use the new line (wrong locale?)");
+
+	old = ARRAY_ITEM(&results, index);
+	ARRAY_SET(&results, index, new);
+
+	result_kill(old);
+
+	return (new);
+}
+
+
+/*
+ * Replace the password of a line (its last field) with the given value or a
+ * password generated from the profile. A line with a single field has no
+ * password to replace.
+ */
+static struct result *
+set_password(unsigned int query_id, unsigned int index,
+		struct profile *profile, const wchar_t *value)
+{
+	static wchar_t line[MAX_LINE_SIZE];
+	const wchar_t *current;
+	wchar_t *password = NULL;
+	struct result *result;
+	size_t prefix_len;
+
+	current = ARRAY_ITEM(&results, index)->wcs_value;
+
+	/* Keep everything up to the last field. */
+	prefix_len = wcslen(current);
+	while (prefix_len > 0 && current[prefix_len - 1] != L' ' &&
+			current[prefix_len - 1] != L'\t')
+		prefix_len--;
+
+	if (prefix_len == 0 || wcsspn(current, L" \t") == prefix_len)
+		query_err(query_id, "the matching line has a single field, no "
+				"password to replace");
+
+	if (value == NULL)
+		value = password = profile_generate_password(profile);
+
+	if (prefix_len + wcslen(value) >= MAX_LINE_SIZE)
+		errx(EXIT_FAILURE, "the new line is too long");
+
+	wmemcpy(line, current, prefix_len);
+	wcscpy(line + prefix_len, value);
+
+	if (password != NULL) {
+		wmemset(password, L'\0', wcslen(password));
+		xfree(password);
+	}
+
+	result = replace_line(index, line);
+	wmemset(line, L'\0', MAX_LINE_SIZE);
+
+	return (result);
+}
+
+
+/*
+ * Refuse to change a line twice in the same batch, the first change would be
+ * lost (or printed from a freed line).
+ */
+static void
+check_unchanged(unsigned int query_id, unsigned int index)
+{
+	struct result *result = ARRAY_ITEM(&results, index);
+	struct change *change;
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&changes); i++) {
+		change = &ARRAY_ITEM(&changes, i);
+		if (change->result == result)
+			errx(EXIT_FAILURE, "query %u: the matching line was "
+					"already changed by query %u",
+					query_id, change->query_id);
+	}
+}
+
+
+static void
+apply(enum mutation op, unsigned int query_id, struct profile *profile,
+		const wchar_t *value)
+{
+	struct change change;
+	unsigned int index;
+
+	index = find_one(query_id);
+	check_unchanged(query_id, index);
+
+	change.query_id = query_id;
+	change.print = op == MUTATION_SET;
+
+	switch (op) {
+	case MUTATION_SET:
+		change.result = set_password(query_id, index, profile, value);
+		ARRAY_ADD(&changes, change);
+		break;
+	case MUTATION_REMOVE:
+		result_kill(ARRAY_ITEM(&results, index));
+		ARRAY_REMOVE(&results, index);
+		break;
+	case MUTATION_REPLACE:
+		change.result = replace_line(index, value);
+		ARRAY_ADD(&changes, change);
+		break;
+	}
+}
+
+
+/*
+ * Save the password file and print the lines changed by 'set'.
+ */
+static void
+commit(void)
+{
+	struct change *change;
+
+	save_results_gpg(cfg_password_file);
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&changes); i++) {
+		change = &ARRAY_ITEM(&changes, i);
+		if (change->print)
+			output_result(change->query_id, change->result);
+	}
+
+	output_flush();
+}
+
+
+/*
+ * Apply a change on the line matching the keywords from the command-line.
+ */
+void
+mutate_results(enum mutation op, struct profile *profile,
+		const wchar_t *value)
+{
+	apply(op, 0, profile, value);
+	commit();
+}
+
+
+/*
+ * Apply a change for each line of the given stream, formatted as the
+ * keywords, optionally followed by a tab and the value (new password for
+ * 'set', new line for 'replace'). Empty lines are skipped but still counted
+ * as query ids. A tab followed by nothing is an error, not a request for a
+ * generated password.
+ */
+void
+mutate_results_batch(enum mutation op, struct profile *profile, FILE *fp)
+{
+	static char line[MAX_LINE_SIZE];
+	unsigned int query_id = 0;
+	wchar_t *value;
+	char *tab;
+
+	while (fgets(line, sizeof(line), fp)) {
+		query_id++;
+
+		/* Split before stripping, the tab itself is a blank. */
+		line[strcspn(line, "\n")] = '\0';
+		if ((tab = strchr(line, '\t')) != NULL)
+			*tab = '\0';
+		strip_trailing_whitespaces(line);
+
+		if (line[0] == '\0') {
+			if (tab == NULL)
+				continue;
+			query_err(query_id, "missing the keywords");
+		}
+
+		value = NULL;
+		if (tab != NULL) {
+			strip_trailing_whitespaces(tab + 1);
+			if (tab[1] == '\0')
+				query_err(query_id, "empty value");
+			value = mbs_duplicate_as_wcs(tab + 1);
+			if (value == NULL) {
+				errx(EXIT_FAILURE, "query %u: unable to read "
+						"the value (wrong locale?)",
+						query_id);
+			}
+		}
+
+		if (op == MUTATION_REPLACE && value == NULL) {
+			errx(EXIT_FAILURE, "query %u: missing the new line",
+					query_id);
+		}
+
+		keywords_load_from_char(line);
+		apply(op, query_id, profile, value);
+
+		if (value != NULL) {
+			wmemset(value, L'\0', wcslen(value));
+			xfree(value);
+		}
+	}
+
+	memset(line, 0, sizeof(line));
+
+	commit();
+}
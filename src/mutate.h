@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _MUTATE_H_
+#define _MUTATE_H_
+
+#include <stdio.h>
+#include <wchar.h>
+
+#include "profile.h"
+
+enum mutation {
+	MUTATION_SET,
+	MUTATION_REMOVE,
+	MUTATION_REPLACE
+};
+
+void		 mutate_results(enum mutation, struct profile *,
+		    const wchar_t *);
+void		 mutate_results_batch(enum mutation, struct profile *, FILE *);
+
+#endif /* _MUTATE_H_ */
@@ -0,0 +1,712 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Native backend, 'set backend native'.
+ *
+ * Files are encrypted in-process with XChaCha20-Poly1305 (see aead.c) using a
+ * key derived from the key file (~/.mdp/key) instead of going through gpg.
+ * The key file is itself encrypted with gpg (to gpg_key_id), it is decrypted
+ * once per run: a copy of ~/.mdp is no more useful than with the gpg backend.
+ * A file starts with a 64 bytes header:
+ *
+ *	 0  magic "mdpaead1"
+ *	 8  key derivation, 1: HKDF-SHA256
+ *	 9  cipher, 1: XChaCha20-Poly1305
+ *	10  content, 0: data, 1: index of a container (see container.c)
+ *	11  reserved (zero)
+ *	12  chunk length, little endian
+ *	16  salt of the key derivation (32 bytes)
+ *	48  nonce prefix (16 bytes)
+ *
+ * followed by the chunks of plain-text, each sealed separately:
+ *
+ *	length (4 bytes, little endian, high bit set on the last chunk)
+ *	cipher-text (length bytes)
+ *	tag (16 bytes)
+ *
+ * The nonce of a chunk is the prefix followed by its index (little endian 64
+ * bits), the header and the length are authenticated with it. Chunks can't
+ * be re-ordered or dropped and the last one is flagged, a truncated file is
+ * an error. The file key is HKDF(key file, salt, "mdp native v1"), the salt
+ * and the prefix are new on every write.
+ *
+ * The work is done by a thread on the other side of a pipe, callers get a
+ * stream just like the one of gpg. When decrypting, each chunk is verified
+ * before any of its plain-text is written to the pipe.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <err.h>
+
+#include "aead.h"
+#include "arc4random.h"
+#include "backend.h"
+#include "config.h"
+#include "container.h"
+#include "debug.h"
+#include "gpg.h"
+#include "native.h"
+#include "sha256.h"
+#include "utils.h"
+#include "xmalloc.h"
+
+
+#define NATIVE_KEY_MAX		1024
+#define NATIVE_INFO		"mdp native v1"
+#define NATIVE_AD_LENGTH	(NATIVE_HEADER_LENGTH + 4)
+
+static uint8_t key_file_data[NATIVE_KEY_MAX];
+static size_t key_file_length = 0;
+
+
+static uint32_t
+load32_le(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+	    (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+
+static void
+store32_le(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+
+static void
+store64_le(uint8_t *p, uint64_t v)
+{
+	store32_le(p, v);
+	store32_le(p + 4, v >> 32);
+}
+
+
+/*
+ * Generate a new key file, encrypted with gpg. It is never overwritten.
+ */
+static void
+native_create_key(void)
+{
+	void *handle;
+	FILE *fp;
+	bool success;
+	int fd;
+
+	fd = open(cfg_key_file, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	if (fd == -1)
+		err(EXIT_FAILURE, "unable to create %s", cfg_key_file);
+
+	key_file_length = AEAD_KEY_LENGTH;
+	arc4random_buf(key_file_data, key_file_length);
+
+	fp = gpg_backend.encrypt_open(fd, cfg_key_file, &handle);
+	success = fwrite(key_file_data, 1, key_file_length, fp) ==
+	    key_file_length;
+	success = gpg_backend.encrypt_close(fp, handle) && success &&
+	    fsync(fd) == 0;
+	close(fd);
+
+	if (!success) {
+		unlink(cfg_key_file);
+		memset(key_file_data, 0, sizeof(key_file_data));
+		key_file_length = 0;
+		errx(EXIT_FAILURE, "unable to write %s", cfg_key_file);
+	}
+
+	fprintf(stderr, "A new key was created in %s, encrypted with gpg. Keep "
+			"a copy of it in a safe place: the passwords can't be "
+			"decrypted without it.\n", cfg_key_file);
+}
+
+
+/*
+ * Read the key file through gpg, creating it if asked to and it doesn't
+ * exist. It is read once, any length from 32 bytes to NATIVE_KEY_MAX is
+ * accepted.
+ *
+ * Returns false with the reason in error (to be freed) if the key couldn't
+ * be read, this can run in the background while the prompt is shown.
+ */
+static bool
+native_load_key(bool create, char **error)
+{
+	struct gpg_plain file;
+	bool success;
+
+	if (key_file_length > 0)
+		return (true);
+
+	if (!file_exists(cfg_key_file)) {
+		if (create) {
+			native_create_key();
+			return (true);
+		}
+		xasprintf(error, "unable to read the key file %s",
+				cfg_key_file);
+		return (false);
+	}
+
+	memset(&file, 0, sizeof(file));
+	file.path = cfg_key_file;
+	success = gpg_decrypt_all(&file, 1, 1) &&
+	    file.len >= AEAD_KEY_LENGTH && file.len < NATIVE_KEY_MAX;
+
+	if (success) {
+		memcpy(key_file_data, file.data, file.len);
+		key_file_length = file.len;
+	} else {
+		xasprintf(error, "unable to decrypt the key file %s with gpg "
+				"(%s)", cfg_key_file, file.error != NULL ?
+				file.error : "32 to 1023 bytes expected");
+	}
+	gpg_plain_free(&file);
+
+	return (success);
+}
+
+
+/*
+ * Read the key file or exit, for the commands about to write.
+ */
+static void
+native_need_key(bool create)
+{
+	char *error;
+
+	if (!native_load_key(create, &error))
+		errx(EXIT_FAILURE, "%s", error);
+}
+
+
+/*
+ * Derive a key of the given length from the key file, for the given salt and
+ * purpose.
+ */
+void
+native_derive(uint8_t *out, size_t len, const uint8_t *salt, size_t saltlen,
+    const char *info)
+{
+	native_need_key(false);
+
+	hkdf_sha256(out, len, key_file_data, key_file_length, salt, saltlen,
+	    info);
+}
+
+
+/*
+ * Nonce and associated data of the next chunk.
+ */
+static void
+native_chunk_params(struct native_stream *stream, const uint8_t *length,
+    uint8_t *nonce, uint8_t *ad)
+{
+	memcpy(nonce, stream->header + 48, NATIVE_PREFIX_LENGTH);
+	store64_le(nonce + NATIVE_PREFIX_LENGTH, stream->index++);
+
+	memcpy(ad, stream->header, NATIVE_HEADER_LENGTH);
+	memcpy(ad + NATIVE_HEADER_LENGTH, length, 4);
+}
+
+
+struct native_stream *
+native_stream_new(int fd, const char *path)
+{
+	struct native_stream *stream;
+
+	stream = xcalloc(1, sizeof(struct native_stream));
+	stream->fd = fd;
+	stream->pipe_fd = -1;
+	stream->path = path != NULL ? xstrdup(path) : NULL;
+
+	return (stream);
+}
+
+
+/*
+ * Wipe and release a stream, returns 1 if it had an error. The error is
+ * reported by the caller.
+ */
+int
+native_stream_free(struct native_stream *stream)
+{
+	int retcode = stream->error != NULL ? 1 : 0;
+
+	if (stream->path != NULL)
+		xfree(stream->path);
+
+	memset(stream, 0, sizeof(struct native_stream));
+	xfree(stream);
+
+	return (retcode);
+}
+
+
+/*
+ * Start the thread of a stream, on the other side of a pipe. The caller reads
+ * from (or writes to) stream->fp. Returns false if it couldn't be started.
+ */
+bool
+native_stream_start(struct native_stream *stream, void *(*main)(void *),
+    bool encrypt)
+{
+	int p[2];	// {read, write}
+
+	if (pipe(p) != 0) {
+		stream->error = "unable to create a pipe";
+		return (false);
+	}
+	stream->pipe_fd = encrypt ? p[0] : p[1];
+
+	stream->fp = fdopen(encrypt ? p[1] : p[0], encrypt ? "w" : "r");
+	if (stream->fp == NULL) {
+		stream->error = "unable to open the pipe";
+		close(p[0]);
+		close(p[1]);
+		return (false);
+	}
+
+	/*
+	 * The side that writes to the pipe has SIGPIPE blocked, the other
+	 * failing early is reported when the stream is closed. The thread
+	 * inherits the mask, the main thread keeps it blocked only while
+	 * writing the plain-text (until native_encrypt_close()).
+	 */
+	sigpipe_block(&stream->sigmask);
+
+	if (pthread_create(&stream->thread, NULL, main, stream) != 0) {
+		sigpipe_restore(&stream->sigmask);
+		stream->error = "unable to start a thread";
+		fclose(stream->fp);
+		close(stream->pipe_fd);
+		return (false);
+	}
+
+	if (!encrypt)
+		sigpipe_restore(&stream->sigmask);
+
+	return (true);
+}
+
+
+/*
+ * Create a new header of the given type, derive the file key from it and
+ * write it. The salt is random unless one is given.
+ */
+bool
+native_header_new(struct native_stream *stream, uint8_t type,
+    const uint8_t *salt)
+{
+	uint8_t *header = stream->header;
+
+	native_need_key(true);
+
+	stream->chunk_length = NATIVE_CHUNK_LENGTH;
+	stream->index = 0;
+
+	memset(header, 0, NATIVE_HEADER_LENGTH);
+	memcpy(header, NATIVE_MAGIC, NATIVE_MAGIC_LENGTH);
+	header[8] = 1;
+	header[9] = 1;
+	header[10] = type;
+	store32_le(header + 12, stream->chunk_length);
+	arc4random_buf(header + 16, NATIVE_SALT_LENGTH + NATIVE_PREFIX_LENGTH);
+	if (salt != NULL)
+		memcpy(header + 16, salt, NATIVE_SALT_LENGTH);
+
+	hkdf_sha256(stream->key, sizeof(stream->key), key_file_data,
+	    key_file_length, header + 16, NATIVE_SALT_LENGTH, NATIVE_INFO);
+
+	if (!write_full(stream->fd, header, NATIVE_HEADER_LENGTH)) {
+		stream->error = "unable to write the cipher-text";
+		return (false);
+	}
+
+	return (true);
+}
+
+
+/*
+ * Read and check the header, derive the file key from it. The key file must
+ * have been read already (see native_decrypt_open()).
+ */
+bool
+native_header_read(struct native_stream *stream)
+{
+	uint8_t *header = stream->header;
+
+	if (key_file_length == 0) {
+		stream->error = "the key file was not read";
+		return (false);
+	}
+
+	if (read_full(stream->fd, header, NATIVE_HEADER_LENGTH) !=
+	    NATIVE_HEADER_LENGTH ||
+	    memcmp(header, NATIVE_MAGIC, NATIVE_MAGIC_LENGTH) != 0) {
+		stream->error = "not a native mdp file";
+		return (false);
+	}
+
+	stream->chunk_length = load32_le(header + 12);
+	stream->index = 0;
+	if (header[8] != 1 || header[9] != 1 || header[10] > NATIVE_TYPE_INDEX ||
+	    header[11] != 0 || stream->chunk_length == 0 ||
+	    stream->chunk_length > NATIVE_CHUNK_MAX) {
+		stream->error = "unsupported native format";
+		return (false);
+	}
+
+	hkdf_sha256(stream->key, sizeof(stream->key), key_file_data,
+	    key_file_length, header + 16, NATIVE_SALT_LENGTH, NATIVE_INFO);
+
+	return (true);
+}
+
+
+/*
+ * Read and verify the next chunk in buf (chunk_length bytes). Returns its
+ * length or -1 on error, final is set on the last one.
+ */
+ssize_t
+native_chunk_read(struct native_stream *stream, uint8_t *buf, bool *final)
+{
+	uint8_t nonce[AEAD_NONCE_LENGTH], ad[NATIVE_AD_LENGTH];
+	uint8_t length[4], tag[AEAD_TAG_LENGTH];
+	uint32_t len;
+
+	if (read_full(stream->fd, length, sizeof(length)) != sizeof(length)) {
+		stream->error = "truncated file";
+		return (-1);
+	}
+
+	len = load32_le(length) & ~NATIVE_FINAL;
+	*final = (load32_le(length) & NATIVE_FINAL) != 0;
+	if (len > stream->chunk_length) {
+		stream->error = "invalid chunk length";
+		return (-1);
+	}
+
+	if (read_full(stream->fd, buf, len) != (ssize_t)len ||
+	    read_full(stream->fd, tag, sizeof(tag)) != sizeof(tag)) {
+		stream->error = "truncated file";
+		return (-1);
+	}
+
+	native_chunk_params(stream, length, nonce, ad);
+	if (!aead_open(buf, tag, buf, len, ad, sizeof(ad), nonce,
+	    stream->key)) {
+		stream->error = "authentication failed (wrong key or "
+		    "corrupted file)";
+		return (-1);
+	}
+
+	/* Nothing is expected after the last chunk. */
+	if (*final && read_full(stream->fd, length, 1) != 0) {
+		stream->error = "trailing data after the last chunk";
+		return (-1);
+	}
+
+	return (len);
+}
+
+
+/*
+ * Seal the plain-text in buf (destroyed) as the next chunk and write it.
+ */
+bool
+native_chunk_write(struct native_stream *stream, uint8_t *buf, size_t len,
+    bool final)
+{
+	uint8_t nonce[AEAD_NONCE_LENGTH], ad[NATIVE_AD_LENGTH];
+	uint8_t length[4], tag[AEAD_TAG_LENGTH];
+
+	store32_le(length, len | (final ? NATIVE_FINAL : 0));
+
+	native_chunk_params(stream, length, nonce, ad);
+	aead_seal(buf, tag, buf, len, ad, sizeof(ad), nonce, stream->key);
+
+	if (!write_full(stream->fd, length, sizeof(length)) ||
+	    !write_full(stream->fd, buf, len) ||
+	    !write_full(stream->fd, tag, sizeof(tag))) {
+		stream->error = "unable to write the cipher-text";
+		return (false);
+	}
+
+	return (true);
+}
+
+
+/*
+ * Ensure gpg can be used to read the key file and the key file exists
+ * (creating it) and can be read, the native equivalent of gpg_check().
+ */
+void
+native_check(void)
+{
+	gpg_backend.check();
+
+	if (file_exists(cfg_key_file))
+		config_check_password_file(cfg_key_file);
+
+	native_need_key(true);
+}
+
+
+/*
+ * Returns true if the given file is in the native format.
+ */
+bool
+native_is_file(const char *path)
+{
+	char magic[NATIVE_MAGIC_LENGTH];
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return (false);
+
+	len = read_full(fd, magic, sizeof(magic));
+	close(fd);
+
+	return (len == sizeof(magic) &&
+	    memcmp(magic, NATIVE_MAGIC, sizeof(magic)) == 0);
+}
+
+
+/*
+ * Decryption thread, from the file to the pipe.
+ */
+static void *
+native_decrypt_main(void *arg)
+{
+	struct native_stream *stream = arg;
+	uint8_t *buf;
+	ssize_t len;
+	bool final = false;
+
+	buf = xmalloc(stream->chunk_length);
+
+	while (!final) {
+		len = native_chunk_read(stream, buf, &final);
+		if (len == -1)
+			break;
+
+		if (!write_full(stream->pipe_fd, buf, len)) {
+			stream->error = "unable to write the plain-text";
+			break;
+		}
+	}
+
+	memset(buf, 0, stream->chunk_length);
+	xfree(buf);
+
+	close(stream->pipe_fd);
+	close(stream->fd);
+
+	return (NULL);
+}
+
+
+/*
+ * Start decrypting a file for gpg_decrypt_all(), the plain-text is read from
+ * the fp of the stream and native_decrypt_close() reports whether the whole
+ * file was authentic. An index is read through the blocks it lists (see
+ * container.c).
+ */
+bool
+native_decrypt_open(struct gpg_plain *file)
+{
+	struct native_stream *stream;
+	int fd;
+	char *error;
+	bool started;
+
+	debug("native_decrypt_open %s", file->path);
+
+	if (!native_load_key(false, &error)) {
+		gpg_plain_fail(file, "%s", error);
+		xfree(error);
+		return (false);
+	}
+
+	fd = open(file->path, O_RDONLY);
+	if (fd == -1) {
+		gpg_plain_fail(file, "%s: %s", file->path, strerror(errno));
+		return (false);
+	}
+
+	stream = native_stream_new(fd, file->path);
+	if (!native_header_read(stream)) {
+		started = false;
+	} else if (stream->header[10] == NATIVE_TYPE_INDEX) {
+		started = native_stream_start(stream, container_decrypt_main,
+		    false);
+	} else {
+		started = native_stream_start(stream, native_decrypt_main,
+		    false);
+	}
+
+	if (!started) {
+		gpg_plain_fail(file, "%s: %s", file->path, stream->error);
+		close(fd);
+		native_stream_free(stream);
+		return (false);
+	}
+
+	file->handle = stream;
+	file->fd = fileno(stream->fp);
+
+	return (true);
+}
+
+
+/*
+ * Close a stream opened with native_decrypt_open(), its return code is 0 if
+ * the whole file was decrypted successfully.
+ */
+void
+native_decrypt_close(struct gpg_plain *file)
+{
+	struct native_stream *stream = file->handle;
+
+	debug("native_decrypt_close");
+
+	fclose(stream->fp);
+
+	if (pthread_join(stream->thread, NULL) != 0)
+		errx(EXIT_FAILURE, "native_decrypt_close pthread_join");
+
+	if (stream->error != NULL)
+		gpg_plain_fail(file, "%s: %s", file->path, stream->error);
+	file->retcode = native_stream_free(stream);
+	file->handle = NULL;
+}
+
+
+/*
+ * Encryption thread, from the pipe to the file. A chunk shorter than the
+ * chunk length (possibly empty) is the last one.
+ */
+static void *
+native_encrypt_main(void *arg)
+{
+	struct native_stream *stream = arg;
+	uint8_t *buf;
+	ssize_t len;
+	bool final = false;
+
+	buf = xmalloc(stream->chunk_length);
+
+	while (!final) {
+		len = read_full(stream->pipe_fd, buf, stream->chunk_length);
+		if (len == -1) {
+			stream->error = "unable to read the plain-text";
+			break;
+		}
+
+		final = (size_t)len < stream->chunk_length;
+		if (!native_chunk_write(stream, buf, len, final))
+			break;
+	}
+
+	memset(buf, 0, stream->chunk_length);
+	xfree(buf);
+
+	close(stream->pipe_fd);
+
+	return (NULL);
+}
+
+
+/*
+ * Start encrypting to the given file descriptor, the plain-text is written to
+ * the returned stream. The descriptor is left open.
+ */
+static FILE *
+native_encrypt_open(int fd, const char *target, void **handle)
+{
+	struct native_stream *stream;
+
+	(void)(target);
+
+	debug("native_encrypt_open");
+
+	stream = native_stream_new(fd, NULL);
+	if (!native_header_new(stream, NATIVE_TYPE_DATA, NULL) ||
+	    !native_stream_start(stream, native_encrypt_main, true))
+		errx(EXIT_FAILURE, "native backend: %s", stream->error);
+
+	*handle = stream;
+
+	return (stream->fp);
+}
+
+
+/*
+ * Flush the plain-text and wait for the last chunk to be written. Returns
+ * true if everything was written.
+ */
+bool
+native_encrypt_close(FILE *fp, void *handle)
+{
+	struct native_stream *stream = handle;
+	int write_error;
+
+	debug("native_encrypt_close");
+
+	write_error = fclose(fp);
+	sigpipe_restore(&stream->sigmask);
+
+	if (pthread_join(stream->thread, NULL) != 0)
+		errx(EXIT_FAILURE, "native_encrypt_close pthread_join");
+
+	if (write_error != 0 && stream->error == NULL)
+		stream->error = "unable to write the plain-text";
+
+	if (stream->error != NULL)
+		warnx("native backend: %s", stream->error);
+
+	return (native_stream_free(stream) == 0);
+}
+
+
+const struct backend_ops native_backend = {
+	"native backend",
+	native_check,
+	native_is_file,
+	native_decrypt_open,
+	native_decrypt_close,
+	NULL,
+	native_encrypt_open,
+	native_encrypt_close,
+	NULL,
+};
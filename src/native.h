@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _NATIVE_H_
+#define _NATIVE_H_
+
+#include <sys/types.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aead.h"
+#include "gpg.h"
+
+#define NATIVE_MAGIC		"mdpaead1"
+#define NATIVE_MAGIC_LENGTH	8
+#define NATIVE_HEADER_LENGTH	64
+#define NATIVE_SALT_LENGTH	32
+#define NATIVE_PREFIX_LENGTH	16
+#define NATIVE_CHUNK_LENGTH	65536
+#define NATIVE_CHUNK_MAX	(1 << 24)
+#define NATIVE_FINAL		0x80000000U
+
+#define NATIVE_TYPE_DATA	0
+#define NATIVE_TYPE_INDEX	1
+
+/*
+ * A file being encrypted or decrypted, usually by a thread. The plain-text
+ * goes through a pipe, fp is the caller's side of it.
+ */
+struct native_stream {
+	FILE		*fp;
+	char		*path;
+	int		 fd;
+	int		 pipe_fd;
+	pthread_t	 thread;
+	uint8_t		 header[NATIVE_HEADER_LENGTH];
+	uint8_t		 key[AEAD_KEY_LENGTH];
+	uint32_t	 chunk_length;
+	uint64_t	 index;
+	const char	*error;
+	sigset_t	 sigmask;
+};
+
+void		 native_derive(uint8_t *, size_t, const uint8_t *, size_t,
+		     const char *);
+struct native_stream *native_stream_new(int, const char *);
+int		 native_stream_free(struct native_stream *);
+bool		 native_stream_start(struct native_stream *, void *(*)(void *),
+		     bool);
+bool		 native_header_new(struct native_stream *, uint8_t,
+		     const uint8_t *);
+bool		 native_header_read(struct native_stream *);
+ssize_t		 native_chunk_read(struct native_stream *, uint8_t *, bool *);
+bool		 native_chunk_write(struct native_stream *, uint8_t *, size_t,
+		     bool);
+void		 native_check(void);
+bool		 native_is_file(const char *);
+bool		 native_decrypt_open(struct gpg_plain *);
+void		 native_decrypt_close(struct gpg_plain *);
+bool		 native_encrypt_close(FILE *, void *);
+
+#endif /* _NATIVE_H_ */
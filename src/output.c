@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Machine-readable output for the get command.
+ *
+ * Every result is appended to a single buffer, converted to multibyte on the
+ * way in, and the buffer is written to stdout in one go when it fills up or
+ * when output_flush() is called. The buffer is wiped after each write since
+ * it holds passwords, and when it grows.
+ *
+ * JSON is always plain ASCII: anything else is escaped (\uXXXX, surrogate
+ * pairs past the BMP) so the output is valid UTF-8 whatever the locale.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <wchar.h>
+#include <err.h>
+
+#include "cmd.h"
+#include "output.h"
+#include "results.h"
+#include "xmalloc.h"
+
+
+/* Flush to stdout past this many bytes. */
+#define OUTPUT_BUFFER_SIZE	65536
+
+/* Characters separating the fields of a line. */
+#define FIELD_SEPARATORS	L" \t"
+
+
+struct field {
+	const wchar_t	*start;
+	size_t		 len;
+};
+
+static char	*buffer = NULL;
+static size_t	 buffer_len = 0;
+static size_t	 buffer_size = 0;
+
+/* Fields of the current line, grown as needed. */
+static struct field *fields = NULL;
+static size_t	 fields_size = 0;
+
+
+enum output_format
+output_format_parse(const char *name)
+{
+	if (strcmp(name, "lines") == 0)
+		return (OUTPUT_LINES);
+	if (strcmp(name, "nul") == 0)
+		return (OUTPUT_NUL);
+	if (strcmp(name, "tsv") == 0)
+		return (OUTPUT_TSV);
+	if (strcmp(name, "json") == 0)
+		return (OUTPUT_JSON);
+
+	errx(EXIT_FAILURE, "unknown output format: %s", name);
+}
+
+
+/*
+ * Make room for at least len more bytes in the buffer. It is never realloc'd
+ * to avoid leaving copies of the passwords around: a bigger one is allocated
+ * and the previous one wiped.
+ */
+static void
+reserve(size_t len)
+{
+	size_t size = buffer_size;
+	char *bigger;
+
+	if (buffer_len + len <= buffer_size)
+		return;
+
+	while (buffer_len + len > size)
+		size = size ? size * 2 : OUTPUT_BUFFER_SIZE;
+
+	bigger = xmalloc(size);
+	if (buffer != NULL) {
+		memcpy(bigger, buffer, buffer_len);
+		memset(buffer, 0, buffer_size);
+		xfree(buffer);
+	}
+	buffer = bigger;
+	buffer_size = size;
+}
+
+
+static void
+append_bytes(const char *s, size_t len)
+{
+	reserve(len);
+	memcpy(buffer + buffer_len, s, len);
+	buffer_len += len;
+}
+
+
+static void
+append_char(char c)
+{
+	reserve(1);
+	buffer[buffer_len++] = c;
+}
+
+
+/*
+ * Append a character as a JSON escape, as a surrogate pair past the BMP.
+ */
+static void
+append_json_escape(wchar_t wc)
+{
+	unsigned long c = (unsigned long)wc;
+	char esc[32];
+
+#ifndef __STDC_ISO_10646__
+	/* wchar_t is only known to hold the code point with this macro. */
+	if (c > 0x7f)
+		errx(EXIT_FAILURE, "unable to output non-ASCII characters as "
+				"JSON on this system");
+#endif
+
+	if (c > 0xffff) {
+		c -= 0x10000;
+		snprintf(esc, sizeof(esc), "\\u%04lx\\u%04lx",
+				0xd800 + (c >> 10), 0xdc00 + (c & 0x3ff));
+	} else {
+		snprintf(esc, sizeof(esc), "\\u%04lx", c);
+	}
+	append_bytes(esc, strlen(esc));
+}
+
+
+/*
+ * Append len wide characters to the buffer, converting them to the current
+ * locale's multibyte encoding. When json is set, quotes and backslashes are
+ * escaped, control and non-ASCII characters are written as \uXXXX.
+ */
+static void
+append_wcs(const wchar_t *s, size_t len, bool json)
+{
+	mbstate_t ps;
+	size_t n;
+
+	memset(&ps, 0, sizeof(ps));
+
+	for (size_t i = 0; i < len; i++) {
+		if (json && (s[i] == L'"' || s[i] == L'\\')) {
+			append_char('\\');
+		} else if (json && (s[i] < 0x20 || s[i] > 0x7e)) {
+			append_json_escape(s[i]);
+			continue;
+		}
+
+		reserve(MB_LEN_MAX);
+		n = wcrtomb(buffer + buffer_len, s[i], &ps);
+		if (n == (size_t)-1)
+			errx(EXIT_FAILURE, "unable to convert a result with "
+					"the current locale");
+		buffer_len += n;
+	}
+}
+
+
+/*
+ * Split the line on blanks into fields, returns the number of fields found.
+ * There is no limit on their number, -f -1 is the last one of any line.
+ */
+static unsigned int
+split_fields(const wchar_t *s)
+{
+	unsigned int count = 0;
+	size_t len;
+
+	/* Always at least one, select_field() may return an empty field. */
+	if (fields == NULL) {
+		fields_size = 16;
+		fields = xcalloc(fields_size, sizeof(struct field));
+	}
+
+	while (*s != L'\0') {
+		s += wcsspn(s, FIELD_SEPARATORS);
+		if (*s == L'\0')
+			break;
+		if (count == fields_size) {
+			fields_size *= 2;
+			fields = xrealloc(fields, fields_size,
+					sizeof(struct field));
+		}
+		len = wcscspn(s, FIELD_SEPARATORS);
+		fields[count].start = s;
+		fields[count].len = len;
+		count++;
+		s += len;
+	}
+
+	return (count);
+}
+
+
+/*
+ * Reduce the fields to the one selected with -f, counting from 1 or from
+ * the end if negative. A line without such field yields an empty one.
+ */
+static unsigned int
+select_field(unsigned int count)
+{
+	int index = cmd_output_field;
+
+	if (index < 0)
+		index += count;
+	else
+		index -= 1;
+
+	if (index < 0 || index >= (int)count) {
+		fields[0].start = L"";
+		fields[0].len = 0;
+	} else {
+		fields[0] = fields[index];
+	}
+
+	return (1);
+}
+
+
+/*
+ * Append a single result to the output buffer. A non-zero query_id is
+ * printed along with the result (batch mode).
+ */
+void
+output_result(unsigned int query_id, struct result *result)
+{
+	struct field line, *list = &line;
+	unsigned int count = 0;
+	char id[16];
+
+	if (cmd_output_format == OUTPUT_TSV ||
+			cmd_output_format == OUTPUT_JSON ||
+			cmd_output_field != 0) {
+		count = split_fields(result->wcs_value);
+		if (cmd_output_field != 0)
+			count = select_field(count);
+		list = fields;
+	} else {
+		line.start = result->wcs_value;
+		line.len = result->wcs_len;
+		count = 1;
+	}
+
+	if (cmd_output_format == OUTPUT_JSON) {
+		append_char('{');
+		if (query_id > 0) {
+			snprintf(id, sizeof(id), "%u", query_id);
+			append_bytes("\"query\":", 8);
+			append_bytes(id, strlen(id));
+			append_char(',');
+		}
+		append_bytes("\"fields\":[", 10);
+		for (unsigned int i = 0; i < count; i++) {
+			if (i > 0)
+				append_char(',');
+			append_char('"');
+			append_wcs(list[i].start, list[i].len, true);
+			append_char('"');
+		}
+		append_bytes("]}\n", 3);
+	} else {
+		if (query_id > 0) {
+			snprintf(id, sizeof(id), "%u\t", query_id);
+			append_bytes(id, strlen(id));
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			if (i > 0)
+				append_char('\t');
+			append_wcs(list[i].start, list[i].len, false);
+		}
+		append_char(cmd_output_format == OUTPUT_NUL ? '\0' : '\n');
+	}
+
+	if (buffer_len >= OUTPUT_BUFFER_SIZE)
+		output_flush();
+}
+
+
+/*
+ * Write the buffer to stdout and wipe it.
+ */
+void
+output_flush(void)
+{
+	if (buffer_len == 0)
+		return;
+
+	if (fwrite(buffer, 1, buffer_len, stdout) != buffer_len)
+		err(EXIT_FAILURE, "output_flush");
+	fflush(stdout);
+
+	memset(buffer, 0, buffer_len);
+	buffer_len = 0;
+}
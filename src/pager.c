@@ -19,34 +19,76 @@
  */
 
 #include <curses.h>
+#include <err.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "keywords.h"
 #include "pager.h"
 #include "results.h"
 #include "ui-curses.h"
+#include "xmalloc.h"
 
 
 #define RESULTS_MAX_LEN 128
-#define MSG_TOO_MANY "Too many results, please refine your search."
+
+static const char msg_too_many[] =
+	"Too many results, please refine your search.";
+static const char msg_keywords[] = "Keywords: ";
+
+/* Offset used for the rows taken by the wrapped part of a long line. */
+#define ROW_WRAPPED UINT_MAX
 
 
 /*
- * Display all the results.
- *
- * This function assumes curses is initialized.
+ * Content of a single row of the screen: nothing, the start of a result (or
+ * its wrapped part), a message or the keyword prompt.
+ */
+struct row {
+	const void	*content;
+	unsigned int	 offset;
+	bool		 dirty;
+};
+
+/*
+ * What is currently on screen and what should be on screen after the next
+ * refresh. Only the rows that differ between the two are repainted.
+ */
+static struct row *rows_drawn = NULL;
+static struct row *rows_wanted = NULL;
+
+
+/*
+ * Mark a row as holding the given content (ignored if off-screen).
  */
 static void
-refresh_listing(void)
+set_row(unsigned int y, const void *content, unsigned int offset)
+{
+	if (y >= window_height)
+		return;
+
+	rows_wanted[y].content = content;
+	rows_wanted[y].offset = offset;
+}
+
+
+/*
+ * Compute what each row of the screen should contain.
+ */
+static void
+layout_listing(void)
 {
-	int top_offset, left_offset;
+	unsigned int top_offset, left_offset, span;
 	unsigned int len = results_visible_length();
 	struct result *result;
 
+	memset(rows_wanted, 0, window_height * sizeof(struct row));
+
 	if (len >= window_height || len >= RESULTS_MAX_LEN) {
-		wmove(screen, window_height / 2,
-				(window_width - sizeof(MSG_TOO_MANY) - 1) / 2);
-		waddstr(screen, MSG_TOO_MANY);
-		refresh();
+		set_row(window_height / 2, msg_too_many,
+				(window_width - sizeof(msg_too_many) - 1) / 2);
 		return;
 	}
 
@@ -59,7 +101,7 @@ refresh_listing(void)
 
 	/*
 	 * Place the lines on screen. Since curses will automatically wrap
-	 * longer lines, we need to force a new-line on lines following them.
+	 * longer lines, the rows following them are reserved.
 	 */
 	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
 		result = ARRAY_ITEM(&results, i);
@@ -67,17 +109,91 @@ refresh_listing(void)
 		if (!result->visible)
 			continue;
 
-		wmove(screen, top_offset, left_offset);
-		waddstr(screen, result->mbs_value);
+		set_row(top_offset, result, left_offset);
 
 		if (result->wcs_len > window_width) {
-			top_offset += (result->wcs_len / window_width);
+			span = result->wcs_len / window_width;
+			while (span-- > 0) {
+				set_row(++top_offset, result, ROW_WRAPPED);
+			}
 		}
 
 		top_offset++;
 	}
+}
+
+
+/*
+ * Draw the content of a row starting at its offset.
+ */
+static void
+draw_row(unsigned int y, const struct row *row)
+{
+	const struct result *result;
+
+	if (row->content == msg_too_many) {
+		mvwaddnstr(screen, y, row->offset, msg_too_many,
+				sizeof(msg_too_many) - 1);
+		return;
+	}
+
+	result = row->content;
+	mvwaddnwstr(screen, y, row->offset, result->wcs_value,
+			result->wcs_len);
+}
+
+
+/*
+ * Display all the results.
+ *
+ * The rows that changed since the last refresh are cleared, then every line
+ * touching one of those rows is drawn again (a long line wraps on the rows
+ * below its start). Everything else is left as-is on screen and curses only
+ * sends the difference to the terminal. This function assumes curses is
+ * initialized.
+ */
+static void
+refresh_listing(void)
+{
+	struct row *row;
+	bool redraw = false;
+
+	layout_listing();
+
+	for (unsigned int y = 0; y < window_height; y++) {
+		row = &rows_wanted[y];
+		row->dirty = row->content != rows_drawn[y].content ||
+			row->offset != rows_drawn[y].offset;
+
+		if (row->dirty) {
+			wmove(screen, y, 0);
+			wclrtoeol(screen);
+		}
+	}
+
+	/* Bottom-up, the wrapped rows are seen before the start of a line. */
+	for (unsigned int y = window_height; y-- > 0;) {
+		row = &rows_wanted[y];
+
+		if (row->content == NULL) {
+			redraw = false;
+			continue;
+		}
+
+		redraw |= row->dirty;
+
+		if (row->offset == ROW_WRAPPED)
+			continue;
+
+		if (redraw) {
+			draw_row(y, row);
+		}
+		redraw = false;
+	}
+
+	memcpy(rows_drawn, rows_wanted, window_height * sizeof(struct row));
 
-	refresh();
+	update_screen();
 }
 
 
@@ -91,17 +207,47 @@ keyword_prompt(void)
 
 	curs_set(1);
 
-	wmove(screen, window_height - 1, 0);
-	waddstr(screen, "Keywords: ");
+	mvwaddnstr(screen, window_height - 1, 0, msg_keywords,
+			sizeof(msg_keywords) - 1);
+	wclrtoeol(screen);
+
+	/* The prompt row needs to be cleared on the next refresh. */
+	rows_drawn[window_height - 1].content = msg_keywords;
+	rows_drawn[window_height - 1].offset = 0;
 
-	refresh();
+	update_screen();
 	echo();
 	getnstr(kw, 50);
+	noecho();
+	curs_set(0);
 
 	keywords_load_from_char(kw);
 }
 
 
+/*
+ * The results might still be loading in the background while the first
+ * keywords are typed, wait for them. Errors are reported once the screen is
+ * restored.
+ */
+static void
+wait_for_results(void)
+{
+	int length;
+
+	length = load_results_gpg_wait();
+	if (length > 0)
+		return;
+
+	shutdown_curses();
+
+	if (length < 0)
+		errx(EXIT_FAILURE, "%s", load_results_error());
+
+	errx(EXIT_FAILURE, "no passwords");
+}
+
+
 /*
  * Take a finite amount of results and show them full-screen.
  *
@@ -113,12 +259,14 @@ _pager(bool start_with_prompt)
 {
 	init_curses();
 
-	for (;;) {
-		clear();
+	rows_drawn = xcalloc(window_height, sizeof(struct row));
+	rows_wanted = xcalloc(window_height, sizeof(struct row));
 
+	for (;;) {
 		if (start_with_prompt) {
 			start_with_prompt = false;
 			keyword_prompt();
+			wait_for_results();
 			filter_results();
 			continue;
 		}
@@ -135,5 +283,8 @@ _pager(bool start_with_prompt)
 		break;
 	}
 
+	xfree(rows_wanted);
+	xfree(rows_drawn);
+
 	shutdown_curses();
 }
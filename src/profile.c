@@ -17,6 +17,8 @@
  * All the profile related variables and functions.
  */
 
+#include <limits.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <err.h>
@@ -27,6 +29,8 @@
 #include "randpass.h"
 #include "results.h"
 #include "str.h"
+#include "utils.h"
+#include "wordlist.h"
 #include "xmalloc.h"
 #include "wcsdup.h"
 
@@ -53,10 +57,235 @@ profile_new(const char *name)
 		new->character_set = wcsdup(CHARSET_ALPHANUMERIC);
 	}
 
+	if (cfg_excluded_characters != NULL) {
+		new->excluded_characters = wcsdup(cfg_excluded_characters);
+	}
+	new->minimum[RANDPASS_LOWERCASE] = cfg_minimum_lowercase;
+	new->minimum[RANDPASS_UPPERCASE] = cfg_minimum_uppercase;
+	new->minimum[RANDPASS_DIGITS] = cfg_minimum_digits;
+	new->minimum[RANDPASS_SYMBOLS] = cfg_minimum_symbols;
+
+	new->word_count = cfg_word_count;
+	if (cfg_word_list != NULL) {
+		new->word_list = strdup(cfg_word_list);
+	}
+	if (cfg_syllable_set != NULL) {
+		new->syllable_set = strdup(cfg_syllable_set);
+	}
+	if (cfg_word_separator != NULL) {
+		new->word_separator = strdup(cfg_word_separator);
+	}
+
 	return (new);
 }
 
 
+/*
+ * Whether the profile makes passphrases (from a word list or syllable set)
+ * rather than passwords from a character set.
+ */
+static bool
+profile_is_passphrase(struct profile *profile)
+{
+	return (profile->word_list != NULL || profile->syllable_set != NULL);
+}
+
+
+/*
+ * Prepare the character set of the profile: drop the excluded characters and
+ * sort the rest by class if the profile has minimums.
+ */
+static void
+profile_load_character_set(struct profile *profile)
+{
+	static const char *class_names[RANDPASS_CLASS_COUNT] = {
+		"lowercase", "uppercase", "digits", "symbols"
+	};
+	wchar_t *set;
+	size_t len = 0;
+	bool has_minimum = false;
+
+	set = xcalloc(wcslen(profile->character_set) + 1, sizeof(wchar_t));
+	for (wchar_t *c = profile->character_set; *c != L'\0'; c++) {
+		if (profile->excluded_characters == NULL ||
+				wcschr(profile->excluded_characters, *c) == NULL) {
+			set[len++] = *c;
+		}
+	}
+
+	if (len == 0) {
+		errx(EXIT_FAILURE, "failed to generate password");
+	}
+
+	profile->tokens = wordlist_from_wcs(set);
+	if (profile->tokens == NULL) {
+		errx(EXIT_FAILURE, "unable to use generated password "
+				"(wrong locale?)");
+	}
+
+	for (int i = 0; i < RANDPASS_CLASS_COUNT; i++) {
+		if (profile->minimum[i] > 0) {
+			has_minimum = true;
+		}
+	}
+
+	if (has_minimum) {
+		profile->policy = randpass_policy_new(set, profile->minimum);
+		for (int i = 0; i < RANDPASS_CLASS_COUNT; i++) {
+			if (profile->minimum[i] > 0 &&
+					profile->policy->member_count[i] == 0) {
+				errx(EXIT_FAILURE, "minimum_%s: no %s in "
+						"character_set", class_names[i],
+						class_names[i]);
+			}
+		}
+	}
+
+	xfree(set);
+}
+
+
+/*
+ * Return the tokens passwords are made of, loaded on first use.
+ */
+static struct wordlist *
+profile_get_tokens(struct profile *profile)
+{
+	if (profile->tokens != NULL) {
+		return (profile->tokens);
+	}
+
+	if (profile->word_list != NULL) {
+		profile->tokens = wordlist_open(profile->word_list);
+	} else if (profile->syllable_set != NULL) {
+		profile->tokens = wordlist_from_syllables(
+				profile->syllable_set);
+		if (profile->tokens == NULL) {
+			errx(EXIT_FAILURE, "empty syllable_set");
+		}
+	} else {
+		profile_load_character_set(profile);
+	}
+
+	return (profile->tokens);
+}
+
+
+/*
+ * Number of characters, words or syllables per password. A count specified
+ * on the command line takes precedence.
+ */
+static unsigned int
+profile_get_token_count(struct profile *profile)
+{
+	if (cmd_character_count > 0) {
+		return (cmd_character_count);
+	} else if (profile_is_passphrase(profile)) {
+		return (profile->word_count);
+	} else {
+		return (profile->character_count);
+	}
+}
+
+
+/*
+ * Number of tokens per password, checked against the limits and the minimums
+ * of the profile.
+ */
+static unsigned int
+profile_get_checked_token_count(struct profile *profile)
+{
+	unsigned int count = profile_get_token_count(profile);
+
+	if (count < 1 || count > MAX_PASSWORD_LENGTH) {
+		errx(EXIT_FAILURE, "failed to generate password");
+	}
+
+	profile_get_tokens(profile);
+	if (profile->policy != NULL && profile->policy->required > count) {
+		errx(EXIT_FAILURE, "the character class minimums exceed the "
+				"password length");
+	}
+
+	return (count);
+}
+
+
+/*
+ * Words are separated by a space by default, syllables and characters by
+ * nothing.
+ */
+static const char *
+profile_get_separator(struct profile *profile)
+{
+	if (profile->word_separator != NULL) {
+		return (profile->word_separator);
+	} else if (profile->word_list != NULL) {
+		return (" ");
+	} else {
+		return ("");
+	}
+}
+
+
+/*
+ * Number of distinct tokens in a class of the policy, the character set may
+ * repeat some.
+ */
+static uint32_t
+profile_class_distinct(struct wordlist *tokens, struct randpass_policy *policy,
+		int class)
+{
+	const char *a, *b;
+	size_t alen, blen;
+	uint32_t distinct = policy->member_count[class];
+
+	for (uint32_t i = 1; i < policy->member_count[class]; i++) {
+		a = wordlist_get(tokens, policy->members[class][i], &alen);
+		for (uint32_t j = 0; j < i; j++) {
+			b = wordlist_get(tokens, policy->members[class][j],
+					&blen);
+			if (alen == blen && memcmp(a, b, alen) == 0) {
+				distinct--;
+				break;
+			}
+		}
+	}
+
+	return (distinct);
+}
+
+
+/*
+ * Bits of entropy of a password generated with this profile. A character
+ * forced by a minimum only counts for the members of its class, the
+ * positions it is shuffled to are not counted.
+ */
+double
+profile_entropy(struct profile *profile)
+{
+	struct wordlist *tokens = profile_get_tokens(profile);
+	struct randpass_policy *policy = profile->policy;
+	unsigned int count = profile_get_token_count(profile);
+	uint32_t distinct;
+	double bits = 0;
+
+	if (policy == NULL || policy->required > count) {
+		return (wordlist_entropy(tokens, count));
+	}
+
+	for (int c = 0; c < RANDPASS_CLASS_COUNT; c++) {
+		if (policy->minimum[c] == 0) {
+			continue;
+		}
+		distinct = profile_class_distinct(tokens, policy, c);
+		bits += policy->minimum[c] * log2_approx(distinct);
+	}
+
+	return (bits + wordlist_entropy(tokens, count - policy->required));
+}
+
+
 /*
  * Return a profile from the global profile list.
  *
@@ -127,20 +356,180 @@ profile_passwords_to_results(struct profile *profile, wchar_t *prefix)
 }
 
 
+/*
+ * State shared by the threads printing passwords: the tokens (already in the
+ * locale's encoding) and the stream, written to in whole buffers under the
+ * lock.
+ */
+struct profile_printer {
+	FILE		*stream;
+	pthread_mutex_t	 lock;
+	struct wordlist	*tokens;
+	struct randpass_policy *policy;
+	const char	*separator;
+	size_t		 separator_length;
+	int		 count;
+	size_t		 buffer_size;
+};
+
+struct profile_job {
+	struct profile_printer	*printer;
+	unsigned int		 count;
+	pthread_t		 thread;
+};
+
+
+/*
+ * Write count random tokens separated by separator to buf, return the number
+ * of bytes written (at most count * (max_length + separator_length)).
+ */
+static size_t
+profile_write_tokens(char *buf, struct randpass_rng *rng,
+		struct wordlist *tokens, struct randpass_policy *policy,
+		int count, const char *separator, size_t separator_length)
+{
+	uint32_t indexes[MAX_PASSWORD_LENGTH];
+	const char *token;
+	size_t used = 0, len;
+
+	if (generate_indexes_with_policy(rng, indexes, count, tokens->count,
+			policy) != 0) {
+		errx(EXIT_FAILURE, "failed to generate password");
+	}
+
+	for (int i = 0; i < count; i++) {
+		if (i > 0) {
+			memcpy(buf + used, separator, separator_length);
+			used += separator_length;
+		}
+		token = wordlist_get(tokens, indexes[i], &len);
+		memcpy(buf + used, token, len);
+		used += len;
+	}
+
+	memset(indexes, 0, sizeof(indexes));
+
+	return (used);
+}
+
+
+static void
+profile_printer_flush(struct profile_printer *printer, char *buf, size_t len)
+{
+	pthread_mutex_lock(&printer->lock);
+	fwrite(buf, 1, len, printer->stream);
+	pthread_mutex_unlock(&printer->lock);
+}
+
+
+/*
+ * Generate job->count passwords from a private random stream, one line each,
+ * in chunks of printer->buffer_size bytes.
+ */
+static void *
+profile_job_main(void *arg)
+{
+	struct profile_job *job = arg;
+	struct profile_printer *printer = job->printer;
+	struct randpass_rng rng;
+	size_t used = 0, line_max;
+	char *buf;
+
+	line_max = printer->count * (printer->tokens->max_length +
+			printer->separator_length) + 1;
+	buf = xmalloc(printer->buffer_size);
+	randpass_rng_init(&rng);
+
+	for (unsigned int i = 0; i < job->count; i++) {
+		if (used + line_max > printer->buffer_size) {
+			profile_printer_flush(printer, buf, used);
+			used = 0;
+		}
+
+		used += profile_write_tokens(buf + used, &rng,
+				printer->tokens, printer->policy,
+				printer->count, printer->separator,
+				printer->separator_length);
+		buf[used++] = '\n';
+	}
+
+	profile_printer_flush(printer, buf, used);
+
+	memset(buf, 0, printer->buffer_size);
+	randpass_rng_clear(&rng);
+	xfree(buf);
+
+	return (NULL);
+}
+
+
 /*
  * Print a set of passwords from the profile definition.
+ *
+ * The passwords are written straight in the locale's encoding through a
+ * large buffer and, with -j, split among as many threads. Each thread draws
+ * from its own random stream so the output order is the only thing they
+ * share.
  */
 void
 profile_fprint_passwords(FILE *stream, struct profile *profile)
 {
 	unsigned int password_count = profile_get_password_count(profile);
+	unsigned int job_count = cmd_job_count;
+	struct profile_printer printer;
+	struct profile_job *jobs;
+	size_t line_max;
 
-	for (unsigned int i = 0; i < password_count; i++) {
-		wchar_t *password;
-		password = profile_generate_password(profile);
-		fprintf(stream, "%ls\n", password);
-		xfree(password);
+	if (password_count == 0) {
+		return;
 	}
+
+	printer.stream = stream;
+	printer.count = profile_get_checked_token_count(profile);
+	printer.tokens = profile_get_tokens(profile);
+	printer.policy = profile->policy;
+	printer.separator = profile_get_separator(profile);
+	printer.separator_length = strlen(printer.separator);
+
+	line_max = printer.count * (printer.tokens->max_length +
+			printer.separator_length) + 1;
+	printer.buffer_size = line_max > PROFILE_OUTPUT_BUFFER ?
+			line_max : PROFILE_OUTPUT_BUFFER;
+	pthread_mutex_init(&printer.lock, NULL);
+
+	if (job_count < 1) {
+		job_count = 1;
+	}
+	if (job_count > password_count) {
+		job_count = password_count;
+	}
+
+	jobs = xcalloc(job_count, sizeof(struct profile_job));
+	for (unsigned int i = 0; i < job_count; i++) {
+		jobs[i].printer = &printer;
+		jobs[i].count = password_count / job_count +
+				(i < password_count % job_count ? 1 : 0);
+	}
+
+	if (job_count == 1) {
+		profile_job_main(&jobs[0]);
+	} else {
+		for (unsigned int i = 0; i < job_count; i++) {
+			if (pthread_create(&jobs[i].thread, NULL,
+					profile_job_main, &jobs[i]) != 0) {
+				errx(EXIT_FAILURE, "profile_fprint_passwords "
+						"pthread_create");
+			}
+		}
+		for (unsigned int i = 0; i < job_count; i++) {
+			pthread_join(jobs[i].thread, NULL);
+		}
+	}
+
+	fflush(stream);
+
+	pthread_mutex_destroy(&printer.lock);
+	xfree(jobs);
 }
 
 
@@ -152,25 +541,27 @@ profile_fprint_passwords(FILE *stream, struct profile *profile)
 wchar_t *
 profile_generate_password(struct profile *profile)
 {
+	unsigned int count = profile_get_checked_token_count(profile);
+	struct wordlist *tokens = profile_get_tokens(profile);
+	const char *separator = profile_get_separator(profile);
+	size_t len;
 	wchar_t *s;
-	int retcode;
-	unsigned int character_count;
+	char *buf;
 
-	/* A character count specified on the command line takes precedence. */
-	if (cmd_character_count > 0) {
-		character_count = cmd_character_count;
-	} else {
-		character_count = profile->character_count;
-	}
-
-	s = xcalloc(character_count + 1, sizeof(wchar_t));
+	buf = xmalloc(count * (tokens->max_length + strlen(separator)) + 1);
+	len = profile_write_tokens(buf, NULL, tokens, profile->policy, count,
+			separator, strlen(separator));
+	buf[len] = '\0';
 
-	retcode = generate_password_from_set(s, character_count,
-			profile->character_set);
-	if (retcode != 0) {
-		errx(EXIT_FAILURE, "failed to generate password");
+	s = mbs_duplicate_as_wcs(buf);
+	if (s == NULL) {
+		errx(EXIT_FAILURE, "unable to use generated password "
+				"(wrong locale?)");
 	}
 
+	memset(buf, 0, len);
+	xfree(buf);
+
 	return (s);
 }
 
@@ -20,6 +20,7 @@
 #include <wchar.h>
 
 #include "array.h"
+#include "randpass.h"
 
 
 /* Default charsets */
@@ -30,9 +31,14 @@
 #define CHARSET_ALPHANUMERIC	CHARSET_ALPHA CHARSET_DIGITS
 #define CHARSET_SYMBOLS		L"~`!@#$%^&*()_+-=[]\\{}|;':\",./<>?"
 #define CHARSET_PRINTABLE	CHARSET_ALPHANUMERIC CHARSET_SYMBOLS
+#define CHARSET_AMBIGUOUS	L"Il1|O0o"
 
 #define DEFAULT_CHARACTER_COUNT 16
 #define DEFAULT_PASSWORD_COUNT 4
+#define DEFAULT_WORD_COUNT 6
+
+/* Size of the per-thread output buffer of profile_fprint_passwords(). */
+#define PROFILE_OUTPUT_BUFFER	(64 * 1024)
 
 
 struct profile {
@@ -40,6 +46,14 @@ struct profile {
 	unsigned int password_count;
 	unsigned int character_count;
 	wchar_t *character_set;
+	wchar_t *excluded_characters;
+	unsigned int minimum[RANDPASS_CLASS_COUNT];
+	char *word_list;
+	char *syllable_set;
+	unsigned int word_count;
+	char *word_separator;
+	struct wordlist *tokens;
+	struct randpass_policy *policy;
 };
 
 
@@ -51,6 +65,7 @@ extern struct profile_list profiles;
 
 struct profile	*profile_new(const char *);
 struct profile	*profile_get_from_name(const char *);
+double		 profile_entropy(struct profile *);
 void		 profile_fprint_passwords(FILE *, struct profile *);
 void		 profile_passwords_to_results(struct profile *, wchar_t *);
 wchar_t		*profile_generate_password(struct profile *);
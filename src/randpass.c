@@ -20,67 +20,294 @@
  *     Adel I. Mirzazhanov. All rights reserved
  */
 
+#include <stdint.h>
+#include <string.h>
 #include <wchar.h>
+#include <wctype.h>
 
 #include "arc4random.h"
+#include "chacha.h"
 #include "randpass.h"
 #include "xmalloc.h"
 
 
+#define SEED_LENGTH	(CHACHA_KEY_LENGTH + CHACHA_NONCE_LENGTH)
+
+
 /*
- * Generate a password of the given length using the provided set of
- * characters.
+ * Key a private stream from arc4random.
  */
-int
-generate_password_from_set(wchar_t *password_string, int length,
-		const wchar_t *set)
+void
+randpass_rng_init(struct randpass_rng *rng)
 {
-	wchar_t *str_pointer;
-	int *random_weight;
-	int max_weight = 0;
-	int max_weight_element_number = 0;
-	size_t setlen;
+	uint8_t seed[SEED_LENGTH];
 
-	setlen = wcslen(set);
+	arc4random_buf(seed, sizeof(seed));
+	chacha20_init(rng->state, seed, 0, seed + CHACHA_KEY_LENGTH);
+	memset(seed, 0, sizeof(seed));
+	rng->have = 0;
+}
 
-	if (length > MAX_PASSWORD_LENGTH || length < 1) {
-		return (-1);
+
+void
+randpass_rng_clear(struct randpass_rng *rng)
+{
+	memset(rng, 0, sizeof(*rng));
+}
+
+
+/*
+ * Copy len random bytes to out, from the given stream or from arc4random if
+ * rng is NULL. Like arc4random, each batch of key stream starts with the key
+ * for the next one.
+ */
+static void
+randpass_read(struct randpass_rng *rng, void *out, size_t len)
+{
+	uint8_t *dst = out, *p;
+	size_t n;
+
+	if (rng == NULL) {
+		arc4random_buf(out, len);
+		return;
+	}
+
+	while (len > 0) {
+		if (rng->have == 0) {
+			chacha20_blocks(rng->state, rng->buf,
+			    sizeof(rng->buf) / CHACHA_BLOCK_LENGTH);
+			chacha20_init(rng->state, rng->buf, 0,
+			    rng->buf + CHACHA_KEY_LENGTH);
+			memset(rng->buf, 0, SEED_LENGTH);
+			rng->have = sizeof(rng->buf) - SEED_LENGTH;
+		}
+		n = len < rng->have ? len : rng->have;
+		p = rng->buf + sizeof(rng->buf) - rng->have;
+		memcpy(dst, p, n);
+		memset(p, 0, n);
+		dst += n;
+		len -= n;
+		rng->have -= n;
 	}
+}
 
-	random_weight = xcalloc(setlen, sizeof(int));
 
-	for (size_t i = 0; i < setlen; i++) {
-		random_weight[i] = 0;
+/*
+ * Fill indexes with length values drawn uniformly from [0, setlen).
+ *
+ * The random values are fetched in bulk, one byte per index when that wastes
+ * at most one draw in eight (256 % setlen <= 32, true for digits or
+ * alpha-numeric sets but not for the 94 printable characters) and a 32-bit
+ * word otherwise. Values below range % setlen are discarded so the
+ * modulo does not favor the start of the set, and another batch is drawn for
+ * the missing ones.
+ */
+int
+generate_indexes(struct randpass_rng *rng, uint32_t *indexes, int length,
+		uint32_t setlen)
+{
+	uint8_t bytes[MAX_PASSWORD_LENGTH];
+	uint32_t words[MAX_PASSWORD_LENGTH];
+	uint32_t min;
+	int filled = 0, n;
+
+	if (length > MAX_PASSWORD_LENGTH || length < 1 || setlen == 0) {
+		return (-1);
+	}
+
+	if (setlen <= 256 && 256 % setlen <= 32) {
+		min = 256 % setlen;
+		while (filled < length) {
+			n = length - filled;
+			randpass_read(rng, bytes, n);
+			for (int i = 0; i < n; i++) {
+				if (bytes[i] >= min) {
+					indexes[filled++] = bytes[i] % setlen;
+				}
+			}
+		}
+		memset(bytes, 0, length);
+	} else {
+		/* 2**32 % setlen */
+		min = -setlen % setlen;
+		while (filled < length) {
+			n = length - filled;
+			randpass_read(rng, words, n * sizeof(uint32_t));
+			for (int i = 0; i < n; i++) {
+				if (words[i] >= min) {
+					indexes[filled++] = words[i] % setlen;
+				}
+			}
+		}
+		memset(words, 0, length * sizeof(uint32_t));
 	}
 
-	str_pointer = password_string;
+	return (0);
+}
 
-	for (int i = 0; i < length; i++) {
-		/* Assign random weight in weight array if mode is present */
-		for (size_t j = 0; j < setlen ; j++) {
-			random_weight[j] = 1 + arc4random_uniform(20000);
+
+/*
+ * Map the random word r to [0, bound) with a multiplication, drawing again in
+ * the rare case r falls in the biased part of the range (Lemire's method, no
+ * division unless the low half is below bound).
+ */
+static uint32_t
+randpass_bounded(struct randpass_rng *rng, uint32_t r, uint32_t bound)
+{
+	uint64_t m = (uint64_t)r * bound;
+	uint32_t min;
+
+	if ((uint32_t)m < bound) {
+		min = -bound % bound;
+		while ((uint32_t)m < min) {
+			randpass_read(rng, &r, sizeof(r));
+			m = (uint64_t)r * bound;
 		}
+	}
 
-		/* Find an element with maximum weight */
-		for (size_t j = 0; j < setlen; j++) {
-			if (random_weight[j] > max_weight) {
-				max_weight = random_weight[j];
-				max_weight_element_number = j;
-			}
+	return (m >> 32);
+}
+
+
+/*
+ * Return the class of a character or -1 for letters without case.
+ */
+int
+randpass_class(wchar_t c)
+{
+	if (iswdigit(c)) {
+		return (RANDPASS_DIGITS);
+	} else if (iswlower(c)) {
+		return (RANDPASS_LOWERCASE);
+	} else if (iswupper(c)) {
+		return (RANDPASS_UPPERCASE);
+	} else if (!iswalnum(c)) {
+		return (RANDPASS_SYMBOLS);
+	}
+
+	return (-1);
+}
+
+
+/*
+ * Sort the characters of set by class for the given minimums (indexed by
+ * enum randpass_class). The policy is checked by the caller: a class with a
+ * minimum may have no members.
+ */
+struct randpass_policy *
+randpass_policy_new(const wchar_t *set, const unsigned int *minimum)
+{
+	struct randpass_policy *policy;
+	size_t setlen = wcslen(set);
+	int class;
+
+	policy = xcalloc(1, sizeof(struct randpass_policy));
+	for (int i = 0; i < RANDPASS_CLASS_COUNT; i++) {
+		policy->minimum[i] = minimum[i];
+		policy->required += minimum[i];
+		policy->members[i] = xcalloc(setlen + 1, sizeof(uint32_t));
+	}
+
+	for (size_t i = 0; i < setlen; i++) {
+		if ((class = randpass_class(set[i])) == -1) {
+			continue;
 		}
+		policy->members[class][policy->member_count[class]++] = i;
+	}
+
+	return (policy);
+}
+
+
+void
+randpass_policy_free(struct randpass_policy *policy)
+{
+	for (int i = 0; i < RANDPASS_CLASS_COUNT; i++) {
+		xfree(policy->members[i]);
+	}
+	xfree(policy);
+}
+
+
+/*
+ * Fill indexes like generate_indexes() but with at least the minimum of each
+ * class of the policy, by construction: the required characters are drawn
+ * from their class, the rest from the whole set, then all of them are
+ * shuffled. Strict policies cost no more than loose ones.
+ *
+ * Returns -1 if the minimums don't fit in length or a class with a minimum
+ * has no members.
+ */
+int
+generate_indexes_with_policy(struct randpass_rng *rng, uint32_t *indexes,
+		int length, uint32_t setlen, const struct randpass_policy *policy)
+{
+	uint32_t drawn[MAX_PASSWORD_LENGTH], tmp;
+	unsigned int filled = 0;
+	uint32_t j;
+
+	if (policy == NULL || policy->required == 0) {
+		return (generate_indexes(rng, indexes, length, setlen));
+	}
+
+	if (length > MAX_PASSWORD_LENGTH || length < 1 ||
+	    policy->required > (unsigned int)length) {
+		return (-1);
+	}
 
-		/* Get password symbol */
-		*str_pointer = set[max_weight_element_number];
-		str_pointer++;
-		max_weight = 0;
-		max_weight_element_number = 0;
-		for (size_t j = 0; j < setlen; j++) {
-			random_weight[j] = 0;
+	for (int c = 0; c < RANDPASS_CLASS_COUNT; c++) {
+		if (policy->minimum[c] == 0) {
+			continue;
+		}
+		if (generate_indexes(rng, drawn, policy->minimum[c],
+		    policy->member_count[c]) != 0) {
+			return (-1);
 		}
+		for (unsigned int i = 0; i < policy->minimum[c]; i++) {
+			indexes[filled++] = policy->members[c][drawn[i]];
+		}
+	}
+
+	if (filled < (unsigned int)length && generate_indexes(rng,
+	    indexes + filled, length - filled, setlen) != 0) {
+		return (-1);
+	}
+
+	/* Fisher-Yates, the required characters could be anywhere. */
+	randpass_read(rng, drawn, (length - 1) * sizeof(uint32_t));
+	for (int i = length - 1; i > 0; i--) {
+		j = randpass_bounded(rng, drawn[i - 1], i + 1);
+		tmp = indexes[i];
+		indexes[i] = indexes[j];
+		indexes[j] = tmp;
+	}
+
+	memset(drawn, 0, sizeof(drawn));
+
+	return (0);
+}
+
+
+/*
+ * Generate a password of the given length using the provided set of
+ * characters.
+ */
+int
+generate_password_from_set(wchar_t *password_string, int length,
+		const wchar_t *set)
+{
+	uint32_t indexes[MAX_PASSWORD_LENGTH];
+
+	if (generate_indexes(NULL, indexes, length, wcslen(set)) != 0) {
+		return (-1);
+	}
+
+	for (int i = 0; i < length; i++) {
+		password_string[i] = set[indexes[i]];
 	}
 
-	xfree(random_weight);
-	*str_pointer = '\0';
+	password_string[length] = '\0';
+	memset(indexes, 0, sizeof(indexes));
 
 	return (0);
 }
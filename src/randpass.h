@@ -23,10 +23,55 @@
 #ifndef _MDP_RANDPASS_H
 #define _MDP_RANDPASS_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <wchar.h>
 
+#include "chacha.h"
+
 #define MAX_PASSWORD_LENGTH	256
 
+/*
+ * A private random stream, one per generating thread so they don't all wait
+ * on the arc4random lock.
+ */
+struct randpass_rng {
+	uint32_t	 state[16];
+	uint8_t		 buf[16 * CHACHA_BLOCK_LENGTH];
+	size_t		 have;
+};
+
+/*
+ * Character classes a policy may require a minimum of.
+ */
+enum randpass_class {
+	RANDPASS_LOWERCASE,
+	RANDPASS_UPPERCASE,
+	RANDPASS_DIGITS,
+	RANDPASS_SYMBOLS,
+	RANDPASS_CLASS_COUNT
+};
+
+/*
+ * Minimum number of characters of each class in a password, with the indexes
+ * of the set's characters belonging to each class.
+ */
+struct randpass_policy {
+	unsigned int	 minimum[RANDPASS_CLASS_COUNT];
+	unsigned int	 required;
+	uint32_t	*members[RANDPASS_CLASS_COUNT];
+	uint32_t	 member_count[RANDPASS_CLASS_COUNT];
+};
+
+void	 randpass_rng_init(struct randpass_rng *);
+void	 randpass_rng_clear(struct randpass_rng *);
+int	 randpass_class(wchar_t);
+struct randpass_policy *randpass_policy_new(const wchar_t *,
+	     const unsigned int *);
+void	 randpass_policy_free(struct randpass_policy *);
+int	 generate_indexes(struct randpass_rng *, uint32_t *, int, uint32_t);
+int	 generate_indexes_with_policy(struct randpass_rng *, uint32_t *, int,
+	     uint32_t, const struct randpass_policy *);
 int	 generate_password_from_set(wchar_t *, int, const wchar_t *);
 
 #endif /* _MDP_RANDPASS_H_ */
@@ -17,55 +17,153 @@
  * This file contains all the tools to handle the result set.
  */
 
+#include <sys/stat.h>
+
+#include <stdint.h>
 #include <stdlib.h>
 #include <err.h>
 #include <string.h>
 #include <regex.h>
+#include <pthread.h>
 
 #include "cmd.h"
-#include "crc.h"
+#include "debug.h"
+#include "config.h"
 #include "gpg.h"
+#include "journal.h"
 #include "keywords.h"
+#include "lock.h"
 #include "mdp.h"
+#include "output.h"
 #include "results.h"
 #include "str.h"
+#include "utils.h"
 #include "xmalloc.h"
 #include "wcsdup.h"
 
 
 struct wlist results = ARRAY_INITIALIZER;
 
-/* This crc32 is used to check if a file has changed after edit. */
-uint32_t result_crc32 = 0;
+/* The password file and its journal as loaded by load_results_gpg(). */
+static struct store_generation loaded_generation;
+
+/* Background load started by load_results_gpg_begin(). */
+static pthread_t loader_thread;
+static bool loader_running = false;
+static int loader_length = 0;
+static int loader_retcode = 0;
+
+/* Why the last load failed, see load_results_error(). */
+static char *load_error = NULL;
 
 
 /*
  * Instantiate a new result.
  *
  * These items won't be free'd, they will stay around until the program ends.
- * We convert and measure everything from here, unless you have a million
- * password this shouldn't be much of a bottleneck.
+ * Only the wide-char version is kept, the value is converted back to the
+ * current locale when written out. Returns NULL if that conversion isn't
+ * possible.
  */
 struct result *
 result_new(const wchar_t *value)
 {
 	struct result *new;
 
+	if (wcstombs(NULL, value, 0) == (size_t)-1) {
+		return (NULL);
+	}
+
 	new = xmalloc(sizeof(struct result));
 	new->visible = true;
 	new->wcs_value = wcsdup(value);
-	new->mbs_value = wcs_duplicate_as_mbs(value);
-	if (new->mbs_value == NULL) {
-		return (NULL);
-	}
+	new->wcs_folded = NULL;
 	new->wcs_len = wcslen(value);
-	new->mbs_len = strlen(new->mbs_value);
-
 
 	return (new);
 }
 
 
+/*
+ * Wipe and free a result.
+ */
+void
+result_kill(struct result *result)
+{
+	wmemset(result->wcs_value, L'\0', result->wcs_len);
+	xfree(result->wcs_value);
+	if (result->wcs_folded != NULL) {
+		wmemset(result->wcs_folded, L'\0', result->wcs_len);
+		xfree(result->wcs_folded);
+	}
+	xfree(result);
+}
+
+
+/*
+ * Wipe and remove all the results.
+ */
+void
+results_clear(void)
+{
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++)
+		result_kill(ARRAY_ITEM(&results, i));
+
+	ARRAY_CLEAR(&results);
+}
+
+
+/*
+ * Identify the current password file and journal: every save renames a new
+ * file in place, a new inode (or mtime, size, number of segments) means
+ * someone saved in the mean time.
+ */
+static void
+store_generation_get(struct store_generation *generation)
+{
+	struct stat sb;
+
+	memset(generation, 0, sizeof(*generation));
+	generation->segments = journal_segment_count();
+
+	if (stat(cfg_password_file, &sb) != 0)
+		return;
+
+	generation->dev = sb.st_dev;
+	generation->ino = sb.st_ino;
+	generation->mtime_sec = sb.st_mtim.tv_sec;
+	generation->mtime_nsec = sb.st_mtim.tv_nsec;
+	generation->size = sb.st_size;
+}
+
+
+/*
+ * Return the generation of the store as loaded, its lines are the first
+ * 'lines' results.
+ */
+struct store_generation *
+results_generation(void)
+{
+	return (&loaded_generation);
+}
+
+
+/*
+ * Return true if the password file or its journal were saved since they were
+ * loaded. The caller holds the lock.
+ */
+bool
+results_store_changed(void)
+{
+	struct store_generation now;
+
+	store_generation_get(&now);
+	now.lines = loaded_generation.lines;
+
+	return (memcmp(&now, &loaded_generation, sizeof(now)) != 0);
+}
+
+
 /*
  * Count of visible results.
  */
@@ -86,56 +184,132 @@ results_visible_length()
 
 
 /*
- * Check if the line matches all the keywords.
+ * Keywords prepared once per filter: lower-case wide-chars for plain text
+ * searches or compiled regexes with -E.
  */
-static bool
-line_matches_plain(const wchar_t *line)
+struct matcher {
+	unsigned int	  count;
+	wchar_t		**folded;
+	regex_t		 *regexes;
+};
+
+
+/*
+ * Prepare the current keywords for matching.
+ */
+static void
+matcher_compile(struct matcher *m)
 {
-	bool matches = true;
-	wchar_t kw[KEYWORD_LENGTH];
+	wchar_t *kw;
 
-	for (unsigned int i = 0; i < ARRAY_LENGTH(&keywords); i++) {
-		mbstowcs(kw, ARRAY_ITEM(&keywords, i), KEYWORD_LENGTH);
+	m->count = ARRAY_LENGTH(&keywords);
+	m->folded = NULL;
+	m->regexes = NULL;
 
-		if (wcscasestr(line, (const wchar_t *)kw) == NULL) {
-			matches = false;
-			break;
+	if (m->count == 0)
+		return;
+
+	if (cmd_regex) {
+		m->regexes = xcalloc(m->count, sizeof(regex_t));
+	} else {
+		m->folded = xcalloc(m->count, sizeof(wchar_t *));
+	}
+
+	for (unsigned int i = 0; i < m->count; i++) {
+		if (cmd_regex) {
+			if (regcomp(&m->regexes[i], ARRAY_ITEM(&keywords, i),
+						0) != 0)
+				errx(EXIT_FAILURE, "invalid regex '%s'",
+						ARRAY_ITEM(&keywords, i));
+			continue;
+		}
+
+		kw = mbs_duplicate_as_wcs(ARRAY_ITEM(&keywords, i));
+		if (kw == NULL) {
+			errx(EXIT_FAILURE, "unable to read keyword '%s' with "
+					"the current locale.",
+					ARRAY_ITEM(&keywords, i));
+		}
+		wcs_tolower(kw);
+		m->folded[i] = kw;
+	}
+}
+
+
+static void
+matcher_free(struct matcher *m)
+{
+	for (unsigned int i = 0; i < m->count; i++) {
+		if (m->regexes != NULL) {
+			regfree(&m->regexes[i]);
+		} else {
+			xfree(m->folded[i]);
 		}
 	}
 
-	return (matches);
+	if (m->regexes != NULL)
+		xfree(m->regexes);
+	if (m->folded != NULL)
+		xfree(m->folded);
 }
 
 
 /*
- * Check if the line matches all the regexes. This is not optimize as the
- * regexes are compiled from scratch every time. It's okay, it makes the
- * implementation simpler.
+ * Lower-case version of the line, computed on first use and kept around.
  */
-static int
-line_matches_regex(const wchar_t *line)
+static const wchar_t *
+result_folded(struct result *result)
 {
-	bool matches = true;
-	int flags = 0;
-	static char mbs_line[MAX_LINE_SIZE];
-	regex_t preg;
+	if (result->wcs_folded == NULL) {
+		result->wcs_folded = wcsdup(result->wcs_value);
+		wcs_tolower(result->wcs_folded);
+	}
 
-	for (unsigned int i = 0; i < ARRAY_LENGTH(&keywords); i++) {
-		wcstombs(mbs_line, line, sizeof(mbs_line));
+	return (result->wcs_folded);
+}
 
-		if (regcomp(&preg, ARRAY_ITEM(&keywords, i), flags) != 0)
-			err(EXIT_FAILURE, "line_matches_regex");
 
-		if (regexec(&preg, mbs_line, 0, NULL, 0) != 0) {
-			matches = false;
-			regfree(&preg);
-			break;
+/*
+ * Check if the line contains all the keywords, case-insensitive.
+ *
+ * The lower-case version of the line is kept around (see result_folded()),
+ * following searches are plain wcsstr() calls.
+ */
+static bool
+line_matches_plain(struct matcher *m, struct result *result)
+{
+	result_folded(result);
+
+	for (unsigned int i = 0; i < m->count; i++) {
+		if (wcsstr(result->wcs_folded, m->folded[i]) == NULL) {
+			return (false);
 		}
+	}
+
+	return (true);
+}
 
-		regfree(&preg);
+
+/*
+ * Check if the line matches all the regexes.
+ */
+static bool
+line_matches_regex(struct matcher *m, struct result *result)
+{
+	static char mbs_line[MAX_LINE_SIZE];
+
+	if (m->count == 0)
+		return (true);
+
+	wcstombs(mbs_line, result->wcs_value, sizeof(mbs_line));
+
+	for (unsigned int i = 0; i < m->count; i++) {
+		if (regexec(&m->regexes[i], mbs_line, 0, NULL, 0) != 0) {
+			return (false);
+		}
 	}
 
-	return (matches);
+	return (true);
 }
 
 
@@ -145,16 +319,16 @@ line_matches_regex(const wchar_t *line)
  * Commented lines are excluded by default.
  */
 static bool
-line_matches(const wchar_t *line)
+line_matches(struct matcher *m, struct result *result)
 {
-	if (line[0] == L'#') {
+	if (result->wcs_value[0] == L'#') {
 		return (false);
 	}
 
 	if (cmd_regex) {
-		return line_matches_regex(line);
+		return line_matches_regex(m, result);
 	} else {
-		return line_matches_plain(line);
+		return line_matches_plain(m, result);
 	}
 }
 
@@ -188,21 +362,207 @@ void
 filter_results()
 {
 	struct result *result;
+	struct matcher m;
+
+	matcher_compile(&m);
 
 	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
 		result = ARRAY_ITEM(&results, i);
 
-		if (line_matches(result->wcs_value)) {
+		if (line_matches(&m, result)) {
 			result->visible = true;
 		} else {
 			result->visible = false;
 		}
 	}
+
+	matcher_free(&m);
+}
+
+
+/*
+ * Trigrams of the folded lines, built once for a batch of plain searches
+ * (see print_results_batch()). Each entry is the hash of three consecutive
+ * wide-chars and the index of a line holding them, sorted by hash then line
+ * so the lines holding a trigram are a sorted range. Hashes may collide, the
+ * lines found are only candidates for line_matches().
+ */
+struct trigram {
+	uint64_t	 hash;
+	unsigned int	 line;
+};
+
+struct trigram_index {
+	struct trigram	*entries;
+	size_t		 count;
+};
+
+
+static uint64_t
+trigram_hash(const wchar_t *s)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for (int i = 0; i < 3; i++) {
+		h ^= (uint32_t)s[i];
+		h *= 0x100000001b3ULL;
+	}
+
+	return (h);
+}
+
+
+static int
+trigram_compare(const void *a, const void *b)
+{
+	const struct trigram *ta = a, *tb = b;
+
+	if (ta->hash != tb->hash)
+		return (ta->hash < tb->hash ? -1 : 1);
+
+	return ((ta->line > tb->line) - (ta->line < tb->line));
+}
+
+
+static void
+trigram_index_build(struct trigram_index *idx)
+{
+	struct result *result;
+	const wchar_t *folded;
+	size_t total = 0, n = 0;
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
+		result = ARRAY_ITEM(&results, i);
+		if (result->wcs_len >= 3)
+			total += result->wcs_len - 2;
+	}
+
+	idx->entries = xcalloc(total > 0 ? total : 1, sizeof(struct trigram));
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
+		result = ARRAY_ITEM(&results, i);
+		folded = result_folded(result);
+		for (size_t j = 0; j + 3 <= result->wcs_len; j++) {
+			idx->entries[n].hash = trigram_hash(folded + j);
+			idx->entries[n].line = i;
+			n++;
+		}
+	}
+
+	qsort(idx->entries, n, sizeof(struct trigram), trigram_compare);
+
+	/* A line holding a trigram twice only needs to be checked once. */
+	idx->count = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (idx->count > 0 && trigram_compare(&idx->entries[i],
+				&idx->entries[idx->count - 1]) == 0)
+			continue;
+		idx->entries[idx->count++] = idx->entries[i];
+	}
+
+	debug("trigram_index_build %zu trigrams", idx->count);
+}
+
+
+/*
+ * The hashes are derived from the passwords, wipe them.
+ */
+static void
+trigram_index_free(struct trigram_index *idx)
+{
+	if (idx->entries == NULL)
+		return;
+
+	memset(idx->entries, 0, idx->count * sizeof(struct trigram));
+	xfree(idx->entries);
+	idx->entries = NULL;
+	idx->count = 0;
+}
+
+
+/*
+ * Index of the first entry with a hash not lower than the given one.
+ */
+static size_t
+trigram_index_lower(struct trigram_index *idx, uint64_t hash)
+{
+	size_t lo = 0, hi = idx->count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx->entries[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return (lo);
+}
+
+
+/*
+ * Find the shortest range of lines holding a trigram of one of the keywords,
+ * every match is in it. Returns false if no keyword is long enough to have a
+ * trigram, all the lines need to be checked then.
+ */
+static bool
+trigram_index_lookup(struct trigram_index *idx, struct matcher *m,
+		size_t *first, size_t *last)
+{
+	size_t lo, hi;
+	uint64_t hash;
+	bool found = false;
+
+	for (unsigned int i = 0; i < m->count; i++) {
+		for (size_t j = 0; m->folded[i][j] != L'\0' &&
+				m->folded[i][j + 1] != L'\0' &&
+				m->folded[i][j + 2] != L'\0'; j++) {
+			hash = trigram_hash(m->folded[i] + j);
+			lo = trigram_index_lower(idx, hash);
+			for (hi = lo; hi < idx->count &&
+					idx->entries[hi].hash == hash; hi++)
+				;
+			if (!found || hi - lo < *last - *first) {
+				*first = lo;
+				*last = hi;
+				found = true;
+			}
+		}
+	}
+
+	return (found);
+}
+
+
+/*
+ * Keep the reason of a failed load for the main thread, the first one wins.
+ */
+static void
+load_results_fail(const char *msg)
+{
+	if (load_error == NULL)
+		load_error = xstrdup(msg);
+}
+
+
+/*
+ * Return why the last load failed.
+ */
+const char *
+load_results_error(void)
+{
+	if (load_error == NULL)
+		return ("GnuPG returned with an error");
+
+	return (load_error);
 }
 
 
 /*
  * Populate the results array and return the number of lines.
+ *
+ * Returns -1 if a line couldn't be read (see load_results_error()), this
+ * does not exit since it may run in the loader thread.
  */
 int
 load_results_fp(FILE *fp)
@@ -211,9 +571,6 @@ load_results_fp(FILE *fp)
 	static wchar_t wline[MAX_LINE_SIZE];
 	static char line[MAX_LINE_SIZE];
 	struct result *result;
-	CKSUM_CTX crcctx;
-
-	CKSUM_Init(&crcctx);
 
 	while (fp != NULL && fgets(line, sizeof(line), fp)) {
 		line_count++;
@@ -225,67 +582,301 @@ load_results_fp(FILE *fp)
 					"line.\n", line_count, sizeof(line));
 		}
 
-		CKSUM_Update(&crcctx, (unsigned char *)line, strlen(line));
-
-		mbstowcs(wline, line, sizeof(line));
-		wcs_strip_trailing_whitespaces(wline);
+		result = NULL;
+		if (mbstowcs(wline, line, MAX_LINE_SIZE) != (size_t)-1) {
+			wcs_strip_trailing_whitespaces(wline);
+			result = result_new(wline);
+		}
 
-		result = result_new(wline);
 		if (result == NULL) {
-			errx(EXIT_FAILURE, "unable to read line %d with the "
-					"current locale.", line_count);
+			if (load_error != NULL)
+				xfree(load_error);
+			xasprintf(&load_error, "unable to read line %d with "
+					"the current locale.", line_count);
+			return (-1);
 		}
 		ARRAY_ADD(&results, result);
 	}
 
-	CKSUM_Final(&crcctx);
-	result_crc32 = crcctx.crc;
+	return ARRAY_LENGTH(&results);
+}
+
+
+/*
+ * Load the password file and its journal segments, decrypting them all at
+ * once (see gpg_decrypt_all). The results are added in the order of the
+ * files regardless of which gpg finished first. Without a journal, this is
+ * only the password file, read the same way so its gpg gets the same
+ * timeout.
+ *
+ * Returns the number of results or -1 if GnuPG did not return successfully,
+ * the reason is then in load_results_error(). Nothing is printed and the
+ * process is not exited, this runs in the loader thread.
+ */
+static int
+load_results_files(void)
+{
+	struct gpg_plain *files;
+	unsigned int first, count, n = 0;
+	bool success;
+	FILE *fp;
+
+	if (load_error != NULL) {
+		xfree(load_error);
+		load_error = NULL;
+	}
+
+	/* Skip the segments the password file holds already. */
+	first = journal_folded() + 1;
+	count = journal_segment_count();
+	files = xcalloc(count + 1, sizeof(struct gpg_plain));
+
+	/* Password file does not exist yet, only load the journal. */
+	if (file_exists(cfg_password_file))
+		files[n++].path = xstrdup(cfg_password_file);
+	for (unsigned int i = first; i <= count; i++)
+		files[n++].path = journal_segment_path(i);
+
+	success = gpg_decrypt_all(files, n, cfg_gpg_jobs);
+
+	for (unsigned int i = 0; i < n; i++) {
+		if (files[i].error != NULL)
+			load_results_fail(files[i].error);
+
+		if (success && files[i].len > 0) {
+			fp = fmemopen(files[i].data, files[i].len, "r");
+			if (fp == NULL) {
+				load_results_fail("unable to read the "
+						"decrypted passwords");
+				success = false;
+			} else {
+				if (load_results_fp(fp) == -1)
+					success = false;
+				fclose(fp);
+			}
+		}
+
+		gpg_plain_free(&files[i]);
+		xfree(files[i].path);
+	}
+
+	xfree(files);
+
+	if (!success)
+		return (-1);
 
 	return ARRAY_LENGTH(&results);
 }
 
 
 /*
- * Load the results from the main GnuPG encrypted password file and return the
- * number of results.
+ * Load the results from the main GnuPG encrypted password file and its
+ * journal, return the number of results.
  *
- * Returns -1 if GnuPG did not return successfully.
+ * Exits if GnuPG did not return successfully.
  */
 int
 load_results_gpg()
 {
-	int length;
-	FILE *fp;
+	lock_store_shared();
+	store_generation_get(&loaded_generation);
+
+	if (load_results_files() == -1)
+		errx(EXIT_FAILURE, "%s", load_results_error());
+
+	lock_store_unset();
+	loaded_generation.lines = ARRAY_LENGTH(&results);
+
+	return ARRAY_LENGTH(&results);
+}
 
-	fp = gpg_open();
+
+static void *
+loader_main(void *arg)
+{
+	(void)(arg);
+
+	/*
+	 * Nothing in here exits or prints: the main thread shows the reason
+	 * (load_results_error()) once curses gave the terminal back.
+	 */
+	if (load_results_files() == -1)
+		loader_retcode = -1;
+	loader_length = ARRAY_LENGTH(&results);
+
+	lock_store_unset();
+
+	return (NULL);
+}
+
+
+/*
+ * Start loading the results in the background.
+ *
+ * GnuPG is started right away by another thread reading its output, the
+ * results array must not be touched until load_results_gpg_wait() returns.
+ * This allows the user to type keywords while GnuPG is busy decrypting.
+ */
+void
+load_results_gpg_begin(void)
+{
+	/* Released by the thread once everything is decrypted. */
+	lock_store_shared();
 
 	/* Password file does not exist yet. */
-	if (fp == NULL)
-		return (0);
+	if (!file_exists(cfg_password_file) && journal_segment_count() == 0) {
+		lock_store_unset();
+		return;
+	}
+
+	if (pthread_create(&loader_thread, NULL, loader_main, NULL) != 0) {
+		errx(EXIT_FAILURE, "load_results_gpg_begin pthread_create");
+	}
+	loader_running = true;
+}
 
-	length = load_results_fp(fp);
 
-	/* GnuPG exited with an non-zero return code. */
-	if (gpg_close(fp) != 0) {
-		errx(EXIT_FAILURE, "GnuPG returned with an error");
+/*
+ * Wait for the background load to complete (if any) and return the number of
+ * results.
+ *
+ * Returns -1 if GnuPG did not return successfully, the reason is in
+ * load_results_error().
+ */
+int
+load_results_gpg_wait(void)
+{
+	if (!loader_running)
+		return ARRAY_LENGTH(&results);
+
+	if (pthread_join(loader_thread, NULL) != 0) {
+		errx(EXIT_FAILURE, "load_results_gpg_wait pthread_join");
 	}
+	loader_running = false;
+
+	if (loader_retcode != 0)
+		return (-1);
 
-	return (length);
+	return (loader_length);
 }
 
 
 /*
- * Print the results to screen with the get command's "raw" mode (-r).
+ * Encrypt the results to the given file (the password file or a journal
+ * segment), straight from memory.
  */
 void
-print_results(void)
+save_results_gpg(const char *target)
 {
+	static char line[MAX_LINE_SIZE];
 	struct result *result;
+	size_t len;
+	FILE *fp;
+
+	fp = gpg_encrypt_open(target);
 
 	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
 		result = ARRAY_ITEM(&results, i);
-		if (result->visible) {
-			printf("%ls\n", result->wcs_value);
+		len = wcstombs(line, result->wcs_value, sizeof(line) - 1);
+		if (len == (size_t)-1 || len >= sizeof(line) - 1) {
+			errx(EXIT_FAILURE, "save_results_gpg unable to convert "
+					"line %u", i + 1);
 		}
+		line[len++] = '\n';
+		if (fwrite(line, 1, len, fp) != len)
+			break;
 	}
+
+	memset(line, 0, sizeof(line));
+
+	gpg_encrypt_close(fp);
+}
+
+
+/*
+ * Print the lines matching the current keywords for one query of a batch.
+ * Plain searches only check the lines holding the rarest trigram of the
+ * keywords, regexes and short keywords check every line.
+ */
+static void
+print_batch_query(struct trigram_index *idx, unsigned int query_id)
+{
+	struct result *result;
+	struct matcher m;
+	size_t first, last;
+
+	matcher_compile(&m);
+
+	if (idx->entries != NULL && trigram_index_lookup(idx, &m, &first,
+			&last)) {
+		for (size_t i = first; i < last; i++) {
+			result = ARRAY_ITEM(&results, idx->entries[i].line);
+			if (line_matches(&m, result))
+				output_result(query_id, result);
+		}
+	} else {
+		for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
+			result = ARRAY_ITEM(&results, i);
+			if (line_matches(&m, result))
+				output_result(query_id, result);
+		}
+	}
+
+	matcher_free(&m);
+}
+
+
+/*
+ * Run one search per line of the given stream, the password file is only
+ * decrypted once for the whole batch and indexed once by trigram for plain
+ * searches.
+ *
+ * Each match is printed on its own line, prefixed by the query id (the line
+ * number of the query in the stream) and a tab. Empty lines are skipped but
+ * still counted.
+ */
+void
+print_results_batch(FILE *fp)
+{
+	static char line[MAX_LINE_SIZE];
+	struct trigram_index idx = { NULL, 0 };
+	unsigned int query_id = 0;
+
+	if (!cmd_regex)
+		trigram_index_build(&idx);
+
+	while (fgets(line, sizeof(line), fp)) {
+		query_id++;
+
+		strip_trailing_whitespaces(line);
+		if (line[0] == '\0')
+			continue;
+
+		keywords_load_from_char(line);
+		print_batch_query(&idx, query_id);
+	}
+
+	trigram_index_free(&idx);
+	memset(line, 0, sizeof(line));
+
+	output_flush();
+}
+
+
+/*
+ * Print the results to stdout with the get command's "raw" mode (-r), in the
+ * format selected with -o.
+ */
+void
+print_results(void)
+{
+	struct result *result;
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(&results); i++) {
+		result = ARRAY_ITEM(&results, i);
+		if (result->visible)
+			output_result(0, result);
+	}
+
+	output_flush();
 }
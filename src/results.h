@@ -17,6 +17,9 @@
 #ifndef _RESULTS_H_
 #define _RESULTS_H_
 
+#include <sys/types.h>
+
+#include <time.h>
 #include <wchar.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -25,30 +28,49 @@
 #include "array.h"
 
 
-#define KEYWORD_LENGTH 50
-
 
 struct result {
 	bool visible;
 	wchar_t *wcs_value;
-	char *mbs_value;
+	wchar_t *wcs_folded;
 	size_t wcs_len;
-	size_t mbs_len;
 };
 
 ARRAY_DECL(wlist, struct result *);
 
+/*
+ * Identity of the password file and its journal segments, see
+ * results_store_changed().
+ */
+struct store_generation {
+	dev_t		 dev;
+	ino_t		 ino;
+	time_t		 mtime_sec;
+	long		 mtime_nsec;
+	off_t		 size;
+	unsigned int	 segments;
+	unsigned int	 lines;
+};
+
 
 extern struct wlist results;
 
 
 struct result	*result_new(const wchar_t *);
 void		 result_kill(struct result *);
+void		 results_clear(void);
+struct store_generation *results_generation(void);
+bool		 results_store_changed(void);
 unsigned int	 results_visible_length(void);
 unsigned int	 get_max_length(void);
 void		 filter_results(void);
 int		 load_results_gpg(void);
+void		 load_results_gpg_begin(void);
+int		 load_results_gpg_wait(void);
 int		 load_results_fp(FILE *);
+const char	*load_results_error(void);
+void		 save_results_gpg(const char *);
 void		 print_results(void);
+void		 print_results_batch(FILE *);
 
 #endif /* _RESULTS_H_ */
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SHA-256 as described in FIPS 180-4, used to detect changes in the
+ * plain-text file after edition, along with HMAC and HKDF for the key
+ * derivation of the native backend.
+ */
+
+#include <string.h>
+
+#include "sha256.h"
+
+
+#define ROTR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)	(((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)	(((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define BSIG0(x)	(ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define BSIG1(x)	(ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SSIG0(x)	(ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SSIG1(x)	(ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+static void
+sha256_transform(uint32_t *state, const uint8_t *block)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2;
+	unsigned int i;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = (uint32_t)block[i * 4] << 24 |
+		    (uint32_t)block[i * 4 + 1] << 16 |
+		    (uint32_t)block[i * 4 + 2] << 8 |
+		    (uint32_t)block[i * 4 + 3];
+	}
+	for (; i < 64; i++)
+		w[i] = SSIG1(w[i - 2]) + w[i - 7] + SSIG0(w[i - 15]) + w[i - 16];
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	for (i = 0; i < 64; i++) {
+		t1 = h + BSIG1(e) + CH(e, f, g) + K[i] + w[i];
+		t2 = BSIG0(a) + MAJ(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+
+void
+sha256_init(struct sha256_ctx *ctx)
+{
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+	ctx->count = 0;
+}
+
+
+void
+sha256_update(struct sha256_ctx *ctx, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	size_t used, fill;
+
+	used = ctx->count % SHA256_BLOCK_LENGTH;
+	ctx->count += len;
+
+	/* Complete a partial block first. */
+	if (used > 0) {
+		fill = SHA256_BLOCK_LENGTH - used;
+		if (len < fill) {
+			memcpy(ctx->buffer + used, p, len);
+			return;
+		}
+		memcpy(ctx->buffer + used, p, fill);
+		sha256_transform(ctx->state, ctx->buffer);
+		p += fill;
+		len -= fill;
+	}
+
+	/* Hash full blocks straight from the input. */
+	while (len >= SHA256_BLOCK_LENGTH) {
+		sha256_transform(ctx->state, p);
+		p += SHA256_BLOCK_LENGTH;
+		len -= SHA256_BLOCK_LENGTH;
+	}
+
+	memcpy(ctx->buffer, p, len);
+}
+
+
+/*
+ * Pad the last block, write the digest and wipe the context.
+ */
+void
+sha256_final(struct sha256_ctx *ctx, uint8_t *digest)
+{
+	uint64_t bits = ctx->count * 8;
+	size_t used = ctx->count % SHA256_BLOCK_LENGTH;
+
+	ctx->buffer[used++] = 0x80;
+
+	if (used > SHA256_BLOCK_LENGTH - 8) {
+		memset(ctx->buffer + used, 0, SHA256_BLOCK_LENGTH - used);
+		sha256_transform(ctx->state, ctx->buffer);
+		used = 0;
+	}
+	memset(ctx->buffer + used, 0, SHA256_BLOCK_LENGTH - 8 - used);
+
+	for (unsigned int i = 0; i < 8; i++)
+		ctx->buffer[SHA256_BLOCK_LENGTH - 1 - i] = bits >> (i * 8);
+	sha256_transform(ctx->state, ctx->buffer);
+
+	for (unsigned int i = 0; i < 8; i++) {
+		digest[i * 4] = ctx->state[i] >> 24;
+		digest[i * 4 + 1] = ctx->state[i] >> 16;
+		digest[i * 4 + 2] = ctx->state[i] >> 8;
+		digest[i * 4 + 3] = ctx->state[i];
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+
+/*
+ * HMAC-SHA256 (RFC 2104) of a message in one piece.
+ */
+void
+hmac_sha256(uint8_t *mac, const void *key, size_t keylen, const void *msg,
+    size_t len)
+{
+	uint8_t k[SHA256_BLOCK_LENGTH], pad[SHA256_BLOCK_LENGTH];
+	uint8_t inner[SHA256_DIGEST_LENGTH];
+	struct sha256_ctx ctx;
+
+	memset(k, 0, sizeof(k));
+	if (keylen > SHA256_BLOCK_LENGTH) {
+		sha256_init(&ctx);
+		sha256_update(&ctx, key, keylen);
+		sha256_final(&ctx, k);
+	} else {
+		memcpy(k, key, keylen);
+	}
+
+	for (unsigned int i = 0; i < SHA256_BLOCK_LENGTH; i++)
+		pad[i] = k[i] ^ 0x36;
+	sha256_init(&ctx);
+	sha256_update(&ctx, pad, sizeof(pad));
+	sha256_update(&ctx, msg, len);
+	sha256_final(&ctx, inner);
+
+	for (unsigned int i = 0; i < SHA256_BLOCK_LENGTH; i++)
+		pad[i] = k[i] ^ 0x5c;
+	sha256_init(&ctx);
+	sha256_update(&ctx, pad, sizeof(pad));
+	sha256_update(&ctx, inner, sizeof(inner));
+	sha256_final(&ctx, mac);
+
+	memset(k, 0, sizeof(k));
+	memset(pad, 0, sizeof(pad));
+	memset(inner, 0, sizeof(inner));
+}
+
+
+/*
+ * HKDF-SHA256 (RFC 5869), at most 255 digests of output. The info string is
+ * limited to 128 bytes, it only ever holds a short label here.
+ */
+void
+hkdf_sha256(uint8_t *out, size_t outlen, const void *ikm, size_t ikmlen,
+    const void *salt, size_t saltlen, const char *info)
+{
+	uint8_t prk[SHA256_DIGEST_LENGTH], t[SHA256_DIGEST_LENGTH];
+	uint8_t msg[SHA256_DIGEST_LENGTH + 128 + 1];
+	size_t infolen, msglen, n;
+	uint8_t counter = 1;
+
+	hmac_sha256(prk, salt, saltlen, ikm, ikmlen);
+
+	infolen = strlen(info);
+	if (infolen > 128)
+		infolen = 128;
+
+	for (size_t done = 0; done < outlen; done += n, counter++) {
+		msglen = 0;
+		if (counter > 1) {
+			memcpy(msg, t, sizeof(t));
+			msglen = sizeof(t);
+		}
+		memcpy(msg + msglen, info, infolen);
+		msglen += infolen;
+		msg[msglen++] = counter;
+
+		hmac_sha256(t, prk, sizeof(prk), msg, msglen);
+
+		n = outlen - done < sizeof(t) ? outlen - done : sizeof(t);
+		memcpy(out + done, t, n);
+	}
+
+	memset(prk, 0, sizeof(prk));
+	memset(t, 0, sizeof(t));
+	memset(msg, 0, sizeof(msg));
+}
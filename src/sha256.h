@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BLOCK_LENGTH	64
+#define SHA256_DIGEST_LENGTH	32
+
+struct sha256_ctx {
+	uint32_t	state[8];
+	uint64_t	count;
+	uint8_t		buffer[SHA256_BLOCK_LENGTH];
+};
+
+void		 sha256_init(struct sha256_ctx *);
+void		 sha256_update(struct sha256_ctx *, const void *, size_t);
+void		 sha256_final(struct sha256_ctx *, uint8_t *);
+void		 hmac_sha256(uint8_t *, const void *, size_t, const void *,
+		     size_t);
+void		 hkdf_sha256(uint8_t *, size_t, const void *, size_t,
+		     const void *, size_t, const char *);
+
+#endif /* _SHA256_H_ */
@@ -0,0 +1,581 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Remote storage, 'set storage_get_command' and 'set storage_put_command'.
+ *
+ * Like the archive commands of a PostgreSQL WAL, the commands are run by
+ * the shell with %p replaced by the local path to fetch to or push from and
+ * %e by the path of a validator file the command may keep (e.g. an ETag for
+ * curl --etag-compare/--etag-save). The password file is the local cache of
+ * the remote copy:
+ *
+ *  - lookups (get, prompt, audit) read the cache right away and refresh it
+ *    in the background, only the very first fetch is waited on,
+ *  - commands changing the password file fetch it first, under the lock,
+ *  - each save is pushed in the background. A marker (passwords.push) stays
+ *    until a push of the latest file succeeded, the cache is not replaced by
+ *    a fetch in the mean time and the next refresh retries the push. Each
+ *    save writes a new generation in the marker, a push only removes the
+ *    marker if no save happened since it started.
+ *
+ * A fetch is only installed if it differs from the cache. The command can
+ * also leave %p empty to report the remote copy was not modified.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+
+#include "config.h"
+#include "debug.h"
+#include "lock.h"
+#include "storage.h"
+#include "utils.h"
+#include "xmalloc.h"
+
+
+/*
+ * Return true if the remote storage is configured.
+ */
+bool
+storage_enabled(void)
+{
+	return (cfg_storage_get_command != NULL ||
+			cfg_storage_put_command != NULL);
+}
+
+
+/*
+ * Path of a file kept next to the password file.
+ */
+static char *
+storage_path(const char *suffix)
+{
+	char *path;
+
+	xasprintf(&path, "%s.%s", cfg_password_file, suffix);
+
+	return (path);
+}
+
+
+/*
+ * Append the path to the command, between single quotes for the shell.
+ */
+static void
+storage_quote(char **command, const char *path)
+{
+	char *quoted;
+
+	for (; *path != '\0'; path++) {
+		if (*path == '\'') {
+			xasprintf(&quoted, "%s'\\''", *command);
+		} else {
+			xasprintf(&quoted, "%s%c", *command, *path);
+		}
+		xfree(*command);
+		*command = quoted;
+	}
+}
+
+
+/*
+ * Return the command with its %p, %e and %% expanded.
+ */
+static char *
+storage_expand(const char *template, const char *path)
+{
+	char *command, *tmp, *etag_path;
+
+	command = xstrdup("");
+	etag_path = storage_path("etag");
+
+	for (const char *c = template; *c != '\0'; c++) {
+		if (*c == '%' && (c[1] == 'p' || c[1] == 'e')) {
+			xasprintf(&tmp, "%s'", command);
+			xfree(command);
+			command = tmp;
+			storage_quote(&command, c[1] == 'p' ? path : etag_path);
+			xasprintf(&tmp, "%s'", command);
+			c++;
+		} else if (*c == '%' && c[1] == '%') {
+			xasprintf(&tmp, "%s%%", command);
+			c++;
+		} else {
+			xasprintf(&tmp, "%s%c", command, *c);
+		}
+		xfree(command);
+		command = tmp;
+	}
+
+	xfree(etag_path);
+
+	return (command);
+}
+
+
+/*
+ * Run the command through the shell and wait for it. Its output goes to
+ * stderr, stdout is left to mdp. Return true if it succeeded.
+ */
+static bool
+storage_run(const char *template, const char *path)
+{
+	char *command;
+	int status, null;
+	pid_t pid;
+
+	command = storage_expand(template, path);
+	debug("storage_run %s", command);
+
+	pid = fork();
+
+	switch (pid) {
+	case -1:
+		err(EXIT_FAILURE, "storage_run fork");
+		break;
+	case 0:
+		signal(SIGINT, SIG_DFL);
+
+		null = open("/dev/null", O_RDONLY);
+		if (null != -1)
+			dup2(null, STDIN_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+
+		execl("/bin/sh", "sh", "-c", command, NULL);
+		err(EXIT_FAILURE, "couldn't execute");
+		/* NOTREACHED */
+	default:
+		break;
+	}
+
+	xfree(command);
+
+	if (waitpid(pid, &status, 0) == -1)
+		err(EXIT_FAILURE, "storage_run waitpid()");
+
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+
+/*
+ * Return true if both files have the same content.
+ */
+static bool
+storage_same_content(const char *a, const char *b)
+{
+	static char buf_a[65536], buf_b[65536];
+	struct stat sb_a, sb_b;
+	ssize_t len;
+	bool same = false;
+	int fd_a, fd_b;
+
+	if ((fd_a = open(a, O_RDONLY)) == -1)
+		return (false);
+	if ((fd_b = open(b, O_RDONLY)) == -1) {
+		close(fd_a);
+		return (false);
+	}
+
+	if (fstat(fd_a, &sb_a) != 0 || fstat(fd_b, &sb_b) != 0 ||
+			sb_a.st_size != sb_b.st_size)
+		goto out;
+
+	for (;;) {
+		len = read_full(fd_a, buf_a, sizeof(buf_a));
+		if (len == -1 || read_full(fd_b, buf_b, len) != len ||
+				memcmp(buf_a, buf_b, len) != 0)
+			goto out;
+		if (len == 0)
+			break;
+	}
+	same = true;
+
+out:
+	close(fd_a);
+	close(fd_b);
+
+	return (same);
+}
+
+
+/*
+ * Replace the password file with the fetched copy, unless it is the same or
+ * the password file has changes not pushed yet. The caller holds the lock.
+ */
+static void
+storage_install(const char *fetch_path)
+{
+	struct stat sb;
+	char *push_path, *dir;
+	int fd;
+
+	if (stat(fetch_path, &sb) != 0 || sb.st_size == 0) {
+		debug("storage_install: not modified");
+		return;
+	}
+
+	push_path = storage_path("push");
+	if (file_exists(push_path)) {
+		debug("storage_install: changes not pushed, fetch ignored");
+		xfree(push_path);
+		return;
+	}
+	xfree(push_path);
+
+	if (storage_same_content(fetch_path, cfg_password_file)) {
+		debug("storage_install: same content");
+		return;
+	}
+
+	if ((fd = open(fetch_path, O_RDONLY)) == -1 || fsync(fd) != 0)
+		err(EXIT_FAILURE, "storage_install fsync(%s)", fetch_path);
+	close(fd);
+
+	lock_store_exclusive();
+	if (rename(fetch_path, cfg_password_file) != 0)
+		err(EXIT_FAILURE, "storage_install rename(%s, %s)", fetch_path,
+				cfg_password_file);
+	lock_store_unset();
+
+	dir = xdirname(cfg_password_file);
+	if ((fd = open(dir, O_RDONLY)) != -1) {
+		fsync(fd);
+		close(fd);
+	}
+	xfree(dir);
+
+	debug("storage_install: %s replaced", cfg_password_file);
+}
+
+
+/*
+ * Run the get command to a new file next to the password file. Return its
+ * path, or NULL if the command failed.
+ */
+static char *
+storage_fetch(void)
+{
+	char *fetch_path;
+	int fd;
+
+	fetch_path = storage_path("fetch.XXXXXXXX");
+	if ((fd = mkstemp(fetch_path)) == -1)
+		err(EXIT_FAILURE, "storage_fetch mkstemp(%s)", fetch_path);
+	close(fd);
+
+	if (!storage_run(cfg_storage_get_command, fetch_path)) {
+		unlink(fetch_path);
+		xfree(fetch_path);
+		return (NULL);
+	}
+
+	return (fetch_path);
+}
+
+
+/*
+ * Read the generation written in the marker by storage_push_begin(), empty
+ * for a marker left by an older version. The caller holds the store lock.
+ */
+static bool
+storage_push_generation(const char *push_path, char *buf, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	if ((fd = open(push_path, O_RDONLY)) == -1)
+		return (false);
+
+	len = read_full(fd, buf, size - 1);
+	close(fd);
+	if (len == -1)
+		return (false);
+	buf[len] = '\0';
+
+	return (true);
+}
+
+
+/*
+ * Push the password file. Pushes are serialized on the marker, so the last
+ * one to run always sends the latest file. The marker is removed once the
+ * latest file is pushed: its generation is checked again under the store
+ * lock, a save in the mean time wrote a new one.
+ */
+static bool
+storage_push(void)
+{
+	char before[64], after[64];
+	char *push_path;
+	bool pushed = false, known;
+	int fd;
+
+	push_path = storage_path("push");
+	if ((fd = open(push_path, O_RDONLY)) == -1) {
+		xfree(push_path);
+		return (true);
+	}
+
+	if (flock(fd, LOCK_EX) != 0)
+		err(EXIT_FAILURE, "storage_push flock(%s)", push_path);
+
+	/* Pushed by whoever held the marker before us. */
+	if (!file_exists(push_path)) {
+		pushed = true;
+		goto out;
+	}
+
+	lock_store_shared();
+	known = storage_push_generation(push_path, before, sizeof(before));
+	lock_store_unset();
+	if (!known)
+		goto out;
+
+	if (!storage_run(cfg_storage_put_command, cfg_password_file))
+		goto out;
+
+	lock_store_exclusive();
+	if (storage_push_generation(push_path, after, sizeof(after)) &&
+			strcmp(before, after) == 0) {
+		unlink(push_path);
+		pushed = true;
+	}
+	lock_store_unset();
+
+out:
+	close(fd);
+	xfree(push_path);
+
+	return (pushed);
+}
+
+
+static void
+storage_push_detached(void)
+{
+	storage_push();
+}
+
+
+/*
+ * Fetch, or retry a pending push, under the lock the caller holds. Used
+ * before the password file is changed and when there is no cache yet.
+ */
+static void
+storage_sync_locked(void)
+{
+	char *push_path, *fetch_path;
+
+	push_path = storage_path("push");
+	if (file_exists(push_path)) {
+		if (cfg_storage_put_command != NULL && !storage_push())
+			fprintf(stderr, "WARNING: storage put command failed, "
+					"keeping the local changes.\n");
+		xfree(push_path);
+		return;
+	}
+	xfree(push_path);
+
+	if (cfg_storage_get_command == NULL)
+		return;
+
+	if ((fetch_path = storage_fetch()) == NULL) {
+		fprintf(stderr, "WARNING: storage get command failed, using "
+				"the local password file.\n");
+		return;
+	}
+
+	storage_install(fetch_path);
+	unlink(fetch_path);
+	xfree(fetch_path);
+}
+
+
+/*
+ * Bring the password file up to date before it is changed, the caller holds
+ * the lock.
+ */
+void
+storage_sync(void)
+{
+	if (!storage_enabled())
+		return;
+
+	debug("storage_sync");
+
+	storage_sync_locked();
+}
+
+
+/*
+ * Run the function in a detached grand-child, the caller doesn't wait nor
+ * leave a zombie behind.
+ */
+static void
+storage_detach(void (*fn)(void))
+{
+	int status, null;
+	pid_t pid;
+
+	pid = fork();
+
+	switch (pid) {
+	case -1:
+		err(EXIT_FAILURE, "storage fork");
+		break;
+	case 0:
+		setsid();
+		signal(SIGINT, SIG_IGN);
+		signal(SIGHUP, SIG_IGN);
+
+		if (fork() != 0)
+			_exit(0);
+
+		null = open("/dev/null", O_RDWR);
+		if (null != -1) {
+			dup2(null, STDIN_FILENO);
+			dup2(null, STDOUT_FILENO);
+			if (!debug_enabled)
+				dup2(null, STDERR_FILENO);
+		}
+		/* The locks of the parent are its own, drop our descriptor. */
+		lock_unset();
+		for (int fd = STDERR_FILENO + 1; fd < 256; fd++)
+			close(fd);
+
+		fn();
+
+		/* Avoid atexit() to run on the child. */
+		_exit(0);
+		/* NOTREACHED */
+	default:
+		break;
+	}
+
+	if (waitpid(pid, &status, 0) == -1)
+		err(EXIT_FAILURE, "storage waitpid()");
+}
+
+
+/*
+ * Background refresh: retry a pending push or fetch the remote copy, then
+ * install it if no one holds the lock. The fetch itself runs unlocked.
+ */
+static void
+storage_refresh(void)
+{
+	char *push_path, *fetch_path;
+
+	push_path = storage_path("push");
+	if (file_exists(push_path)) {
+		xfree(push_path);
+		if (cfg_storage_put_command != NULL)
+			storage_push();
+		return;
+	}
+	xfree(push_path);
+
+	if (cfg_storage_get_command == NULL)
+		return;
+
+	if ((fetch_path = storage_fetch()) == NULL)
+		return;
+
+	if (lock_try()) {
+		storage_install(fetch_path);
+		lock_unset();
+	}
+
+	unlink(fetch_path);
+	xfree(fetch_path);
+}
+
+
+/*
+ * Refresh the password file for a lookup. The lookup reads the local copy
+ * while it is refreshed for the next one, unless there is no local copy.
+ */
+void
+storage_refresh_begin(void)
+{
+	if (!storage_enabled())
+		return;
+
+	if (!file_exists(cfg_password_file)) {
+		debug("storage_refresh_begin: no local copy");
+		lock_set();
+		storage_sync_locked();
+		lock_unset();
+		return;
+	}
+
+	/*
+	 * Share the store lock before the refresh starts, it can't install
+	 * its copy before our load takes the lock and releases it.
+	 */
+	lock_store_shared();
+
+	debug("storage_refresh_begin");
+	storage_detach(storage_refresh);
+}
+
+
+/*
+ * Push the password file which was just saved, in the background. The
+ * marker is given a new generation (the time and our pid) under the store
+ * lock, a push started before this save won't remove it.
+ */
+void
+storage_push_begin(void)
+{
+	char generation[64];
+	char *push_path;
+	int fd, len;
+
+	if (cfg_storage_put_command == NULL)
+		return;
+
+	len = snprintf(generation, sizeof(generation), "%lld %ld\n",
+			now_ms(), (long)getpid());
+
+	lock_store_exclusive();
+
+	push_path = storage_path("push");
+	fd = open(push_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1)
+		err(EXIT_FAILURE, "storage_push_begin open(%s)", push_path);
+	if (!write_full(fd, generation, len) || close(fd) != 0)
+		err(EXIT_FAILURE, "storage_push_begin write(%s)", push_path);
+	xfree(push_path);
+
+	lock_store_unset();
+
+	debug("storage_push_begin");
+	storage_detach(storage_push_detached);
+}
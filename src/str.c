@@ -119,6 +119,18 @@ wcs_strip_trailing_whitespaces(wchar_t *s)
 }
 
 
+/*
+ * Convert a wide-char string to lower-case, in place.
+ */
+void
+wcs_tolower(wchar_t *s)
+{
+	for (; *s != L'\0'; s++) {
+		*s = (wchar_t)towlower((wint_t)*s);
+	}
+}
+
+
 /*
  * Strip trailing whitespace.
  */
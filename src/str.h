@@ -23,6 +23,7 @@ char 		*join_list(char, int, char **);
 char 		*join(char, const char *, const char *);
 wchar_t		*wcsjoin(wchar_t, const wchar_t *, const wchar_t *);
 void		 wcs_strip_trailing_whitespaces(wchar_t *);
+void		 wcs_tolower(wchar_t *);
 void		 strip_trailing_whitespaces(char *);
 const wchar_t 	*wcscasestr(const wchar_t *, const wchar_t *);
 char 		*wcs_duplicate_as_mbs(const wchar_t *);
@@ -17,6 +17,7 @@
 #include <sys/ioctl.h>
 
 #include <termios.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <err.h>
@@ -24,9 +25,8 @@
 #include <signal.h>
 
 #include "config.h"
-#include "str.h"
+#include "debug.h"
 #include "ui-curses.h"
-#include "xmalloc.h"
 
 
 unsigned int		 window_width = 0, window_height = 0;
@@ -43,6 +43,7 @@ shutdown_curses()
 		clear();
 		refresh();
 		endwin();
+		screen = NULL;
 	}
 }
 
@@ -63,22 +64,63 @@ resize(int signal)
 
 
 /*
- * Wrapper around waddstr which automatically converts wide-char strings.
+ * Add a wide-char string to the window, curses handles the wide-chars
+ * natively, no conversion is needed.
  */
 int
 waddwcs(WINDOW *win, const wchar_t *str)
 {
-	int ret;
-	char *mbs;
+	return waddnwstr(win, str, -1);
+}
+
+
+/*
+ * Return the number of bytes this process wrote so far, as accounted by the
+ * kernel. Only available on Linux, returns 0 elsewhere.
+ */
+static unsigned long long
+bytes_written(void)
+{
+	FILE *fp;
+	char line[64];
+	unsigned long long count = 0;
 
-	mbs = wcs_duplicate_as_mbs(str);
-	if (mbs == NULL) {
-		err(EXIT_FAILURE, "waddwcs:wcs_duplicate_as_mbs");
+	fp = fopen("/proc/self/io", "r");
+	if (fp == NULL)
+		return (0);
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "wchar: %llu", &count) == 1)
+			break;
 	}
-	ret = waddstr(win, mbs);
-	xfree(mbs);
 
-	return (ret);
+	fclose(fp);
+
+	return (count);
+}
+
+
+/*
+ * Send the pending changes of the screen to the terminal.
+ *
+ * In debug mode, the number of bytes written for this update is reported, it
+ * gives an idea of what a redraw costs on a slow link.
+ */
+void
+update_screen(void)
+{
+	unsigned long long before;
+
+	wnoutrefresh(screen);
+
+	if (!debug_enabled) {
+		doupdate();
+		return;
+	}
+
+	before = bytes_written();
+	doupdate();
+	debug("update_screen wrote %llu bytes", bytes_written() - before);
 }
 
 
@@ -99,6 +141,10 @@ init_curses()
 
 	/* curses screen init */
 	screen = initscr();
+	if (window_width == 0 || window_height == 0) {
+		window_width = COLS;
+		window_height = LINES;
+	}
 	noecho();
 	cbreak();
 	curs_set(0);
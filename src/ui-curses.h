@@ -29,5 +29,6 @@ int		 waddwcs(WINDOW *, const wchar_t *);
 void		 shutdown_curses(void);
 void		 resize(int);
 void		 init_curses(void);
+void		 update_screen(void);
 
 #endif /* _MDP_CURSES_H_ */
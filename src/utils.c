@@ -15,6 +15,10 @@
  */
 
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <sys/wait.h>
 
 #include <unistd.h>
 #include <stdio.h>
@@ -22,8 +26,12 @@
 #include <errno.h>
 #include <err.h>
 #include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <string.h>
+#include <time.h>
 
 #include "debug.h"
 #include "str.h"
@@ -31,9 +39,6 @@
 #include "xmalloc.h"
 
 
-pid_t watcher_pid = 0;
-
-
 /*
  * Portable dirname wrapper.
  *
@@ -114,76 +119,195 @@ file_exists(const char *filepath)
 
 
 /*
- * Stop the process watch timeout.
+ * Read until len bytes were read or the end of the file. Returns the number
+ * of bytes read or -1 on error.
  */
-void
-cancel_pid_timeout()
+ssize_t
+read_full(int fd, void *buf, size_t len)
 {
-	if (watcher_pid == 0)
-		return;
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = read(fd, (char *)buf + done, len - done);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r == -1)
+			return (-1);
+		if (r == 0)
+			break;
+		done += r;
+	}
+
+	return (done);
+}
+
+
+/*
+ * Write the whole buffer, returns false on error.
+ */
+bool
+write_full(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t r;
+
+	while (len > 0) {
+		r = write(fd, p, len);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r == -1)
+			return (false);
+		p += r;
+		len -= r;
+	}
+
+	return (true);
+}
 
-	debug("cancel_pid_timeout on %d", watcher_pid);
 
-	if (kill(watcher_pid, SIGINT) != 0) {
-		if (errno != ESRCH) {
-			err(EXIT_FAILURE, "cancel_pid_timeout");
+/*
+ * Binary logarithm of x >= 1, to about 1e-9, without pulling in libm.
+ */
+double
+log2_approx(double x)
+{
+	double bits = 0, frac = 1;
+
+	for (; x >= 2; x /= 2)
+		bits++;
+	for (int i = 0; i < 32; i++) {
+		x *= x;
+		frac /= 2;
+		if (x >= 2) {
+			x /= 2;
+			bits += frac;
 		}
 	}
 
-	watcher_pid = 0;
+	return (bits);
+}
+
+
+/*
+ * Milliseconds on the monotonic clock, to compute deadlines.
+ */
+long long
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
 }
 
 
 /*
- * Automatically kill a process after X seconds.
+ * Wait for a child process, interrupting it with SIGINT once the deadline
+ * (see now_ms()) is past and killing it if it is still there KILL_GRACE_MS
+ * later. The status of the child is stored in status, returns true if it had
+ * to be interrupted.
  *
- * Sets the global pid_t for the watcher process, you need to run
- * cancel_pid_timeout once the child process is known to have completed.
+ * The child is watched through a pidfd where available, otherwise its status
+ * is polled with a backoff (from 1 ms to 100 ms), no process is started.
  */
-void
-set_pid_timeout(pid_t pid, int timeout)
+bool
+wait_child(pid_t pid, int *status, long long deadline)
 {
-	watcher_pid = fork();
-
-	switch (watcher_pid) {
-	case -1:
-		err(EXIT_FAILURE, "set_pid_timeout fork()");
-		break;
-
-	case 0: /* Child process */
-		/* Reset signals since the parent uses them to cleanup. */
-		signal(SIGINT, SIG_DFL);
-		signal(SIGKILL, SIG_DFL);
-
-		debug("set_pid_timeout sleep(%d)", timeout);
-		sleep(timeout);
-
-		/*
-		 * If the parent died in the mean time, don't bother trying to
-		 * kill anything, don't even mention anything to the user
-		 * unless in debug mode.
-		 */
-		if (kill(getppid(), 0) != 0) {
-			debug("set_pid_timeout parent is gone, aborting");
-			_Exit(0);
+	struct pollfd pfd = { -1, POLLIN, 0 };
+	long long now, left;
+	int delay = 1;
+	bool timed_out = false, killed = false;
+	pid_t x;
+
+#ifdef SYS_pidfd_open
+	pfd.fd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+	for (;;) {
+		x = waitpid(pid, status, WNOHANG);
+		if (x == pid)
+			break;
+		if (x == -1) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "wait_child waitpid(%d)", pid);
 		}
 
-		debug("set_pid_timeout kill(%d, SIGINT)", pid);
-		fprintf(stderr, "gpg timed out after %d seconds, aborting\n",
-				timeout);
-		if (kill(pid, SIGINT) != 0) {
-			err(EXIT_FAILURE, "set_pid_timeout child kill");
+		now = now_ms();
+		if (!timed_out && now >= deadline) {
+			debug("wait_child kill(%d, SIGINT)", pid);
+			if (kill(pid, SIGINT) != 0 && errno != ESRCH)
+				err(EXIT_FAILURE, "wait_child kill(%d)", pid);
+			timed_out = true;
+			deadline = now + KILL_GRACE_MS;
+		} else if (timed_out && !killed && now >= deadline) {
+			debug("wait_child kill(%d, SIGKILL)", pid);
+			if (kill(pid, SIGKILL) != 0 && errno != ESRCH)
+				err(EXIT_FAILURE, "wait_child kill(%d)", pid);
+			killed = true;
 		}
-		/* Avoid atexit() to run on the child. */
-		_Exit(0);
 
-		/* NOTREACHED */
-
-	default:
-		/* Parent process. NOP'ing. */
-		break;
+		/* Once killed, only the exit status is left to collect. */
+		left = killed ? -1 : deadline - now;
+
+		if (pfd.fd != -1) {
+			if (left > INT_MAX)
+				left = INT_MAX;
+			if (poll(&pfd, 1, (int)left) == -1 && errno != EINTR)
+				err(EXIT_FAILURE, "wait_child poll()");
+		} else {
+			if (left == -1 || left > delay)
+				left = delay;
+			poll(NULL, 0, (int)left);
+			if (delay < 100)
+				delay *= 2;
+		}
 	}
 
-	debug("set_pid_timeout parent pid=%d, watcher pid=%d", getpid(),
-			watcher_pid);
+	if (pfd.fd != -1)
+		close(pfd.fd);
+
+	return (timed_out);
+}
+
+
+/*
+ * Block SIGPIPE in the calling thread while it writes to a pipe whose reader
+ * might be gone, the write then fails with EPIPE. The previous mask is kept
+ * in saved for sigpipe_restore().
+ *
+ * The disposition of SIGPIPE is left alone: ignoring it would be inherited
+ * by every child, the editor and the storage commands included.
+ */
+void
+sigpipe_block(sigset_t *saved)
+{
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, saved);
+}
+
+
+/*
+ * Discard the SIGPIPE raised while it was blocked (if any) and restore the
+ * mask saved by sigpipe_block().
+ */
+void
+sigpipe_restore(const sigset_t *saved)
+{
+	sigset_t set, pending;
+	int sig;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+
+	if (!sigismember(saved, SIGPIPE) && sigpending(&pending) == 0 &&
+			sigismember(&pending, SIGPIPE))
+		sigwait(&set, &sig);
+
+	pthread_sigmask(SIG_SETMASK, saved, NULL);
 }
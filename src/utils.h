@@ -17,13 +17,24 @@
 #ifndef _UTILS_H_
 #define _UTILS_H_
 
+#include <sys/types.h>
+
+#include <signal.h>
 #include <stdbool.h>
 
+/* Time given to an interrupted child before it is killed (SIGKILL). */
+#define KILL_GRACE_MS	2000
+
 char		*xdirname(const char *);
 char		*get_home(void);
 char		*join_path(const char *, const char *);
 bool		 file_exists(const char *);
-void		 cancel_pid_timeout(void);
-void		 set_pid_timeout(pid_t, int);
+ssize_t		 read_full(int, void *, size_t);
+bool		 write_full(int, const void *, size_t);
+double		 log2_approx(double);
+long long	 now_ms(void);
+bool		 wait_child(pid_t, int *, long long);
+void		 sigpipe_block(sigset_t *);
+void		 sigpipe_restore(const sigset_t *);
 
 #endif /* _UTILS_H_ */
@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Word lists for passphrases.
+ *
+ * A text word list (one word per line, diceware style "11111 word" lines are
+ * fine, the last field is used) is compiled the first time it is used into
+ * an image of sorted and unique words with an offset table (see wordlist.h).
+ * The image is saved in the configuration directory and later runs only map
+ * it, unless it was made from another file (path and inode) or the text file
+ * changed size or modification time (to the nanosecond) since.
+ *
+ * Syllable sets and character sets are turned into the same in-memory image
+ * so profile.c only ever deals with a list of tokens.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "crc.h"
+#include "debug.h"
+#include "utils.h"
+#include "wordlist.h"
+#include "xmalloc.h"
+
+
+struct token {
+	const char	*s;
+	size_t		 len;
+};
+
+ARRAY_DECL(token_list, struct token);
+
+
+/* Compiled word lists are kept here, nothing is cached if NULL. */
+char *wordlist_cache_dir = NULL;
+
+
+static uint32_t
+load32_le(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+	    (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+
+static uint64_t
+load64_le(const uint8_t *p)
+{
+	return ((uint64_t)load32_le(p) | (uint64_t)load32_le(p + 4) << 32);
+}
+
+
+static void
+store32_le(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+
+static void
+store64_le(uint8_t *p, uint64_t v)
+{
+	store32_le(p, v);
+	store32_le(p + 4, v >> 32);
+}
+
+
+static int
+token_compare(const void *a, const void *b)
+{
+	const struct token *ta = a, *tb = b;
+	int cmp;
+
+	cmp = memcmp(ta->s, tb->s, ta->len < tb->len ? ta->len : tb->len);
+	if (cmp != 0)
+		return (cmp);
+
+	return ((ta->len > tb->len) - (ta->len < tb->len));
+}
+
+
+/*
+ * Check the header and offset table of wl->data and point the rest of the
+ * structure at it. The offsets are checked again on access.
+ */
+static bool
+wordlist_attach(struct wordlist *wl)
+{
+	size_t table, start;
+
+	if (wl->length < WORDLIST_HEADER_LENGTH ||
+	    memcmp(wl->data, WORDLIST_MAGIC, WORDLIST_MAGIC_LENGTH) != 0)
+		return (false);
+
+	wl->count = load32_le(wl->data + 8);
+	wl->max_length = load32_le(wl->data + 12);
+	wl->path_length = load32_le(wl->data + 44);
+	if (wl->path_length > wl->length - WORDLIST_HEADER_LENGTH)
+		return (false);
+
+	start = WORDLIST_HEADER_LENGTH + wl->path_length;
+	table = ((size_t)wl->count + 1) * 4;
+	if (wl->count == 0 || wl->max_length > WORDLIST_WORD_MAX ||
+	    table > wl->length - start)
+		return (false);
+
+	wl->path = wl->data + WORDLIST_HEADER_LENGTH;
+	wl->offsets = wl->data + start;
+	wl->strings = wl->offsets + table;
+	wl->strings_length = wl->length - start - table;
+	if (load32_le(wl->offsets + wl->count * 4) != wl->strings_length)
+		return (false);
+
+	return (true);
+}
+
+
+/*
+ * Build the image of a list of tokens. With unique, the tokens are sorted and
+ * duplicates removed, otherwise they are kept as is (a character set may
+ * repeat characters on purpose to weigh them). The source file, if any, is
+ * recorded in the header with its resolved path.
+ */
+static struct wordlist *
+wordlist_build(struct token_list *tokens, bool unique, const char *path,
+    const struct stat *sb)
+{
+	struct wordlist *wl;
+	unsigned int count = 0;
+	size_t strings = 0, pos, path_length = 0, table;
+	uint32_t max_length = 0;
+	struct token *t;
+
+	if (unique && ARRAY_LENGTH(tokens) > 0) {
+		qsort(ARRAY_DATA(tokens), ARRAY_LENGTH(tokens),
+		    sizeof(struct token), token_compare);
+	}
+
+	for (unsigned int i = 0; i < ARRAY_LENGTH(tokens); i++) {
+		t = &ARRAY_ITEM(tokens, i);
+		if (unique && count > 0 &&
+		    token_compare(t, &ARRAY_ITEM(tokens, count - 1)) == 0)
+			continue;
+		ARRAY_ITEM(tokens, count++) = *t;
+		strings += t->len;
+		if (t->len > max_length)
+			max_length = t->len;
+	}
+
+	if (path != NULL)
+		path_length = strlen(path);
+	if (count == 0 || strings > UINT32_MAX || path_length > UINT32_MAX)
+		return (NULL);
+
+	wl = xcalloc(1, sizeof(struct wordlist));
+	wl->unique = unique;
+	table = WORDLIST_HEADER_LENGTH + path_length;
+	pos = table + ((size_t)count + 1) * 4;
+	wl->length = pos + strings;
+	wl->data = xcalloc(1, wl->length);
+
+	memcpy(wl->data, WORDLIST_MAGIC, WORDLIST_MAGIC_LENGTH);
+	store32_le(wl->data + 8, count);
+	store32_le(wl->data + 12, max_length);
+	if (sb != NULL) {
+		store64_le(wl->data + 16, sb->st_size);
+		store64_le(wl->data + 24, sb->st_mtim.tv_sec);
+		store64_le(wl->data + 32, sb->st_ino);
+		store32_le(wl->data + 40, sb->st_mtim.tv_nsec);
+	}
+	store32_le(wl->data + 44, path_length);
+	if (path_length > 0)
+		memcpy(wl->data + WORDLIST_HEADER_LENGTH, path, path_length);
+
+	strings = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		t = &ARRAY_ITEM(tokens, i);
+		store32_le(wl->data + table + i * 4, strings);
+		memcpy(wl->data + pos + strings, t->s, t->len);
+		strings += t->len;
+	}
+	store32_le(wl->data + table + count * 4, strings);
+
+	if (!wordlist_attach(wl))
+		errx(EXIT_FAILURE, "wordlist_build: invalid image");
+
+	return (wl);
+}
+
+
+/*
+ * Read a text word list: the last field of each line is a word, blank lines
+ * and lines starting with '#' are skipped.
+ */
+static struct wordlist *
+wordlist_compile(const char *path, struct stat *sb)
+{
+	struct token_list tokens = ARRAY_INITIALIZER;
+	struct wordlist *wl;
+	struct token t;
+	char *text, *line, *end, *p;
+	ssize_t len;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		err(EXIT_FAILURE, "word_list %s", path);
+	if (fstat(fd, sb) == -1)
+		err(EXIT_FAILURE, "word_list %s", path);
+	if (sb->st_size <= 0 || sb->st_size > INT32_MAX)
+		errx(EXIT_FAILURE, "word_list %s: bad size", path);
+
+	text = xmalloc(sb->st_size + 1);
+	len = read_full(fd, text, sb->st_size);
+	close(fd);
+	if (len != sb->st_size)
+		err(EXIT_FAILURE, "word_list %s", path);
+	text[len] = '\n';
+
+	for (line = text; line < text + len; line = end + 1) {
+		end = memchr(line, '\n', text + len + 1 - line);
+
+		/* Trim, then keep the last field. */
+		p = end;
+		while (p > line && (p[-1] == ' ' || p[-1] == '\t' ||
+		    p[-1] == '\r'))
+			p--;
+		t.len = 0;
+		while (p > line && p[-1] != ' ' && p[-1] != '\t') {
+			p--;
+			t.len++;
+		}
+		t.s = p;
+
+		if (t.len == 0 || *line == '#')
+			continue;
+		if (t.len > WORDLIST_WORD_MAX)
+			errx(EXIT_FAILURE, "word_list %s: word too long", path);
+
+		ARRAY_ADD(&tokens, t);
+	}
+
+	wl = wordlist_build(&tokens, true, path, sb);
+	if (wl == NULL)
+		errx(EXIT_FAILURE, "word_list %s: no words", path);
+
+	if (ARRAY_DATA(&tokens) != NULL)
+		xfree(ARRAY_DATA(&tokens));
+	xfree(text);
+
+	return (wl);
+}
+
+
+/*
+ * Name of the compiled image of the given text word list. Two paths may
+ * share a name, the image records which one it was made from.
+ */
+static char *
+wordlist_cache_path(const char *path)
+{
+	struct crc_ctx crc;
+	char name[32];
+
+	crc_init(&crc);
+	crc_update(&crc, path, strlen(path));
+	snprintf(name, sizeof(name), "words-%08x", crc_final(&crc));
+
+	return (join_path(wordlist_cache_dir, name));
+}
+
+
+/*
+ * Map a compiled word list if it was made from the file at path described by
+ * sb.
+ */
+static struct wordlist *
+wordlist_map(const char *cache, const char *path, const struct stat *sb)
+{
+	struct wordlist *wl;
+	struct stat csb;
+	void *map;
+	int fd;
+
+	if ((fd = open(cache, O_RDONLY)) == -1)
+		return (NULL);
+	if (fstat(fd, &csb) == -1 || csb.st_size < WORDLIST_HEADER_LENGTH) {
+		close(fd);
+		return (NULL);
+	}
+
+	map = mmap(NULL, csb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return (NULL);
+
+	wl = xcalloc(1, sizeof(struct wordlist));
+	wl->data = map;
+	wl->length = csb.st_size;
+	wl->mapped = true;
+	wl->unique = true;
+
+	if (!wordlist_attach(wl) ||
+	    load64_le(wl->data + 16) != (uint64_t)sb->st_size ||
+	    load64_le(wl->data + 24) != (uint64_t)sb->st_mtim.tv_sec ||
+	    load64_le(wl->data + 32) != (uint64_t)sb->st_ino ||
+	    load32_le(wl->data + 40) != (uint32_t)sb->st_mtim.tv_nsec ||
+	    wl->path_length != strlen(path) ||
+	    memcmp(wl->path, path, wl->path_length) != 0) {
+		wordlist_free(wl);
+		return (NULL);
+	}
+
+	return (wl);
+}
+
+
+/*
+ * Save a compiled word list, failing silently since it is only a cache.
+ */
+static void
+wordlist_save(const char *cache, struct wordlist *wl)
+{
+	char *tmp;
+	int fd;
+
+	tmp = join_path(wordlist_cache_dir, "words.XXXXXX");
+	if ((fd = mkstemp(tmp)) == -1) {
+		debug("wordlist_save mkstemp failed");
+		xfree(tmp);
+		return;
+	}
+
+	if (!write_full(fd, wl->data, wl->length) || close(fd) != 0 ||
+	    rename(tmp, cache) != 0) {
+		debug("wordlist_save %s failed", cache);
+		unlink(tmp);
+	}
+
+	xfree(tmp);
+}
+
+
+/*
+ * Load the word list at path, from its compiled image if it is up to date.
+ * The path is resolved first so the same file is found from any directory.
+ */
+struct wordlist *
+wordlist_open(const char *path)
+{
+	struct wordlist *wl;
+	struct stat sb;
+	char *cache = NULL, *real;
+
+	if ((real = realpath(path, NULL)) == NULL ||
+	    stat(real, &sb) == -1)
+		err(EXIT_FAILURE, "word_list %s", path);
+
+	if (wordlist_cache_dir != NULL) {
+		cache = wordlist_cache_path(real);
+		if ((wl = wordlist_map(cache, real, &sb)) != NULL) {
+			debug("wordlist_open %s mapped from %s", path, cache);
+			xfree(cache);
+			free(real);
+			return (wl);
+		}
+	}
+
+	wl = wordlist_compile(real, &sb);
+	debug("wordlist_open %s compiled, %u words", path, wl->count);
+
+	if (cache != NULL) {
+		wordlist_save(cache, wl);
+		xfree(cache);
+	}
+	free(real);
+
+	return (wl);
+}
+
+
+/*
+ * Syllables are separated by dashes, e.g. "ac-set-po-tru-ka-ret-1-2-3".
+ */
+struct wordlist *
+wordlist_from_syllables(const char *spec)
+{
+	struct token_list tokens = ARRAY_INITIALIZER;
+	struct wordlist *wl;
+	struct token t;
+	const char *p;
+
+	for (p = spec; ; p++) {
+		if (*p != '-' && *p != '\0')
+			continue;
+		t.s = spec;
+		t.len = p - spec;
+		if (t.len > WORDLIST_WORD_MAX)
+			errx(EXIT_FAILURE, "syllable_set: syllable too long");
+		if (t.len > 0)
+			ARRAY_ADD(&tokens, t);
+		if (*p == '\0')
+			break;
+		spec = p + 1;
+	}
+
+	wl = wordlist_build(&tokens, true, NULL, NULL);
+
+	if (ARRAY_DATA(&tokens) != NULL)
+		xfree(ARRAY_DATA(&tokens));
+
+	return (wl);
+}
+
+
+/*
+ * Each character of the set, in the locale's encoding, is a token. Returns
+ * NULL if a character can't be represented.
+ */
+struct wordlist *
+wordlist_from_wcs(const wchar_t *set)
+{
+	struct token_list tokens = ARRAY_INITIALIZER;
+	struct wordlist *wl = NULL;
+	struct token t;
+	size_t setlen = wcslen(set);
+	mbstate_t ps;
+	char *encoded;
+
+	encoded = xcalloc(setlen + 1, MB_LEN_MAX);
+	memset(&ps, 0, sizeof(ps));
+
+	for (size_t i = 0; i < setlen; i++) {
+		t.s = encoded + i * MB_LEN_MAX;
+		t.len = wcrtomb(encoded + i * MB_LEN_MAX, set[i], &ps);
+		if (t.len == (size_t)-1)
+			goto out;
+		ARRAY_ADD(&tokens, t);
+	}
+
+	wl = wordlist_build(&tokens, false, NULL, NULL);
+
+out:
+	if (ARRAY_DATA(&tokens) != NULL)
+		xfree(ARRAY_DATA(&tokens));
+	xfree(encoded);
+
+	return (wl);
+}
+
+
+/*
+ * Return token i (not NUL terminated) and store its length in len.
+ */
+const char *
+wordlist_get(struct wordlist *wl, uint32_t i, size_t *len)
+{
+	uint32_t start, end;
+
+	if (i >= wl->count)
+		errx(EXIT_FAILURE, "wordlist_get: out of range");
+
+	start = load32_le(wl->offsets + i * 4);
+	end = load32_le(wl->offsets + i * 4 + 4);
+	if (start > end || end > wl->strings_length ||
+	    end - start > wl->max_length)
+		errx(EXIT_FAILURE, "wordlist_get: corrupted word list");
+
+	*len = end - start;
+
+	return ((const char *)wl->strings + start);
+}
+
+
+/*
+ * Bits of entropy of count tokens drawn uniformly from the list, counting
+ * distinct tokens only. This is an upper bound for syllables since two
+ * sequences may spell the same password.
+ */
+double
+wordlist_entropy(struct wordlist *wl, unsigned int count)
+{
+	const char *a, *b;
+	size_t alen, blen;
+	uint32_t distinct = wl->count;
+
+	/* Only character sets may repeat tokens, they are short. */
+	for (uint32_t i = 1; !wl->unique && i < wl->count; i++) {
+		a = wordlist_get(wl, i, &alen);
+		for (uint32_t j = 0; j < i; j++) {
+			b = wordlist_get(wl, j, &blen);
+			if (alen == blen && memcmp(a, b, alen) == 0) {
+				distinct--;
+				break;
+			}
+		}
+	}
+
+	return (log2_approx(distinct) * count);
+}
+
+
+void
+wordlist_free(struct wordlist *wl)
+{
+	if (wl == NULL)
+		return;
+
+	if (wl->mapped)
+		munmap(wl->data, wl->length);
+	else
+		xfree(wl->data);
+	xfree(wl);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2015 Bertrand Janin <b@janin.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _WORDLIST_H_
+#define _WORDLIST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#define WORDLIST_MAGIC		"mdpwrds2"
+#define WORDLIST_MAGIC_LENGTH	8
+#define WORDLIST_HEADER_LENGTH	48
+#define WORDLIST_WORD_MAX	255
+
+/*
+ * A list of tokens (words, syllables or characters) passwords are made of.
+ *
+ * The image is the same in memory and in a compiled word list file:
+ *
+ *     magic       8 bytes, "mdpwrds2"
+ *     count       4 bytes, number of tokens
+ *     max_length  4 bytes, length of the longest token
+ *     size        8 bytes, size of the source text file
+ *     mtime       8 bytes, modification time of the source text file
+ *     ino         8 bytes, inode of the source text file
+ *     mtime_nsec  4 bytes, nanoseconds of the modification time
+ *     path_length 4 bytes, length of path
+ *     path        the resolved path of the source text file, not terminated
+ *     offsets     (count + 1) * 4 bytes, start of each token in strings
+ *     strings     the tokens, packed without separators
+ *
+ * All integers are little-endian. The source fields are zero and the path
+ * empty for lists built in memory.
+ */
+struct wordlist {
+	uint8_t		*data;
+	size_t		 length;
+	bool		 mapped;
+	bool		 unique;
+	uint32_t	 count;
+	uint32_t	 max_length;
+	const uint8_t	*path;
+	size_t		 path_length;
+	const uint8_t	*offsets;
+	const uint8_t	*strings;
+	size_t		 strings_length;
+};
+
+extern char		*wordlist_cache_dir;
+
+struct wordlist	*wordlist_open(const char *);
+struct wordlist	*wordlist_from_syllables(const char *);
+struct wordlist	*wordlist_from_wcs(const wchar_t *);
+const char	*wordlist_get(struct wordlist *, uint32_t, size_t *);
+double		 wordlist_entropy(struct wordlist *, unsigned int);
+void		 wordlist_free(struct wordlist *);
+
+#endif /* _WORDLIST_H_ */
@@ -96,8 +96,19 @@ cleanup() {
 	# Fake mdp home.
 	rm -f fake_gpg_home/.mdp/passwords
 	rm -f fake_gpg_home/.mdp/passwords.bak
+	rm -f fake_gpg_home/.mdp/passwords.1
+	rm -f fake_gpg_home/.mdp/passwords.2
+	rm -f fake_gpg_home/.mdp/passwords.3
+	rm -f fake_gpg_home/.mdp/agent
+	rm -f fake_gpg_home/.mdp/lock
+	rm -f fake_gpg_home/.mdp/key
 	rm -f fake_gpg_home/.mdp/alternative
 	rm -f fake_gpg_home/.mdp/alternative.bak
+	rm -f fake_gpg_home/.mdp/passwords.conflict
+	rm -f fake_gpg_home/.mdp/passwords.push
+	rm -f fake_gpg_home/.mdp/remote
+	rm -f fake_gpg_home/.mdp/words-*
+	rm -rf fake_gpg_home/.mdp/passwords.d
 	rmdir fake_gpg_home/.mdp
 
 	# GnuPG stuff, hopefully it doesn't vary by OS too much.
@@ -24,6 +24,21 @@ rat grey
 EOF
 }
 
+# A password on a line with more fields than most.
+long() {
+	line="long"
+	for i in `seq 1 200`; do
+		line="$line f$i"
+	done
+	echo "$line" > $filename
+}
+
+# Passwords with characters outside of ASCII (UTF-8).
+unicode() {
+	printf 'caf\303\251 "cr\303\250me"\n' > $filename
+	printf 'smile \342\202\254\360\237\230\200\n' >> $filename
+}
+
 # Simulates an editor writing one password and taking 2 seconds to do so.
 slow() {
 cat > $filename << EOF
@@ -32,6 +47,19 @@ EOF
 sleep 2
 }
 
+# Simulates an editor adding a password to the given results, slowly.
+slow_append() {
+sleep 2
+echo "kiwi green" >> $filename
+}
+
+# Simulates an editor changing a password of the given results, slowly.
+slow_change() {
+sleep 2
+content=`sed 's/^raspberry red$/raspberry pink/' $filename`
+echo "$content" > $filename
+}
+
 # Simulate an editor doing nothing from the given results.
 nop() {
 	true
@@ -41,9 +69,21 @@ case $mode in
 	alt)
 		alt
 		;;
+	long)
+		long
+		;;
+	unicode)
+		unicode
+		;;
 	slow)
 		slow
 		;;
+	slow_append)
+		slow_append
+		;;
+	slow_change)
+		slow_change
+		;;
 	nop)
 		nop
 		;;
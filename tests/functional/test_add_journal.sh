@@ -0,0 +1,37 @@
+# Add passwords to the journal and fold them back with compact.
+
+# Create the initial file.
+use_config simple
+run_mdp edit
+
+# Add the passwords in a journal segment.
+use_config nop
+echo "set journal on" >> test.config
+run_mdp add -l 16 -n 2 my prefix
+
+if [ ! -f "${passfile}.1" ]; then
+	echo "no journal segment"
+fi
+
+run_mdp compact
+
+if [ -f "${passfile}.1" ]; then
+	echo "journal segment not removed"
+fi
+
+# Dump everything, replacing the passwords by dots
+dump_password_file \
+	| sed 's/	[a-zA-Z0-9]\{16\}/	................/' \
+	> test.stdout
+
+cat > test.expected << EOF
+# my passwords
+strawberry red
+raspberry red
+blackberry black
+grapefruit yellow
+my prefix	................
+my prefix	................
+EOF
+
+assert_stdout
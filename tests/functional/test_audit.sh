@@ -0,0 +1,17 @@
+# Report reused and weak passwords without showing them.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+echo 'kT9#xLq2!vRz8mWp' | run_mdp set -v - grape > /dev/null
+run_mdp audit > test.stdout
+
+cat > test.expected << EOF2
+lines 2, 3: same password
+line 2: weak password (14 bits)
+line 3: weak password (14 bits)
+line 4: weak password (24 bits)
+EOF2
+
+assert_stdout
@@ -0,0 +1,28 @@
+# Save the password file as a container of blocks, the backup shares them.
+
+rm -f $passfile
+
+use_config simple
+echo "set backend chunked" >> test.config
+run_mdp edit
+
+use_config alt
+echo "set backend chunked" >> test.config
+run_mdp edit
+
+# One block for each version of the file.
+if [ "`ls ${passfile}.d | wc -l`" -ne 2 ]; then
+	echo "unexpected blocks: `ls ${passfile}.d`"
+fi
+
+run_mdp get -o tsv -f 1 -E . \
+	> test.stdout
+
+cat > test.expected << EOF
+tiger
+cat
+dog
+rat
+EOF
+
+assert_stdout
@@ -0,0 +1,43 @@
+# Conflicting changes saved during an edit: the edit isn't saved but kept
+# in a conflict file.
+
+use_config simple
+run_mdp edit
+
+use_config slow_change
+run_mdp_capture_stderr edit > test.stdout &
+
+sleep 0.5
+
+use_config nop
+echo "set lock_timeout 0" >> test.config
+echo hunter2 | run_mdp set -v - rasp > /dev/null
+
+wait
+
+if ! grep -q "1 conflict(s), nothing saved" test.stdout; then
+	echo "conflict not reported"
+	return
+fi
+
+dump_password_file > test.stdout
+$GPG -q -d $passfile.conflict >> test.stdout
+
+cat > test.expected << EOF
+# my passwords
+strawberry red
+raspberry hunter2
+blackberry black
+grapefruit yellow
+# my passwords
+strawberry red
+<<<<<<< yours
+raspberry pink
+=======
+raspberry hunter2
+>>>>>>> saved meanwhile
+blackberry black
+grapefruit yellow
+EOF
+
+assert_stdout
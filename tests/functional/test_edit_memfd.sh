@@ -0,0 +1,15 @@
+# Edit the passwords through a memfd, falling back if it isn't available.
+
+use_config simple
+echo "set edit_storage memfd" >> test.config
+run_mdp edit
+
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+raspberry red
+blackberry black
+EOF
+
+assert_stdout
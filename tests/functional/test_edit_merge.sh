@@ -0,0 +1,29 @@
+# Changes saved during an edit are merged with it.
+
+use_config simple
+run_mdp edit
+
+use_config slow_append
+run_mdp_capture_stderr edit > /dev/null &
+
+sleep 0.5
+
+# The edit doesn't hold the lock, this doesn't wait.
+use_config nop
+echo "set lock_timeout 0" >> test.config
+echo hunter2 | run_mdp set -v - rasp > /dev/null
+
+wait
+
+dump_password_file > test.stdout
+
+cat > test.expected << EOF
+# my passwords
+strawberry red
+raspberry hunter2
+blackberry black
+grapefruit yellow
+kiwi green
+EOF
+
+assert_stdout
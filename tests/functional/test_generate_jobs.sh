@@ -0,0 +1,9 @@
+# Test generating many passwords split among threads
+
+use_config simple
+
+run_mdp generate -n 10000 -l 12 -j 4 > test.stdout
+
+if [ "`get_lines_and_bytes test.stdout`" = "10000 130000" ]; then
+	echo pass
+fi
@@ -0,0 +1,12 @@
+# Test that a job count with garbage or out of range is refused.
+
+use_config simple
+
+for jobs in abc 3x 0 65 4294967297; do
+	if run_mdp generate -n 3 -j $jobs > /dev/null; then
+		echo "accepted -j $jobs"
+		return
+	fi
+done
+
+echo pass
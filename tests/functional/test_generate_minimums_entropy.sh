@@ -0,0 +1,19 @@
+# Test that the characters forced by the minimums count for their class only.
+
+use_config simple
+cat >> test.config << EOF2
+profile strict
+  set character_set "ab01"
+  set character_count 4
+  set password_count 1
+  set minimum_digits 2
+EOF2
+
+run_mdp generate -p strict -e > /dev/null
+echo "`cat test.stderr`" > test.stdout
+
+cat > test.expected << EOF2
+6.0 bits
+EOF2
+
+assert_stdout
@@ -0,0 +1,21 @@
+# Test generating passwords with character class minimums and exclusions.
+
+use_config simple
+cat >> test.config << EOF2
+profile strict
+  set character_set \$ALPHANUMERIC
+  set excluded_characters \$AMBIGUOUS
+  set character_count 6
+  set password_count 200
+  set minimum_digits 3
+  set minimum_uppercase 2
+EOF2
+
+run_mdp generate -p strict > test.tmp
+
+grep '[0-9].*[0-9].*[0-9]' test.tmp | grep '[A-Z].*[A-Z]' \
+	| grep -v '[Il1O0o]' > test.stdout
+rm -f test.tmp
+if [ "`get_lines_and_bytes`" = "200 1400" ]; then
+	echo pass
+fi
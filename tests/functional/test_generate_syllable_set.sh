@@ -0,0 +1,18 @@
+# Test generating passwords from a set of syllables.
+
+use_config simple
+cat >> test.config << EOF2
+set syllable_set ka-ret-po
+set word_count 5
+EOF2
+
+run_mdp generate -n 2 \
+	| sed -E 's/(ka|ret|po)/./g' \
+	> test.stdout
+
+cat > test.expected << EOF2
+.....
+.....
+EOF2
+
+assert_stdout
@@ -0,0 +1,32 @@
+# Test generating passphrases from a word list, twice to use its compiled copy.
+
+use_config simple
+cat >> test.config << EOF2
+profile words
+  set word_list test.words
+  set word_count 4
+  set word_separator "-"
+  set password_count 3
+EOF2
+
+cat > test.words << EOF2
+11111	apple
+11112	banana
+11113	cherry
+EOF2
+
+run_mdp generate -p words > /dev/null
+run_mdp generate -p words -e \
+	| sed -E 's/(apple|banana|cherry)/w/g' \
+	> test.stdout
+rm -f test.words
+
+cat > test.expected << EOF2
+w-w-w-w
+w-w-w-w
+w-w-w-w
+EOF2
+
+if [ "`cat test.stderr`" = "6.3 bits" ]; then
+	assert_stdout
+fi
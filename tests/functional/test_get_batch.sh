@@ -0,0 +1,19 @@
+# Run a batch of queries from stdin, matches are tagged with the query line.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+run_mdp get -b - > test.stdout << EOF
+berry black
+
+red
+EOF
+
+cat > test.expected << EOF
+1	blackberry black
+3	strawberry red
+3	raspberry red
+EOF
+
+assert_stdout
@@ -0,0 +1,25 @@
+# Batch queries with short, upper-case and commented keywords match like
+# single searches.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+run_mdp get -b - > test.stdout << EOF
+rr
+BERRY RED
+ry re
+my
+EOF
+
+cat > test.expected << EOF
+1	strawberry red
+1	raspberry red
+1	blackberry black
+2	strawberry red
+2	raspberry red
+3	strawberry red
+3	raspberry red
+EOF
+
+assert_stdout
@@ -0,0 +1,14 @@
+# The last field of a line with hundreds of them is still the last one.
+
+use_config long
+run_mdp edit
+
+run_mdp get -f -1 long > test.stdout
+run_mdp get -f 150 long >> test.stdout
+
+cat > test.expected << EOF
+f200
+f149
+EOF
+
+assert_stdout
@@ -0,0 +1,15 @@
+# Output the last field of the matches as JSON lines.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+run_mdp get -o json -f -1 berry > test.stdout
+
+cat > test.expected << EOF
+{"fields":["red"]}
+{"fields":["red"]}
+{"fields":["black"]}
+EOF
+
+assert_stdout
@@ -0,0 +1,19 @@
+# JSON output escapes everything outside of ASCII, it is valid UTF-8 whatever
+# the locale.
+
+# Assume UTF-8 locale for this, if you use international characters without
+# UTF-8, feel free to fix or file a bug report.
+export LANG=en_US.UTF-8
+export LC_ALL=$LANG
+
+use_config unicode
+run_mdp edit
+
+run_mdp get -o json -E . > test.stdout
+
+cat > test.expected << 'EOF'
+{"fields":["caf\u00e9","\"cr\u00e8me\""]}
+{"fields":["smile","\u20ac\ud83d\ude00"]}
+EOF
+
+assert_stdout
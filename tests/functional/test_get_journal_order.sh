@@ -0,0 +1,33 @@
+# Read a password file with several journal segments, decrypted at once.
+
+# Create the initial file.
+use_config simple
+run_mdp edit
+
+# One segment per add.
+use_config nop
+echo "set journal on" >> test.config
+echo "set gpg_jobs 2" >> test.config
+run_mdp add -l 16 -n 1 first
+run_mdp add -l 16 -n 1 second
+run_mdp add -l 16 -n 1 third
+
+if [ ! -f "${passfile}.3" ]; then
+	echo "missing journal segments"
+fi
+
+# All the lines come back in the order they were added.
+run_mdp get -o tsv -f 1 -E . \
+	> test.stdout
+
+cat > test.expected << EOF
+strawberry
+raspberry
+blackberry
+grapefruit
+first
+second
+third
+EOF
+
+assert_stdout
@@ -0,0 +1,24 @@
+# Decrypt the password file twice, the second time with the cached session key.
+
+# Create the initial file.
+use_config simple
+run_mdp edit
+
+use_config nop
+echo "set session_cache 2" >> test.config
+
+run_mdp get -r red > test.stdout
+if [ ! -S "fake_gpg_home/.mdp/agent" ]; then
+	echo "no agent running"
+fi
+
+run_mdp get -r red >> test.stdout
+
+cat > test.expected << EOF
+strawberry red
+raspberry red
+strawberry red
+raspberry red
+EOF
+
+assert_stdout
@@ -0,0 +1,51 @@
+# A compaction interrupted after its rename doesn't read the segments twice.
+
+# Create the initial file.
+use_config simple
+run_mdp edit
+
+# Two segments, kept aside to put them back after the compaction.
+use_config nop
+echo "set journal on" >> test.config
+run_mdp add -l 16 -n 1 first
+run_mdp add -l 16 -n 1 second
+cp ${passfile}.1 ${passfile}.1.saved
+cp ${passfile}.2 ${passfile}.2.saved
+
+run_mdp compact
+
+# Simulate an interruption after the rename, before the segments are gone:
+# the marker names the new password file and its last segment.
+mv ${passfile}.1.saved ${passfile}.1
+mv ${passfile}.2.saved ${passfile}.2
+inode=`ls -i ${passfile} | awk '{ print $1 }'`
+size=`wc -c < ${passfile} | tr -d ' '`
+echo "2 $inode $size" > ${passfile}.folded
+
+run_mdp get -o tsv -f 1 -E . > test.stdout
+
+# The next segment finishes the removal.
+run_mdp add -l 16 -n 1 third
+run_mdp get -o tsv -f 1 -E . >> test.stdout
+
+if [ -f "${passfile}.2" -o -f "${passfile}.folded" ]; then
+	echo "folded segments not removed"
+fi
+
+cat > test.expected << EOF
+strawberry
+raspberry
+blackberry
+grapefruit
+first
+second
+strawberry
+raspberry
+blackberry
+grapefruit
+first
+second
+third
+EOF
+
+assert_stdout
@@ -0,0 +1,24 @@
+# A fold marker naming another password file (a save that never got to its
+# rename) is ignored.
+
+# Create the initial file.
+use_config simple
+run_mdp edit
+
+use_config nop
+echo "set journal on" >> test.config
+run_mdp add -l 16 -n 1 first
+
+echo "1 1 1" > ${passfile}.folded
+
+run_mdp get -o tsv -f 1 -E . > test.stdout
+
+cat > test.expected << EOF
+strawberry
+raspberry
+blackberry
+grapefruit
+first
+EOF
+
+assert_stdout
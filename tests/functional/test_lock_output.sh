@@ -2,13 +2,19 @@
 
 set +e
 
-use_config slow
+use_config simple
+run_mdp edit
 
-run_mdp edit > /dev/null &
+# A slow fetch from the remote copy keeps the lock for a while.
+use_config nop
+echo "set storage_get_command \"sleep 2\"" >> test.config
+echo pink | run_mdp set -v - raspberry > /dev/null &
 
-sleep 0.1
+sleep 0.5
 
-run_mdp edit
+use_config nop
+echo "set lock_timeout 0" >> test.config
+echo blue | run_mdp set -v - roses
 
 echo "mdp: locked (fake_gpg_home/.mdp/lock)" > test.expected
 
@@ -1,12 +1,18 @@
 # Make sure the locks works properly (mdp returns non-0).
 
-use_config slow
+use_config simple
+run_mdp edit
 
-run_mdp edit > /dev/null &
+# A slow fetch from the remote copy keeps the lock for a while.
+use_config nop
+echo "set storage_get_command \"sleep 2\"" >> test.config
+echo pink | run_mdp set -v - raspberry > /dev/null &
 
-sleep 0.1
+sleep 0.5
 
-if ! run_mdp edit > /dev/null; then
+use_config nop
+echo "set lock_timeout 0" >> test.config
+if ! echo blue | run_mdp set -v - roses > /dev/null; then
 	echo pass
 fi
 
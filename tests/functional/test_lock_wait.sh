@@ -0,0 +1,26 @@
+# A second command waits for the lock instead of failing right away.
+
+use_config simple
+run_mdp edit
+
+# A slow fetch from the remote copy keeps the lock for a while.
+use_config nop
+echo "set storage_get_command \"sleep 2\"" >> test.config
+echo pink | run_mdp set -v - raspberry > /dev/null &
+
+sleep 0.5
+
+use_config nop
+echo blue | run_mdp set -v - strawberry > /dev/null
+
+wait
+
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry blue
+raspberry pink
+blackberry black
+EOF
+
+assert_stdout
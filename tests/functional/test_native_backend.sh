@@ -0,0 +1,40 @@
+# Save the password file with the native backend and read it back.
+
+rm -f $passfile
+
+use_config simple
+echo "set backend native" >> test.config
+run_mdp edit
+
+if [ "`head -c 8 $passfile`" != "mdpaead1" ]; then
+	echo "not a native file"
+fi
+
+if [ ! -f "fake_gpg_home/.mdp/key" ]; then
+	echo "no key file"
+fi
+
+# The key file is only usable through gpg.
+if [ "`$GPG -q -d fake_gpg_home/.mdp/key | wc -c`" -ne 32 ]; then
+	echo "key file not encrypted with gpg"
+fi
+
+# A modified file is refused.
+cp $passfile test.diff
+printf 'x' >> $passfile
+if run_mdp get -o tsv -E . > /dev/null; then
+	echo "trailing data accepted"
+fi
+cp test.diff $passfile
+
+run_mdp get -o tsv -f 1 -E . \
+	> test.stdout
+
+cat > test.expected << EOF
+strawberry
+raspberry
+blackberry
+grapefruit
+EOF
+
+assert_stdout
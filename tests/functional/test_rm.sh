@@ -0,0 +1,15 @@
+# Remove one line without editor.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+run_mdp rm rasp
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+blackberry black
+EOF
+
+assert_stdout
@@ -0,0 +1,20 @@
+# Setting a password fails if the keywords match more than one line.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+if echo hunter2 | run_mdp set -v - berry; then
+	echo "fail (ambiguous query accepted)"
+	exit 1
+fi
+
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+raspberry red
+blackberry black
+EOF
+
+assert_stdout
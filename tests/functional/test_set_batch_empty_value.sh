@@ -0,0 +1,20 @@
+# A batch line with a tab but no value is an error, not a generated password.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+if printf 'straw\tpink\nrasp\t\n' | run_mdp set -b - > /dev/null; then
+	echo "fail (empty value accepted)"
+	exit 1
+fi
+
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+raspberry red
+blackberry black
+EOF
+
+assert_stdout
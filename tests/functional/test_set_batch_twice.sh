@@ -0,0 +1,27 @@
+# A batch changing the same line twice is refused, nothing is saved.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+if printf 'rasp\thunter2\nraspberry hunter2\tpink\n' \
+		| run_mdp replace -b - > /dev/null; then
+	echo "fail (second change to the same line accepted)"
+	exit 1
+fi
+
+if printf 'rasp\thunter2\nrasp\thunter3\n' \
+		| run_mdp set -b - > /dev/null; then
+	echo "fail (second change to the same line accepted)"
+	exit 1
+fi
+
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+raspberry red
+blackberry black
+EOF
+
+assert_stdout
@@ -0,0 +1,23 @@
+# Setting the password of a line with a single field would overwrite it all.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+echo lonely | run_mdp replace -t - rasp
+
+if echo hunter2 | run_mdp set -v - lonely > /dev/null; then
+	echo "fail (single field line accepted)"
+	exit 1
+fi
+
+run_mdp get -r -E . > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+lonely
+blackberry black
+grapefruit yellow
+EOF
+
+assert_stdout
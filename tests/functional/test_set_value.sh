@@ -0,0 +1,16 @@
+# Set the password of one line without editor.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+echo hunter2 | run_mdp set -v - rasp > /dev/null
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+raspberry hunter2
+blackberry black
+EOF
+
+assert_stdout
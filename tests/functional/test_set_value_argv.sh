@@ -0,0 +1,23 @@
+# A new password given on the command line is refused, it is read from stdin.
+
+# Populate the password file.
+use_config simple
+run_mdp edit
+
+if run_mdp set -v hunter2 rasp > /dev/null; then
+	echo "set accepted a password on the command line"
+	return
+fi
+if echo "red line" | run_mdp replace -t "red line" rasp > /dev/null; then
+	echo "replace accepted a line on the command line"
+	return
+fi
+run_mdp get -r berry > test.stdout
+
+cat > test.expected << EOF
+strawberry red
+raspberry red
+blackberry black
+EOF
+
+assert_stdout
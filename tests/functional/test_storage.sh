@@ -0,0 +1,63 @@
+# Push the password file to a remote copy and read it back from there.
+
+remote=fake_gpg_home/.mdp/remote
+
+use_storage() {
+	use_config $1
+	echo "set storage_get_command \"cp $remote %p\"" >> test.config
+	echo "set storage_put_command \"cp %p $remote\"" >> test.config
+}
+
+# Wait for a background push or refresh, at most 5 seconds.
+# $1 - shell condition
+wait_for() {
+	tries=0
+	until eval "$1"; do
+		tries=$(( tries + 1 ))
+		if [ $tries -gt 50 ]; then
+			echo "timed out waiting for: $1"
+			return 1
+		fi
+		sleep 0.1
+	done
+}
+
+# The first save is pushed in the background.
+rm -f $passfile $remote
+use_storage simple
+run_mdp edit
+wait_for "[ ! -f $passfile.push ] && cmp -s $passfile $remote" || return
+
+# Without a local copy, the first lookup waits for the fetch.
+rm -f $passfile
+use_storage nop
+run_mdp get -o tsv -f 1 -E . > test.stdout
+
+# Someone else changes the remote copy.
+use_config alt
+echo "set password_file $remote" >> test.config
+echo "set backup no" >> test.config
+run_mdp edit
+
+# The next lookup still reads the local copy, refreshed in the background.
+use_storage nop
+run_mdp get -o tsv -f 1 -E . >> test.stdout
+wait_for "cmp -s $passfile $remote" || return
+run_mdp get -o tsv -f 1 -E . >> test.stdout
+
+cat > test.expected << EOF2
+strawberry
+raspberry
+blackberry
+grapefruit
+strawberry
+raspberry
+blackberry
+grapefruit
+tiger
+cat
+dog
+rat
+EOF2
+
+assert_stdout
@@ -0,0 +1,34 @@
+# A save during a slow push is pushed as well, the marker stays until then.
+
+remote=fake_gpg_home/.mdp/remote
+
+# Wait for a background push, at most 10 seconds.
+# $1 - shell condition
+wait_for() {
+	tries=0
+	until eval "$1"; do
+		tries=$(( tries + 1 ))
+		if [ $tries -gt 100 ]; then
+			echo "timed out waiting for: $1"
+			return 1
+		fi
+		sleep 0.1
+	done
+}
+
+rm -f $passfile $remote
+use_config simple
+echo "set storage_put_command \"sleep 1; cp %p $remote\"" >> test.config
+run_mdp edit
+
+# The first push is still sleeping when the second save is done.
+use_config alt
+echo "set storage_put_command \"sleep 1; cp %p $remote\"" >> test.config
+run_mdp edit
+if [ ! -f $passfile.push ]; then
+	echo "the marker of the second save is missing"
+	return
+fi
+
+wait_for "[ ! -f $passfile.push ]" || return
+cmp -s $passfile $remote && echo pass
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "aead.h"
+#include "chacha.h"
+#include "sha256.h"
+
+
+static uint8_t input[(1 << 16) + 1];
+static size_t input_len;
+
+
+static void
+read_input(void)
+{
+	ssize_t len;
+
+	while ((len = read(STDIN_FILENO, input + input_len,
+	    sizeof(input) - 1 - input_len)) > 0)
+		input_len += len;
+}
+
+
+static size_t
+unhex(uint8_t *out, size_t size, const char *hex)
+{
+	size_t n = 0;
+	unsigned int byte;
+
+	while (hex[0] != '\0' && hex[1] != '\0' && n < size) {
+		if (sscanf(hex, "%2x", &byte) != 1)
+			exit(EXIT_FAILURE);
+		out[n++] = byte;
+		hex += 2;
+	}
+
+	return n;
+}
+
+
+static void
+print_hex(const uint8_t *p, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		printf("%02x", p[i]);
+	printf("\n");
+}
+
+
+/*
+ * Throughput of aead_seal() and aead_open() over a buffer of the given size
+ * in MB, in 64 KB messages as the native backend does.
+ */
+static int
+bench(char **av)
+{
+	uint8_t key[AEAD_KEY_LENGTH] = { 1 }, nonce[AEAD_NONCE_LENGTH] = { 2 };
+	struct timespec start, end;
+	size_t size, chunk = 65536;
+	uint8_t *buf, *tags;
+	double elapsed;
+
+	size = (av[2] != NULL ? strtoul(av[2], NULL, 10) : 64) * 1024 * 1024;
+	buf = malloc(size);
+	tags = malloc(size / chunk * AEAD_TAG_LENGTH);
+	if (buf == NULL || tags == NULL)
+		return EXIT_FAILURE;
+	memset(buf, 'x', size);
+
+	for (int decrypt = 0; decrypt < 2; decrypt++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t off = 0; off + chunk <= size; off += chunk) {
+			nonce[23] = off / chunk;
+			if (!decrypt) {
+				aead_seal(buf + off, tags + off / chunk *
+				    AEAD_TAG_LENGTH, buf + off, chunk, NULL, 0,
+				    nonce, key);
+			} else if (!aead_open(buf + off, tags + off / chunk *
+			    AEAD_TAG_LENGTH, buf + off, chunk, NULL, 0, nonce,
+			    key)) {
+				printf("forged\n");
+				return EXIT_FAILURE;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		elapsed = (end.tv_sec - start.tv_sec) +
+		    (end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("%-12s %8.1f MB/s\n", decrypt ? "open" : "seal",
+		    size / elapsed / (1024 * 1024));
+	}
+
+	free(buf);
+	free(tags);
+
+	return EXIT_SUCCESS;
+}
+
+
+int
+main(int ac, char **av)
+{
+	uint8_t key[256], nonce[32], ad[256], tag[AEAD_TAG_LENGTH];
+	uint8_t out[sizeof(input)];
+	struct poly1305_ctx poly;
+	uint32_t state[16];
+	size_t keylen, adlen;
+
+	if (ac < 2)
+		return EXIT_FAILURE;
+
+	if (strcmp(av[1], "bench") == 0)
+		return bench(av);
+
+	/* stub chacha20 <key> <counter> <nonce> < plain-text */
+	if (strcmp(av[1], "chacha20") == 0 && ac == 5) {
+		read_input();
+		unhex(key, sizeof(key), av[2]);
+		unhex(nonce, sizeof(nonce), av[4]);
+		chacha20_init(state, key, strtoul(av[3], NULL, 10), nonce);
+		chacha20_xor(state, out, input, input_len);
+		print_hex(out, input_len);
+
+	/* stub keystream <key> <blocks> <single|batch> */
+	} else if (strcmp(av[1], "keystream") == 0 && ac == 5) {
+		unhex(key, sizeof(key), av[2]);
+		memset(nonce, 0, sizeof(nonce));
+		chacha20_init(state, key, 0xfffffffe, nonce);
+		input_len = strtoul(av[3], NULL, 10);
+		if (input_len > sizeof(out) / CHACHA_BLOCK_LENGTH)
+			return EXIT_FAILURE;
+		if (strcmp(av[4], "batch") == 0)
+			chacha20_blocks(state, out, input_len);
+		else
+			for (size_t i = 0; i < input_len; i++)
+				chacha20_block(state, out + i *
+				    CHACHA_BLOCK_LENGTH);
+		print_hex(out, input_len * CHACHA_BLOCK_LENGTH);
+
+	/* stub hchacha20 <key> <nonce> */
+	} else if (strcmp(av[1], "hchacha20") == 0 && ac == 4) {
+		unhex(key, sizeof(key), av[2]);
+		unhex(nonce, sizeof(nonce), av[3]);
+		hchacha20(out, key, nonce);
+		print_hex(out, CHACHA_KEY_LENGTH);
+
+	/* stub poly1305 <key> < message (fed one byte at a time) */
+	} else if (strcmp(av[1], "poly1305") == 0 && ac == 3) {
+		read_input();
+		unhex(key, sizeof(key), av[2]);
+		poly1305_init(&poly, key);
+		for (size_t i = 0; i < input_len; i++)
+			poly1305_update(&poly, input + i, 1);
+		poly1305_final(&poly, tag);
+		print_hex(tag, sizeof(tag));
+
+	/* stub seal <key> <nonce> <ad> < plain-text */
+	} else if (strcmp(av[1], "seal") == 0 && ac == 5) {
+		read_input();
+		unhex(key, sizeof(key), av[2]);
+		unhex(nonce, sizeof(nonce), av[3]);
+		adlen = unhex(ad, sizeof(ad), av[4]);
+		aead_seal(out, tag, input, input_len, ad, adlen, nonce, key);
+		print_hex(out, input_len);
+		print_hex(tag, sizeof(tag));
+
+	/* stub open <key> <nonce> <ad> <tag> < hex cipher-text */
+	} else if (strcmp(av[1], "open") == 0 && ac == 6) {
+		read_input();
+		input[input_len] = '\0';
+		input[strcspn((char *)input, "\n")] = '\0';
+		input_len = unhex(input, input_len, (char *)input);
+		unhex(key, sizeof(key), av[2]);
+		unhex(nonce, sizeof(nonce), av[3]);
+		adlen = unhex(ad, sizeof(ad), av[4]);
+		unhex(tag, sizeof(tag), av[5]);
+		if (!aead_open(out, tag, input, input_len, ad, adlen, nonce,
+		    key)) {
+			printf("forged\n");
+			return EXIT_FAILURE;
+		}
+		fwrite(out, 1, input_len, stdout);
+
+	/* stub hmac <key> < message */
+	} else if (strcmp(av[1], "hmac") == 0 && ac == 3) {
+		read_input();
+		keylen = unhex(key, sizeof(key), av[2]);
+		hmac_sha256(out, key, keylen, input, input_len);
+		print_hex(out, SHA256_DIGEST_LENGTH);
+
+	/* stub hkdf <ikm> <salt> <info> <length> */
+	} else if (strcmp(av[1], "hkdf") == 0 && ac == 6) {
+		keylen = unhex(key, sizeof(key), av[2]);
+		adlen = unhex(ad, sizeof(ad), av[3]);
+		hkdf_sha256(out, strtoul(av[5], NULL, 10), key, keylen, ad,
+		    adlen, av[4]);
+		print_hex(out, strtoul(av[5], NULL, 10));
+
+	} else {
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
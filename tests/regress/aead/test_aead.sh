@@ -0,0 +1,74 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+sunscreen="Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it."
+key=808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f
+nonce=404142434445464748494a4b4c4d4e4f5051525354555657
+ad=50515253c0c1c2c3c4c5c6c7
+tag=c0875924c1c7987947deafd8780acf49
+
+announce "chacha.c:hchacha20() draft-irtf-cfrg-xchacha 2.2.1"
+./stub hchacha20 000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f \
+	000000090000004a0000000031415927 > test.stdout
+echo "82413b4227b27bfed30e42508a877d73a0f9e4d58a74a853c12ec41326d3ecdc" > test.expected
+assert_stdout && pass
+
+announce "chacha.c:chacha20_xor() RFC 8439 2.4.2"
+printf "$sunscreen" | ./stub chacha20 \
+	000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f 1 \
+	000000000000004a00000000 | cut -c 1-64 > test.stdout
+echo "6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b" > test.expected
+assert_stdout && pass
+
+announce "chacha.c:chacha20_blocks() agrees with chacha20_block()"
+./stub keystream $key 11 single > test.expected
+./stub keystream $key 11 batch > test.stdout
+assert_stdout && pass
+
+announce "aead.c:poly1305() RFC 8439 2.5.2"
+printf "Cryptographic Forum Research Group" | ./stub poly1305 \
+	85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b \
+	> test.stdout
+echo "a8061dc1305136c6c22b8baf0c0127a9" > test.expected
+assert_stdout && pass
+
+announce "aead.c:aead_seal() draft-irtf-cfrg-xchacha A.3.1"
+printf "$sunscreen" | ./stub seal $key $nonce $ad > test.stdout
+cat > test.expected << EOF
+bd6d179d3e83d43b9576579493c0e939572a1700252bfaccbed2902c21396cbb731c7f1b0b4aa6440bf3a82f4eda7e39ae64c6708c54c216cb96b72e1213b4522f8c9ba40db5d945b11b69b982c1bb9e3f3fac2bc369488f76b2383565d3fff921f9664c97637da9768812f615c68b13b52e
+$tag
+EOF
+assert_stdout && pass
+
+announce "aead.c:aead_open() round trip"
+head -n 1 test.expected | ./stub open $key $nonce $ad $tag \
+	> test.stdout
+printf "$sunscreen" > test.expected
+assert_stdout && pass
+
+announce "aead.c:aead_open() forged tag"
+printf "$sunscreen" | ./stub seal $key $nonce $ad | head -n 1 \
+	| ./stub open $key $nonce $ad c0875924c1c7987947deafd8780acf48 \
+	> test.stdout
+echo "forged" > test.expected
+assert_stdout && pass
+
+announce "aead.c:aead_open() wrong additional data"
+printf "$sunscreen" | ./stub seal $key $nonce $ad | head -n 1 \
+	| ./stub open $key $nonce 50515253c0c1c2c3c4c5c6c8 $tag \
+	> test.stdout
+echo "forged" > test.expected
+assert_stdout && pass
+
+announce "sha256.c:hmac_sha256() RFC 4231 1"
+printf "Hi There" | ./stub hmac 0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b \
+	> test.stdout
+echo "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" > test.expected
+assert_stdout && pass
+
+announce "sha256.c:hkdf_sha256() RFC 5869 A.1"
+./stub hkdf 0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b 000102030405060708090a0b0c \
+	"`printf '\360\361\362\363\364\365\366\367\370\371'`" 42 > test.stdout
+echo "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865" > test.expected
+assert_stdout && pass
@@ -0,0 +1,157 @@
+#include <sys/wait.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arc4random.h"
+
+
+static void
+print_hex(const uint8_t *p, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		printf("%02x", p[i]);
+	printf("\n");
+}
+
+
+static double
+elapsed_since(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((end.tv_sec - start->tv_sec) +
+	    (end.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+
+/*
+ * Print the chi-square statistic of count draws of arc4random_uniform(bound),
+ * or of count bytes of arc4random_buf() over 256 values if bound is 0.
+ */
+static int
+uniform(uint32_t bound, unsigned long count)
+{
+	unsigned long *seen;
+	uint8_t buf[4096];
+	double expected, chi2 = 0;
+	uint32_t bins = bound ? bound : 256;
+
+	seen = calloc(bins, sizeof(*seen));
+	if (seen == NULL)
+		return EXIT_FAILURE;
+
+	for (unsigned long i = 0; i < count; ) {
+		if (bound) {
+			seen[arc4random_uniform(bound)]++;
+			i++;
+			continue;
+		}
+		arc4random_buf(buf, sizeof(buf));
+		for (size_t j = 0; j < sizeof(buf) && i < count; j++, i++)
+			seen[buf[j]]++;
+	}
+
+	expected = (double)count / bins;
+	for (uint32_t i = 0; i < bins; i++)
+		chi2 += (seen[i] - expected) * (seen[i] - expected) / expected;
+	printf("%.2f\n", chi2);
+
+	free(seen);
+
+	return EXIT_SUCCESS;
+}
+
+
+/*
+ * Print 16 random bytes from the parent and from a child forked after the
+ * generator was seeded, they should never match.
+ */
+static int
+forked(void)
+{
+	uint8_t buf[16];
+	pid_t pid;
+	int status;
+
+	arc4random_buf(buf, sizeof(buf));
+	fflush(stdout);
+
+	if ((pid = fork()) == -1)
+		return EXIT_FAILURE;
+
+	arc4random_buf(buf, sizeof(buf));
+	if (pid == 0) {
+		print_hex(buf, sizeof(buf));
+		exit(EXIT_SUCCESS);
+	}
+
+	waitpid(pid, &status, 0);
+	print_hex(buf, sizeof(buf));
+
+	return EXIT_SUCCESS;
+}
+
+
+/*
+ * Throughput of arc4random_buf() at a few request sizes over a total of the
+ * given size in MB, and of arc4random_uniform() calls.
+ */
+static int
+bench(unsigned long mb)
+{
+	size_t sizes[] = { 32, 1024, 65536 }, total = mb * 1024 * 1024;
+	struct timespec start;
+	unsigned long calls = total / 4;
+	uint32_t sum = 0;
+	uint8_t *buf;
+
+	if ((buf = malloc(65536)) == NULL)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t done = 0; done < total; done += sizes[i])
+			arc4random_buf(buf, sizes[i]);
+		printf("buf %-8zu %10.1f MB/s\n", sizes[i],
+		    mb / elapsed_since(&start));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned long i = 0; i < calls; i++)
+		sum += arc4random_uniform(94);
+	printf("uniform(94)  %10.1f M/s\n", calls / elapsed_since(&start) / 1e6);
+
+	free(buf);
+
+	return (sum == 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+int
+main(int ac, char **av)
+{
+	if (ac < 2)
+		return EXIT_FAILURE;
+
+	/* stub bench <MB> */
+	if (strcmp(av[1], "bench") == 0 && ac == 3)
+		return bench(strtoul(av[2], NULL, 10));
+
+	/* stub uniform <bound> <count> */
+	if (strcmp(av[1], "uniform") == 0 && ac == 4)
+		return uniform(strtoul(av[2], NULL, 10),
+		    strtoul(av[3], NULL, 10));
+
+	/* stub fork */
+	if (strcmp(av[1], "fork") == 0)
+		return forked();
+
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+# $1 - chi-square statistic, $2 - critical value at p = 1e-6
+assert_uniform() {
+	if awk "BEGIN { exit !($1 < $2) }"; then
+		pass
+	else
+		fail "chi-square $1 above $2"
+	fi
+}
+
+announce "arc4random.c:arc4random_buf() uniform bytes"
+assert_uniform `./stub uniform 0 10000000` 377.2
+
+announce "arc4random.c:arc4random_uniform() uniform over 94"
+assert_uniform `./stub uniform 94 1000000` 173.0
+
+announce "arc4random.c:arc4random_uniform() uniform over 1000"
+assert_uniform `./stub uniform 1000 1000000` 1226.1
+
+announce "arc4random.c:arc4random_buf() child differs from parent"
+./stub fork > test.stdout
+if [ `sort -u test.stdout | wc -l` -eq 2 ]; then
+	pass
+else
+	fail "parent and child drew the same bytes"
+fi
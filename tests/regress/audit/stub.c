@@ -0,0 +1,91 @@
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+#include "arc4random.h"
+#include "audit.h"
+#include "results.h"
+
+
+/*
+ * Audit a password file of the given number of lines: random passwords,
+ * one in a hundred reused and one in a hundred weak.
+ */
+static int
+bench(unsigned int count)
+{
+	const char *set = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	    "0123456789";
+	struct timespec start, end;
+	char password[32];
+	unsigned int problems;
+	double elapsed;
+	FILE *fp, *null;
+
+	if ((fp = tmpfile()) == NULL || (null = fopen("/dev/null", "w")) == NULL)
+		return EXIT_FAILURE;
+
+	for (unsigned int i = 0; i < count; i++) {
+		for (int j = 0; j < 16; j++)
+			password[j] = set[arc4random_uniform(strlen(set))];
+		password[16] = '\0';
+		if (i % 100 == 50)
+			snprintf(password, sizeof(password), "Summer%u!", i);
+		if (i % 100 == 99)
+			strcpy(password, "reused-p@ssw0rd");
+		fprintf(fp, "service%u user%u %s\n", i, i, password);
+	}
+	rewind(fp);
+	load_results_fp(fp);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	problems = audit_results(null, 0, AUDIT_DEFAULT_MINIMUM);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - start.tv_sec) +
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%u lines, %u problems in %.3f s\n", count, problems, elapsed);
+
+	return EXIT_SUCCESS;
+}
+
+
+int
+main(int ac, char **av)
+{
+	wchar_t password[1024];
+	FILE *fp;
+
+	setlocale(LC_ALL, "");
+
+	if (ac < 3)
+		return EXIT_FAILURE;
+
+	/* stub bench <lines> */
+	if (strcmp(av[1], "bench") == 0)
+		return bench(strtoul(av[2], NULL, 10));
+
+	/* stub strength <password> */
+	if (strcmp(av[1], "strength") == 0) {
+		if (mbstowcs(password, av[2], 1024) == (size_t)-1)
+			return EXIT_FAILURE;
+		printf("%.0f\n", audit_strength(password, wcslen(password)));
+		return EXIT_SUCCESS;
+	}
+
+	/* stub audit <file> <field> <minimum> */
+	if (strcmp(av[1], "audit") == 0 && ac == 5) {
+		if ((fp = fopen(av[2], "r")) == NULL)
+			return EXIT_FAILURE;
+		load_results_fp(fp);
+		fclose(fp);
+		printf("%u\n", audit_results(stdout, atoi(av[3]),
+		    strtoul(av[4], NULL, 10)));
+		return EXIT_SUCCESS;
+	}
+
+	return EXIT_FAILURE;
+}
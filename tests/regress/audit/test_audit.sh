@@ -0,0 +1,81 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+# $1 - password, $2 - lowest acceptable estimate, $3 - highest
+assert_strength() {
+	bits=`./stub strength "$1"`
+	if [ "$bits" -ge "$2" ] && [ "$bits" -le "$3" ]; then
+		pass
+	else
+		fail "$bits bits, expected $2 to $3"
+	fi
+}
+
+announce "audit.c:audit_strength() common word"
+assert_strength "password" 0 5
+
+announce "audit.c:audit_strength() common word with substitutions"
+assert_strength "P@ssw0rd" 0 10
+
+announce "audit.c:audit_strength() repeat"
+assert_strength "aaaaaaaaaaaa" 0 10
+
+announce "audit.c:audit_strength() sequence"
+assert_strength "abcdefgh" 0 10
+
+announce "audit.c:audit_strength() keyboard"
+assert_strength "qwertyuiop" 0 12
+
+announce "audit.c:audit_strength() word, year and symbol"
+assert_strength "Summer2015!" 0 25
+
+announce "audit.c:audit_strength() random"
+assert_strength "kT9#xLq2!vRz8mWp" 90 110
+
+cat > test.passwords << EOF2
+# comment password
+email gmail P@ssw0rd1987
+bank main kT9#xLq2!vRz8mWp
+
+single
+shop amazon P@ssw0rd1987
+forum	kT9#xLq2!vRz8mWp
+   # indented comment
+wifi home cZ8#rPw3!bYq7nVs
+misc P@ssw0rd1987
+EOF2
+
+announce "audit.c:audit_results() duplicates and weak passwords"
+./stub audit test.passwords 0 40 > test.stdout
+cat > test.expected << EOF2
+lines 2, 6, 10: same password
+lines 3, 7: same password
+line 2: weak password (12 bits)
+line 6: weak password (12 bits)
+line 10: weak password (12 bits)
+5
+EOF2
+assert_stdout && pass
+
+announce "audit.c:audit_results() selected field"
+./stub audit test.passwords 1 40 > test.stdout
+cat > test.expected << EOF2
+line 2: weak password (24 bits)
+line 3: weak password (19 bits)
+line 5: weak password (28 bits)
+line 6: weak password (19 bits)
+line 7: weak password (24 bits)
+line 9: weak password (19 bits)
+line 10: weak password (19 bits)
+7
+EOF2
+assert_stdout && pass
+
+announce "audit.c:audit_results() nothing to report"
+printf 'a kT9#xLq2!vRz8mWp\nb cZ8#rPw3!bYq7nVs\n' > test.passwords
+./stub audit test.passwords 0 40 > test.stdout
+echo 0 > test.expected
+assert_stdout && pass
+
+rm -f test.passwords
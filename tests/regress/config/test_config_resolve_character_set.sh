@@ -32,4 +32,9 @@ announce "config.c:config_resolve_character_set(\"\$ALPHANUMERIC\")"
 echo "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890" > test.expected
 assert_stdout && pass
 
+announce "config.c:config_resolve_character_set(\"\$AMBIGUOUS\")"
+./stub config_resolve_character_set '$AMBIGUOUS' > test.stdout || fail
+echo "Il1|O0o" > test.expected
+assert_stdout && pass
+
 exit 0
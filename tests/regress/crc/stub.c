@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "crc.h"
+
+
+/*
+ * Print the checksum of stdin, fed to crc_update() in chunks of the given
+ * size.
+ */
+static int
+checksum(bool use_hardware, char **av)
+{
+	uint8_t buf[4096];
+	struct crc_ctx ctx;
+	size_t chunk;
+	ssize_t len;
+
+	if (!crc_use_hardware(use_hardware)) {
+		printf("unavailable\n");
+		return 2;
+	}
+
+	chunk = av[2] != NULL ? strtoul(av[2], NULL, 10) : sizeof(buf);
+	if (chunk == 0 || chunk > sizeof(buf))
+		return EXIT_FAILURE;
+
+	crc_init(&ctx);
+	while ((len = read(STDIN_FILENO, buf, chunk)) > 0)
+		crc_update(&ctx, buf, len);
+
+	printf("%08x\n", crc_final(&ctx));
+
+	return EXIT_SUCCESS;
+}
+
+
+/*
+ * Throughput of each kernel over a buffer of the given size in MB.
+ */
+static int
+bench(char **av)
+{
+	struct timespec start, end;
+	struct crc_ctx ctx;
+	size_t size;
+	uint8_t *buf;
+	double elapsed;
+
+	size = (av[2] != NULL ? strtoul(av[2], NULL, 10) : 64) * 1024 * 1024;
+	buf = malloc(size);
+	if (buf == NULL)
+		return EXIT_FAILURE;
+	for (size_t i = 0; i < size; i++)
+		buf[i] = i * 31;
+
+	for (int hw = 0; hw < 2; hw++) {
+		if (!crc_use_hardware(hw))
+			continue;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		crc_init(&ctx);
+		crc_update(&ctx, buf, size);
+		crc_final(&ctx);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		elapsed = (end.tv_sec - start.tv_sec) +
+		    (end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("%-12s %8.1f MB/s (%08x)\n", crc_kernel(),
+		    size / elapsed / (1024 * 1024), ctx.crc);
+	}
+
+	free(buf);
+
+	return EXIT_SUCCESS;
+}
+
+
+int
+main(int ac, char **av)
+{
+	(void)(ac);
+
+	if (av[1] == NULL) {
+		return EXIT_FAILURE;
+	} else if (strcmp(av[1], "sw") == 0) {
+		return checksum(false, av);
+	} else if (strcmp(av[1], "hw") == 0) {
+		return checksum(true, av);
+	} else if (strcmp(av[1], "bench") == 0) {
+		return bench(av);
+	} else {
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,42 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+for kernel in sw hw; do
+	if [ "`printf '' | ./stub $kernel`" = "unavailable" ]; then
+		announce "crc.c:crc_update() $kernel"
+		skip
+		continue
+	fi
+
+	announce "crc.c:crc_update() $kernel check value"
+	printf "123456789" | ./stub $kernel > test.stdout
+	echo "e3069283" > test.expected
+	assert_stdout && pass
+
+	announce "crc.c:crc_update() $kernel 32 zeros"
+	awk 'BEGIN { for (i = 0; i < 32; i++) printf "%c", 0 }' \
+		| ./stub $kernel 5 > test.stdout
+	echo "8a9136aa" > test.expected
+	assert_stdout && pass
+
+	announce "crc.c:crc_update() $kernel incrementing"
+	awk 'BEGIN { for (i = 0; i < 32; i++) printf "%c", i }' \
+		| ./stub $kernel 3 > test.stdout
+	echo "46dd794e" > test.expected
+	assert_stdout && pass
+done
+
+announce "crc.c:crc_update() kernels agree"
+awk 'BEGIN { for (i = 0; i < 100000; i++) printf "%c", 32 + (i * 7) % 90 }' \
+	> test.input
+./stub sw 4093 < test.input > test.expected
+if [ "`./stub hw < test.input`" = "unavailable" ]; then
+	cp test.expected test.stdout
+else
+	./stub hw 13 < test.input > test.stdout
+fi
+rm -f test.input
+assert_stdout && pass
+
+exit 0
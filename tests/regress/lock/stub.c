@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "lock.h"
 
@@ -10,16 +11,35 @@
 int
 main(int ac, char **av)
 {
-	(void)(ac);
+	if (ac < 3)
+		return EXIT_FAILURE;
 
 	lock_path = strdup(av[1]);
+	if (ac > 3)
+		lock_timeout = strtoul(av[3], NULL, 10);
 
 	if (action_is("lock_exists")) {
 		printf("%d\n", lock_exists());
 	} else if (action_is("lock_set")) {
 		lock_set();
+	} else if (action_is("lock_try")) {
+		printf("%d\n", lock_try());
 	} else if (action_is("lock_unset")) {
 		lock_unset();
+	} else if (action_is("lock_store_shared")) {
+		lock_store_shared();
+
+	/* stub <path> hold <seconds>: writer lock held for a while. */
+	} else if (action_is("hold")) {
+		lock_set();
+		sleep(atoi(av[3]));
+		lock_unset();
+
+	/* stub <path> hold_store <seconds>: exclusive store lock. */
+	} else if (action_is("hold_store")) {
+		lock_store_exclusive();
+		sleep(atoi(av[3]));
+		lock_store_unset();
 	}
 
 	return EXIT_SUCCESS;
@@ -8,10 +8,18 @@ rm -f fake_lock
 echo "0" > test.expected
 assert_stdout && pass
 
-announce "lock.c:lock_exists() - present"
+announce "lock.c:lock_exists() - stale file"
 touch fake_lock
 ./stub fake_lock lock_exists > test.stdout
+echo "0" > test.expected
+assert_stdout && pass
+
+announce "lock.c:lock_exists() - held"
+./stub fake_lock hold 1 &
+sleep 0.2
+./stub fake_lock lock_exists > test.stdout
 echo "1" > test.expected
+wait
 assert_stdout && pass
 
 exit 0
@@ -8,11 +8,52 @@ rm -f fake_lock
 assert_retcode_success $?
 assert_file_exists fake_lock && pass
 
-announce "lock.c:lock_set() - present"
+announce "lock.c:lock_set() - stale file"
 touch fake_lock
-./stub fake_lock lock_set 2> test.stderr
+./stub fake_lock lock_set
+assert_retcode_success $?
+pass
+
+announce "lock.c:lock_set() - held, timeout"
+./stub fake_lock hold 2 &
+sleep 0.2
+./stub fake_lock lock_set 0 2> test.stderr
+assert_retcode_failure $?
+wait
+echo "stub: locked (fake_lock)" > test.expected
+assert_stderr && pass
+
+announce "lock.c:lock_set() - held, wait"
+./stub fake_lock hold 1 &
+sleep 0.2
+./stub fake_lock lock_set 5
+assert_retcode_success $?
+wait
+pass
+
+announce "lock.c:lock_try() - held"
+./stub fake_lock hold 1 &
+sleep 0.2
+./stub fake_lock lock_try > test.stdout
+echo "0" > test.expected
+wait
+assert_stdout && pass
+
+announce "lock.c:lock_store_shared() - saving, timeout"
+./stub fake_lock hold_store 2 &
+sleep 0.2
+./stub fake_lock lock_store_shared 0 2> test.stderr
 assert_retcode_failure $?
+wait
 echo "stub: locked (fake_lock)" > test.expected
 assert_stderr && pass
 
+announce "lock.c:lock_store_shared() - writer"
+./stub fake_lock hold 1 &
+sleep 0.2
+./stub fake_lock lock_store_shared 0
+assert_retcode_success $?
+wait
+pass
+
 exit 0
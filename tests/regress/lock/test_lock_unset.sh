@@ -2,16 +2,16 @@
 
 . ../_functions.sh
 
-announce "lock.c:lock_unset() - missing"
+announce "lock.c:lock_unset() - not held"
 rm -f fake_lock
 ./stub fake_lock lock_unset
 assert_retcode_success $?
-assert_file_missing fake_lock && pass
+pass
 
-announce "lock.c:lock_unset() - present"
-touch fake_lock
-./stub fake_lock lock_unset 2> test.stderr
-assert_retcode_success $?
-assert_file_missing fake_lock && pass
+announce "lock.c:lock_unset() - released on exit"
+./stub fake_lock hold 0
+./stub fake_lock lock_exists > test.stdout
+echo "0" > test.expected
+assert_stdout && pass
 
 exit 0
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "merge.h"
+
+
+static void
+read_text(struct merge_text *text, const char *path)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		err(EXIT_FAILURE, "%s", path);
+	merge_text_read(text, fp);
+	fclose(fp);
+}
+
+
+/*
+ * stub <base> <ours> <theirs>: print the merge and the number of conflicts.
+ */
+int
+main(int ac, char **av)
+{
+	struct merge_text base = ARRAY_INITIALIZER;
+	struct merge_text ours = ARRAY_INITIALIZER;
+	struct merge_text theirs = ARRAY_INITIALIZER;
+	unsigned int conflicts;
+
+	if (ac != 4)
+		return EXIT_FAILURE;
+
+	read_text(&base, av[1]);
+	read_text(&ours, av[2]);
+	read_text(&theirs, av[3]);
+
+	conflicts = merge3(&base, &ours, &theirs, stdout);
+	printf("conflicts: %u\n", conflicts);
+
+	merge_text_free(&base);
+	merge_text_free(&ours);
+	merge_text_free(&theirs);
+
+	return EXIT_SUCCESS;
+}
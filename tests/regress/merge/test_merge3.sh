@@ -0,0 +1,80 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+printf "a 1\nb 2\nc 3\nd 4\ne 5\n" > base
+
+announce "merge.c:merge3() - changed on one side"
+printf "a 1\nb 2\nc 33\nd 4\ne 5\n" > ours
+cp base theirs
+./stub base ours theirs > test.stdout
+printf "a 1\nb 2\nc 33\nd 4\ne 5\nconflicts: 0\n" > test.expected
+assert_stdout && pass
+
+announce "merge.c:merge3() - different lines changed"
+printf "a 11\nb 2\nc 3\nd 4\ne 5\n" > ours
+printf "a 1\nb 2\nc 3\nd 4\ne 55\n" > theirs
+./stub base ours theirs > test.stdout
+printf "a 11\nb 2\nc 3\nd 4\ne 55\nconflicts: 0\n" > test.expected
+assert_stdout && pass
+
+announce "merge.c:merge3() - removed and changed"
+printf "a 1\nc 3\nd 4\ne 5\n" > ours
+printf "a 1\nb 2\nc 3\nd 44\ne 5\n" > theirs
+./stub base ours theirs > test.stdout
+printf "a 1\nc 3\nd 44\ne 5\nconflicts: 0\n" > test.expected
+assert_stdout && pass
+
+announce "merge.c:merge3() - same change on both sides"
+printf "a 1\nb 22\nc 3\nd 4\ne 5\n" > ours
+cp ours theirs
+./stub base ours theirs > test.stdout
+printf "a 1\nb 22\nc 3\nd 4\ne 5\nconflicts: 0\n" > test.expected
+assert_stdout && pass
+
+announce "merge.c:merge3() - added on both sides"
+printf "a 1\nb 2\nc 3\nd 4\ne 5\nf 6\n" > ours
+printf "a 1\nb 2\nc 3\nd 4\ne 5\ng 7\nh 8\n" > theirs
+./stub base ours theirs > test.stdout
+printf "a 1\nb 2\nc 3\nd 4\ne 5\ng 7\nh 8\nf 6\nconflicts: 0\n" > test.expected
+assert_stdout && pass
+
+announce "merge.c:merge3() - same line changed on both sides"
+printf "a 1\nb 2\nc 33\nd 4\ne 5\n" > ours
+printf "a 1\nb 2\nc 34\nd 4\ne 55\n" > theirs
+./stub base ours theirs > test.stdout
+cat > test.expected << EOF
+a 1
+b 2
+<<<<<<< yours
+c 33
+=======
+c 34
+>>>>>>> saved meanwhile
+d 4
+e 55
+conflicts: 1
+EOF
+assert_stdout && pass
+
+announce "merge.c:merge3() - empty base"
+: > base
+printf "a 1\n" > ours
+printf "b 2\n" > theirs
+./stub base ours theirs > test.stdout
+printf "b 2\na 1\nconflicts: 0\n" > test.expected
+assert_stdout && pass
+
+announce "merge.c:merge3() - large files"
+seq 1 20000 | sed 's/$/ password/' > base
+sed 's/^100 password$/100 changed/' base > ours
+sed 's/^19000 password$/19000 changed/' base > theirs
+echo "20001 added" >> theirs
+./stub base ours theirs > test.stdout
+sed 's/^100 password$/100 changed/;s/^19000 password$/19000 changed/' \
+	base > test.expected
+echo "20001 added" >> test.expected
+echo "conflicts: 0" >> test.expected
+assert_stdout && pass
+
+exit 0
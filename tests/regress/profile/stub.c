@@ -1,11 +1,15 @@
+#include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
 #include "array.h"
+#include "cmd.h"
 #include "str.h"
 #include "profile.h"
+#include "wcsdup.h"
 
 static int
 fprint_passwords(char **av)
@@ -16,12 +20,70 @@ fprint_passwords(char **av)
 	p->character_count = atoi(av[2]);
 	p->password_count = atoi(av[3]);
 	p->character_set = mbs_duplicate_as_wcs(av[4]);
+	if (av[5] != NULL)
+		cmd_job_count = atoi(av[5]);
 
 	profile_fprint_passwords(stdout, p);
 
 	return EXIT_SUCCESS;
 }
 
+/*
+ * Passwords per second printed to /dev/null for a few typical profiles, with
+ * the given number of jobs.
+ */
+static int
+bench(char **av)
+{
+	struct {
+		const char	*name;
+		const wchar_t	*set;
+		unsigned int	 length;
+	} profiles[] = {
+		{ "default", CHARSET_ALPHANUMERIC, DEFAULT_CHARACTER_COUNT },
+		{ "pin", CHARSET_DIGITS, 6 },
+		{ "printable", CHARSET_PRINTABLE, 32 },
+		{ "long", CHARSET_ALPHANUMERIC, 128 },
+		{ "greek", NULL, 20 },
+	};
+	struct timespec start, end;
+	struct profile *p;
+	wchar_t greek[26];
+	double elapsed;
+	FILE *null;
+
+	/* Two bytes per character in UTF-8. */
+	for (int i = 0; i < 25; i++)
+		greek[i] = 0x3b1 + i;
+	greek[25] = L'\0';
+	profiles[4].set = greek;
+
+	setlocale(LC_ALL, "");
+	if ((null = fopen("/dev/null", "w")) == NULL)
+		return EXIT_FAILURE;
+	cmd_job_count = atoi(av[3]);
+
+	for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+		p = profile_new(profiles[i].name);
+		p->character_count = profiles[i].length;
+		p->password_count = atoi(av[2]);
+		p->character_set = wcsdup(profiles[i].set);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		profile_fprint_passwords(null, p);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		elapsed = (end.tv_sec - start.tv_sec) +
+		    (end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("%-10s %4u chars %12.0f passwords/s\n", p->name,
+		    p->character_count, p->password_count / elapsed);
+	}
+
+	fclose(null);
+
+	return EXIT_SUCCESS;
+}
+
 static int
 get_from_name(char **av)
 {
@@ -45,6 +107,8 @@ main(int ac, char **av)
 
 	if (strcmp(av[1], "fprint_passwords") == 0) {
 		return fprint_passwords(av);
+	} else if (strcmp(av[1], "bench") == 0) {
+		return bench(av);
 	} else {
 		return get_from_name(av);
 	}
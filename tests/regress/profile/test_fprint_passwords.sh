@@ -24,4 +24,11 @@ if ./stub fprint_passwords 1000 3 qwerty 2>test.stderr; then
 fi
 pass
 
+announce "profile.c:profile_fprint_passwords() - three jobs"
+./stub fprint_passwords 10 1000 qwerty 3 \
+	| sed 's/[qwerty]/./g' | sort | uniq -c | tr -s ' ' \
+	> test.stdout
+echo " 1000 .........." > test.expected
+assert_stdout && pass
+
 exit 0
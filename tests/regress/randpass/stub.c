@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+#include "randpass.h"
+
+
+/*
+ * Print the chi-square statistic of the distribution of characters over
+ * <count> passwords of <length> characters drawn from <set>.
+ */
+static int
+uniform(int count, int length, const wchar_t *set)
+{
+	wchar_t password[MAX_PASSWORD_LENGTH + 1];
+	size_t setlen = wcslen(set);
+	unsigned long *seen;
+	double expected, chi2 = 0;
+
+	seen = calloc(setlen, sizeof(*seen));
+	if (seen == NULL)
+		return EXIT_FAILURE;
+
+	for (int i = 0; i < count; i++) {
+		if (generate_password_from_set(password, length, set) != 0)
+			return EXIT_FAILURE;
+		for (int j = 0; j < length; j++)
+			seen[wcschr(set, password[j]) - set]++;
+	}
+
+	expected = (double)count * length / setlen;
+	for (size_t i = 0; i < setlen; i++)
+		chi2 += (seen[i] - expected) * (seen[i] - expected) / expected;
+	printf("%.2f\n", chi2);
+
+	free(seen);
+
+	return EXIT_SUCCESS;
+}
+
+
+/*
+ * Draw count passwords of length from set with the given minimums (lowercase,
+ * uppercase, digits, symbols). Print the number of passwords missing a
+ * minimum, then the chi-square statistic of the positions of the digits.
+ */
+static int
+policy(int count, int length, const wchar_t *set, char **minimums)
+{
+	uint32_t indexes[MAX_PASSWORD_LENGTH];
+	unsigned int minimum[RANDPASS_CLASS_COUNT], seen[RANDPASS_CLASS_COUNT];
+	unsigned long *digits;
+	struct randpass_policy *p;
+	double expected, chi2 = 0;
+	unsigned long total = 0;
+	int class, bad = 0;
+
+	for (int i = 0; i < RANDPASS_CLASS_COUNT; i++)
+		minimum[i] = atoi(minimums[i]);
+
+	p = randpass_policy_new(set, minimum);
+	digits = calloc(length, sizeof(*digits));
+	if (digits == NULL)
+		return EXIT_FAILURE;
+
+	for (int i = 0; i < count; i++) {
+		if (generate_indexes_with_policy(NULL, indexes, length,
+		    wcslen(set), p) != 0) {
+			printf("error\n");
+			return EXIT_SUCCESS;
+		}
+		memset(seen, 0, sizeof(seen));
+		for (int j = 0; j < length; j++) {
+			if ((class = randpass_class(set[indexes[j]])) == -1)
+				continue;
+			seen[class]++;
+			if (class == RANDPASS_DIGITS) {
+				digits[j]++;
+				total++;
+			}
+		}
+		for (int c = 0; c < RANDPASS_CLASS_COUNT; c++) {
+			if (seen[c] < minimum[c]) {
+				bad++;
+				break;
+			}
+		}
+	}
+
+	expected = (double)total / length;
+	for (int j = 0; j < length; j++)
+		chi2 += (digits[j] - expected) * (digits[j] - expected) /
+		    expected;
+	printf("%d\n%.2f\n", bad, chi2);
+
+	randpass_policy_free(p);
+	free(digits);
+
+	return EXIT_SUCCESS;
+}
+
+
+/*
+ * Passwords per second for a few typical lengths over the printable set.
+ */
+static int
+bench(int count)
+{
+	wchar_t password[MAX_PASSWORD_LENGTH + 1], set[128];
+	int lengths[] = { 16, 64, 256 };
+	struct timespec start, end;
+	double elapsed;
+	size_t n = 0;
+
+	for (wchar_t c = L'!'; c <= L'~'; c++)
+		set[n++] = c;
+	set[n] = L'\0';
+
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int j = 0; j < count / lengths[i]; j++)
+			generate_password_from_set(password, lengths[i], set);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		elapsed = (end.tv_sec - start.tv_sec) +
+		    (end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("length %-5d %12.0f passwords/s\n", lengths[i],
+		    count / lengths[i] / elapsed);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+int
+main(int ac, char **av)
+{
+	wchar_t password[MAX_PASSWORD_LENGTH + 1], set[1024];
+	size_t setlen;
+
+	if (ac < 3)
+		return EXIT_FAILURE;
+
+	if (strcmp(av[1], "bench") == 0)
+		return bench(atoi(av[2]));
+
+	/* stub uniform-wide <count> <length> <setlen>, from U+0100 up */
+	if (strcmp(av[1], "uniform-wide") == 0 && ac == 5) {
+		setlen = strtoul(av[4], NULL, 10);
+		if (setlen >= sizeof(set) / sizeof(set[0]))
+			return EXIT_FAILURE;
+		for (size_t i = 0; i < setlen; i++)
+			set[i] = 0x100 + i;
+		set[setlen] = L'\0';
+		return uniform(atoi(av[2]), atoi(av[3]), set);
+	}
+
+	if (ac < 4 || mbstowcs(set, av[ac - 1], 256) == (size_t)-1)
+		return EXIT_FAILURE;
+
+	/* stub generate <length> <set> */
+	if (strcmp(av[1], "generate") == 0) {
+		if (generate_password_from_set(password, atoi(av[2]), set) != 0)
+			printf("error\n");
+		else
+			printf("%ls\n", password);
+
+	/* stub uniform <count> <length> <set> */
+	} else if (strcmp(av[1], "uniform") == 0 && ac == 5) {
+		return uniform(atoi(av[2]), atoi(av[3]), set);
+
+	/* stub policy <count> <length> <lower> <upper> <digits> <symbols> <set> */
+	} else if (strcmp(av[1], "policy") == 0 && ac == 9) {
+		return policy(atoi(av[2]), atoi(av[3]), set, av + 4);
+
+	} else {
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+printable='!"#$%&'"'"'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\]^_`abcdefghijklmnopqrstuvwxyz{|}~'
+
+# $1 - chi-square statistic, $2 - critical value at p = 1e-6
+assert_uniform() {
+	if awk "BEGIN { exit !($1 < $2) }"; then
+		pass
+	else
+		fail "chi-square $1 above $2"
+	fi
+}
+
+announce "randpass.c:generate_password_from_set() length"
+./stub generate 12 abc | tr -d '\n' | wc -c | tr -d ' ' > test.stdout
+echo "12" > test.expected
+assert_stdout && pass
+
+announce "randpass.c:generate_password_from_set() single character set"
+./stub generate 256 x | tr -d 'x' > test.stdout
+echo "" > test.expected
+assert_stdout && pass
+
+announce "randpass.c:generate_password_from_set() out of bounds"
+(./stub generate 0 abc; ./stub generate 257 abc; ./stub generate 8 "") \
+	> test.stdout
+cat > test.expected << EOF
+error
+error
+error
+EOF
+assert_stdout && pass
+
+announce "randpass.c:generate_password_from_set() uniform over 3"
+assert_uniform `./stub uniform 10000 256 abc` 30.3
+
+announce "randpass.c:generate_password_from_set() uniform over 10"
+assert_uniform `./stub uniform 10000 256 0123456789` 46.0
+
+announce "randpass.c:generate_password_from_set() uniform over 94"
+assert_uniform `./stub uniform 10000 256 "$printable"` 173.0
+
+announce "randpass.c:generate_password_from_set() uniform over 300"
+assert_uniform `./stub uniform-wide 10000 256 300` 430.1
+
+announce "randpass.c:generate_indexes_with_policy() minimums"
+./stub policy 10000 8 1 1 2 1 "$printable" > test.stdout
+stat=`tail -n 1 test.stdout`
+if [ `head -n 1 test.stdout` -ne 0 ]; then
+	fail "`head -n 1 test.stdout` passwords below the minimums"
+fi
+pass
+
+announce "randpass.c:generate_indexes_with_policy() shuffled"
+assert_uniform $stat 41.9
+
+announce "randpass.c:generate_indexes_with_policy() out of bounds"
+(./stub policy 1 4 1 1 2 1 "$printable"; ./stub policy 1 8 0 0 1 0 abc) \
+	> test.stdout
+cat > test.expected << EOF2
+error
+error
+EOF2
+assert_stdout && pass
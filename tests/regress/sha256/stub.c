@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sha256.h"
+
+/*
+ * Print the digest of stdin, fed to sha256_update() in chunks of the size
+ * given as first argument.
+ */
+int
+main(int ac, char **av)
+{
+	uint8_t buf[4096], digest[SHA256_DIGEST_LENGTH];
+	struct sha256_ctx ctx;
+	size_t chunk;
+	ssize_t len;
+
+	chunk = ac > 1 ? strtoul(av[1], NULL, 10) : sizeof(buf);
+	if (chunk == 0 || chunk > sizeof(buf))
+		return EXIT_FAILURE;
+
+	sha256_init(&ctx);
+	while ((len = read(STDIN_FILENO, buf, chunk)) > 0)
+		sha256_update(&ctx, buf, len);
+	sha256_final(&ctx, digest);
+
+	for (unsigned int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+		printf("%02x", digest[i]);
+	printf("\n");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+announce "sha256.c:sha256() empty"
+printf "" | ./stub > test.stdout
+echo "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" > test.expected
+assert_stdout && pass
+
+announce "sha256.c:sha256() abc"
+printf "abc" | ./stub > test.stdout
+echo "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" > test.expected
+assert_stdout && pass
+
+announce "sha256.c:sha256() two blocks"
+printf "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq" | ./stub 7 > test.stdout
+echo "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" > test.expected
+assert_stdout && pass
+
+announce "sha256.c:sha256() million a"
+awk 'BEGIN { for (i = 0; i < 1000; i++) { for (j = 0; j < 1000; j++) printf "a" } }' | ./stub 1000 > test.stdout
+echo "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" > test.expected
+assert_stdout && pass
+
+exit 0
@@ -1,9 +1,12 @@
 #include <sys/types.h>
+#include <sys/wait.h>
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "str.h"
 #include "utils.h"
@@ -37,6 +40,42 @@ file_exists_wrapper(char **av)
 }
 
 
+/*
+ * Run sleep for the given seconds, given the timeout in milliseconds. Prints
+ * how it ended and whether that was before one second.
+ */
+static int
+wait_child_wrapper(char **av)
+{
+	long long start = now_ms();
+	int status;
+	bool timed_out;
+	pid_t pid;
+
+	if ((pid = fork()) == 0) {
+		/* A child deaf to SIGINT, left for SIGKILL. */
+		if (av[4] != NULL && strcmp(av[4], "deaf") == 0)
+			signal(SIGINT, SIG_IGN);
+		execlp("sleep", "sleep", av[2], NULL);
+		_exit(127);
+	}
+
+	timed_out = wait_child(pid, &status, start + atoi(av[3]));
+
+	if (WIFEXITED(status)) {
+		printf("exited %d", WEXITSTATUS(status));
+	} else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT) {
+		printf("interrupted");
+	} else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL) {
+		printf("killed");
+	}
+	printf("%s%s\n", timed_out ? " timed out" : "",
+			now_ms() - start < 5000 ? " early" : "");
+
+	return EXIT_SUCCESS;
+}
+
+
 int
 main(int ac, char **av)
 {
@@ -46,6 +85,8 @@ main(int ac, char **av)
 		return join_path_wrapper(av);
 	} else if (strcmp(av[1], "file_exists") == 0) {
 		return file_exists_wrapper(av);
+	} else if (strcmp(av[1], "wait_child") == 0) {
+		return wait_child_wrapper(av);
 	} else {
 		return EXIT_FAILURE;
 	}
@@ -0,0 +1,20 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+announce "utils.c:wait_child() - exits in time"
+./stub wait_child 0 5000 > test.stdout
+echo "exited 0 early" > test.expected
+assert_stdout && pass
+
+announce "utils.c:wait_child() - interrupted"
+./stub wait_child 10 200 > test.stdout
+echo "interrupted timed out early" > test.expected
+assert_stdout && pass
+
+announce "utils.c:wait_child() - killed"
+./stub wait_child 10 200 deaf > test.stdout
+echo "killed timed out early" > test.expected
+assert_stdout && pass
+
+exit 0
@@ -0,0 +1,77 @@
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "wordlist.h"
+
+
+/*
+ * Print how the list was loaded, its size and every token on its own line.
+ */
+static void
+print_wordlist(struct wordlist *wl)
+{
+	const char *token;
+	size_t len;
+
+	printf("%s %u %u\n", wl->mapped ? "mapped" : "built", wl->count,
+	    wl->max_length);
+	for (uint32_t i = 0; i < wl->count; i++) {
+		token = wordlist_get(wl, i, &len);
+		printf("%.*s\n", (int)len, token);
+	}
+}
+
+
+int
+main(int ac, char **av)
+{
+	struct wordlist *wl;
+	wchar_t set[256];
+
+	setlocale(LC_ALL, "");
+
+	if (ac < 3)
+		return EXIT_FAILURE;
+
+	/* stub open <path> [cache_dir] */
+	if (strcmp(av[1], "open") == 0) {
+		if (ac == 4)
+			wordlist_cache_dir = av[3];
+		wl = wordlist_open(av[2]);
+
+	/* stub syllables <spec> */
+	} else if (strcmp(av[1], "syllables") == 0) {
+		wl = wordlist_from_syllables(av[2]);
+
+	/* stub charset <set> */
+	} else if (strcmp(av[1], "charset") == 0) {
+		if (mbstowcs(set, av[2], 256) == (size_t)-1)
+			return EXIT_FAILURE;
+		wl = wordlist_from_wcs(set);
+
+	/* stub entropy <count> <set> */
+	} else if (strcmp(av[1], "entropy") == 0 && ac == 4) {
+		if (mbstowcs(set, av[3], 256) == (size_t)-1 ||
+		    (wl = wordlist_from_wcs(set)) == NULL)
+			return EXIT_FAILURE;
+		printf("%.2f\n", wordlist_entropy(wl, atoi(av[2])));
+		wordlist_free(wl);
+		return EXIT_SUCCESS;
+
+	} else {
+		return EXIT_FAILURE;
+	}
+
+	if (wl == NULL) {
+		printf("error\n");
+		return EXIT_SUCCESS;
+	}
+
+	print_wordlist(wl);
+	wordlist_free(wl);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#!/bin/sh
+
+. ../_functions.sh
+
+rm -f words.txt words-* words.*
+
+announce "wordlist.c:wordlist_open() sorted, unique, last field"
+cat > words.txt << EOF2
+# comment
+11111	cherry
+11112	apple
+
+11113	banana  
+11114	apple
+EOF2
+./stub open words.txt > test.stdout
+cat > test.expected << EOF2
+built 3 6
+apple
+banana
+cherry
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_open() compiled image is reused"
+./stub open words.txt . > /dev/null
+./stub open words.txt . > test.stdout
+cat > test.expected << EOF2
+mapped 3 6
+apple
+banana
+cherry
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_open() compiled image is stale"
+echo "durian" >> words.txt
+./stub open words.txt . > test.stdout
+cat > test.expected << EOF2
+built 4 6
+apple
+banana
+cherry
+durian
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_open() compiled image is stale, same size and mtime"
+./stub open words.txt . > /dev/null
+sed 's/durian/dUrian/' words.txt > words.new
+touch -r words.txt words.new
+mv words.new words.txt
+./stub open words.txt . > test.stdout
+cat > test.expected << EOF2
+built 4 6
+apple
+banana
+cherry
+dUrian
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_open() compiled image is found from another directory"
+mkdir -p sub
+cp -p words.txt sub/words.txt
+./stub open words.txt . > /dev/null
+./stub open sub/words.txt . > /dev/null
+(cd sub && ../stub open words.txt .. > ../test.stdout)
+rm -rf sub
+cat > test.expected << EOF2
+mapped 4 6
+apple
+banana
+cherry
+dUrian
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_open() compiled image is corrupted"
+./stub open words.txt . > /dev/null
+for f in words-*; do
+	printf 'mdpwrds2\377\377\377\377' | dd of=$f conv=notrunc 2>/dev/null
+done
+./stub open words.txt . > test.stdout
+cat > test.expected << EOF2
+built 4 6
+apple
+banana
+cherry
+dUrian
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_open() no words"
+echo "# nothing" > words.txt
+if ./stub open words.txt 2> test.stderr; then
+	fail "empty word list should error out"
+fi
+pass
+
+announce "wordlist.c:wordlist_from_syllables()"
+./stub syllables "ka-ba--ka-ret-" > test.stdout
+cat > test.expected << EOF2
+built 3 3
+ba
+ka
+ret
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_from_syllables() empty"
+./stub syllables "--" > test.stdout
+echo "error" > test.expected
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_from_wcs() keeps duplicates"
+./stub charset "abca" > test.stdout
+cat > test.expected << EOF2
+built 4 1
+a
+b
+c
+a
+EOF2
+assert_stdout && pass
+
+announce "wordlist.c:wordlist_entropy()"
+(./stub entropy 1 ab; ./stub entropy 8 0123456789; ./stub entropy 4 aabb) \
+	> test.stdout
+cat > test.expected << EOF2
+1.00
+26.58
+4.00
+EOF2
+assert_stdout && pass